@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <rv/geometry.h>
+#include <rv/norms.h>
+#include <rv/Laserscan.h>
+#include <rv/Stopwatch.h>
+
+#include "project/utils.h"
+#include "project/Octree.h"
+
+using namespace rv;
+
+/** \brief runtime measurements of a single benchmark, which are written as one row of the CSV file. **/
+struct Timing
+{
+  public:
+    std::string name;
+    std::vector<double> runtimes;
+
+    double mean() const
+    {
+      double sum = 0.0;
+      for (uint32_t i = 0; i < runtimes.size(); ++i)
+        sum += runtimes[i];
+      return sum / std::max<uint32_t>(1, runtimes.size());
+    }
+
+    double sigma() const
+    {
+      double mu = mean(), sum = 0.0;
+      for (uint32_t i = 0; i < runtimes.size(); ++i)
+        sum += (runtimes[i] - mu) * (runtimes[i] - mu);
+      return std::sqrt(sum / std::max<uint32_t>(1, runtimes.size()));
+    }
+};
+
+/** \brief point cloud used for benchmarking, where real scans consist of multiple point clouds. **/
+struct Cloud
+{
+  public:
+    std::string name;
+    std::vector<std::vector<Point3f> > scans;
+};
+
+// configuration of the benchmark; the first entries are the reference configuration reported with the names
+// used in timings.txt.
+const uint32_t NUM_REPETITIONS = 10;
+const uint32_t NUM_QUERIES = 100;
+const uint32_t MAX_SCANS = 5;
+
+const uint32_t bucketSizes[] =
+{ 32, 8, 16, 64 };
+const uint32_t numBucketSizes = sizeof(bucketSizes) / sizeof(bucketSizes[0]);
+const uint32_t pointCounts[] =
+{ 100000, 10000 };
+const uint32_t numPointCounts = sizeof(pointCounts) / sizeof(pointCounts[0]);
+const float radii[] =
+{ 0.5f, 0.25f, 1.0f };
+const uint32_t numRadii = sizeof(radii) / sizeof(radii[0]);
+
+/** \brief build time of the octree for each scan of the cloud. **/
+Timing benchmarkInitialization(const Cloud& cloud, uint32_t bucketSize)
+{
+  std::stringstream name;
+  name << "Octree Initialization/" << cloud.name << "/bucket-" << bucketSize;
+
+  Timing timing;
+  timing.name = name.str();
+
+  Octree octree(bucketSize);
+  for (uint32_t s = 0; s < cloud.scans.size(); ++s)
+  {
+    for (uint32_t r = 0; r < NUM_REPETITIONS; ++r)
+    {
+      Stopwatch::tic();
+      octree.initialize(cloud.scans[s]);
+      timing.runtimes.push_back(Stopwatch::toc());
+    }
+  }
+
+  return timing;
+}
+
+/** \brief time needed for NUM_QUERIES radius searches at points evenly distributed over the scan. **/
+Timing benchmarkRadiusSearch(const Cloud& cloud, uint32_t bucketSize, float radius, const Norm& norm,
+    const std::string& normName, uint64_t& numNeighbors)
+{
+  std::stringstream name;
+  name << "Radius search/" << cloud.name << "/bucket-" << bucketSize << "/r-" << radius << "/" << normName;
+
+  Timing timing;
+  timing.name = name.str();
+
+  Octree octree(bucketSize);
+  std::vector<uint32_t> neighbors;
+  for (uint32_t s = 0; s < cloud.scans.size(); ++s)
+  {
+    const std::vector<Point3f>& points = cloud.scans[s];
+    if (points.empty()) continue;
+
+    octree.initialize(points);
+    const uint32_t step = std::max<uint32_t>(1, points.size() / NUM_QUERIES);
+
+    for (uint32_t r = 0; r < NUM_REPETITIONS; ++r)
+    {
+      Stopwatch::tic();
+      for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+      {
+        octree.radiusNeighbors(points[(i * step) % points.size()], radius, neighbors, norm);
+        numNeighbors += neighbors.size();
+      }
+      timing.runtimes.push_back(Stopwatch::toc());
+    }
+  }
+
+  return timing;
+}
+
+/**
+ * Benchmark of the octree construction and radius search with different bucket sizes, radii, and norms
+ * on random point clouds and, if a scan directory is given, on the first laser scans of this directory.
+ *
+ * The results are written in the format of timings.txt, where the reference configuration (bucket size 32,
+ * radius 0.5, Euclidean norm on the real scans or the largest random point cloud) is additionally reported as
+ * "Octree Initialization" and "Radius search".
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Missing arguments: ./bench-octree <output.csv> [<scan-directory>]" << std::endl;
+    return -1;
+  }
+
+  std::vector<Cloud> clouds;
+
+  if (argc > 2)
+  {
+    Cloud cloud;
+    cloud.name = "scans";
+
+    DirectoryUtil dir(argv[2]);
+    Laserscan scan;
+    while (dir.hasNextFile() && cloud.scans.size() < MAX_SCANS)
+    {
+      dir.next();
+      readLaserscan(dir.getLaserscanFilename(), scan);
+      cloud.scans.push_back(scan.points());
+    }
+
+    if (!cloud.scans.empty()) clouds.push_back(cloud);
+  }
+
+  for (uint32_t i = 0; i < numPointCounts; ++i)
+  {
+    std::stringstream name;
+    name << "random-" << pointCounts[i];
+
+    Cloud cloud;
+    cloud.name = name.str();
+    cloud.scans.resize(1);
+    randomPoints(cloud.scans[0], pointCounts[i], i);
+    clouds.push_back(cloud);
+  }
+
+  ManhattenNorm manhatten;
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  const Norm* norms[3] =
+  { &euclidean, &manhatten, &maximum };
+  const std::string normNames[3] =
+  { "Euclidean", "Manhatten", "Maximum" };
+
+  std::vector<Timing> timings;
+  uint64_t numNeighbors = 0;
+
+  for (uint32_t c = 0; c < clouds.size(); ++c)
+  {
+    std::cout << "Benchmarking " << clouds[c].name << "..." << std::flush;
+    Stopwatch::tic();
+
+    for (uint32_t b = 0; b < numBucketSizes; ++b)
+    {
+      timings.push_back(benchmarkInitialization(clouds[c], bucketSizes[b]));
+
+      for (uint32_t r = 0; r < numRadii; ++r)
+        for (uint32_t n = 0; n < 3; ++n)
+          timings.push_back(
+              benchmarkRadiusSearch(clouds[c], bucketSizes[b], radii[r], *norms[n], normNames[n], numNeighbors));
+    }
+
+    std::cout << "finished in " << Stopwatch::toc() << " s." << std::endl;
+  }
+
+  // the first cloud and the first entries of the configuration give the reference timings.
+  Timing initialization = timings[0];
+  initialization.name = "Octree Initialization";
+  Timing radiusSearch = timings[1];
+  radiusSearch.name = "Radius search";
+  timings.insert(timings.begin(), radiusSearch);
+  timings.insert(timings.begin(), initialization);
+
+  std::ofstream out(argv[1]);
+  if (!out.is_open())
+  {
+    std::cerr << "Unable to write '" << argv[1] << "'." << std::endl;
+    return -1;
+  }
+
+  out << "Name,Avg. Runtime, sigma" << std::endl;
+  for (uint32_t i = 0; i < timings.size(); ++i)
+    out << timings[i].name << "," << timings[i].mean() << "," << timings[i].sigma() << std::endl;
+  out.close();
+
+  // printing the number of neighbors ensures that the searches are not optimized away.
+  std::cout << "Found " << numNeighbors << " neighbors in total." << std::endl;
+
+  return 0;
+}
@@ -7,8 +7,10 @@
 #include <boost/filesystem.hpp>
 
 #include "project/utils.h"
+#include "project/SegmentNeighborSearch.h"
 #include "project/Octree.h"
 #include "project/SpinImage.h"
+#include "project/NormalEstimation.h"
 #include "project/BagOfWordsDescriptor.h"
 #include "project/GridbasedSegmentation.h"
 #include "project/SoftmaxRegression.h"
@@ -40,13 +42,17 @@ int main(int argc, char** argv)
   std::string model_directory(params["model-directory"]);
 
   // 1. Initialize descriptors, vocabulary, and classifier from configuration file.
-  Octree oct;
+  // octree or voxel grid as specified by "neighbor-search".
+  SegmentNeighborSearch* search = createNeighborSearch(params);
+  SegmentNeighborSearch& nn = *search;
 
   GridbasedSegmentation seg(params["segmentation"]);
 
   ParameterList bowParams = params["bag-of-words"];
   SpinImage si(bowParams["descriptor"]);
-  std::vector<std::vector<float> > vocabulary;
+  NormalEstimation normals(bowParams["descriptor"]);
+  // flat vocabulary or vocabulary tree, whose leaves are the words.
+  VocabularyTree vocabulary;
   std::string voc_filename = model_directory + (std::string) bowParams["vocabulary-filename"];
   readVocabulary(voc_filename, vocabulary);
   BagOfWordsDescriptor bow(bowParams, si, vocabulary);
@@ -89,11 +95,17 @@ int main(int argc, char** argv)
     std::vector<std::string> labels;
     std::vector<float> probabilities;
 
+    // the neighbor search is built once per scan and the search restricted to the current segment.
+    nn.initialize(scan.points(), segments);
+
+    // normals are estimated once per scan, if the spin images use them as reference axis.
+    if (si.usesNormals()) normals.estimate(scan, segments, nn);
+
     for (uint32_t i = 0; i < segments.size(); ++i)
     {
-      oct.initialize(scan.points(), segments[i].indexes);
+      nn.setSegment(i);
 
-      bow.evaluate(&segment_feature[0], segments[i], scan, oct);
+      bow.evaluate(&segment_feature[0], segments[i], scan, nn);
 
       sr.classify(segment_feature, prob);
       // determine y* = argmax_y P(y|x)
@@ -111,5 +123,12 @@ int main(int argc, char** argv)
   printProgress(numScans, numScans);
   std::cout << "finished in " << Stopwatch::toc() << " s." << std::endl;
 
+  // the accuracy of the approximate search must be evaluated with the score tool.
+  Octree* octree = dynamic_cast<Octree*>(search);
+  if (octree != 0 && octree->approximatedPoints() > 0)
+    std::cout << "approximate search: " << octree->approximatedPoints() << " points not tested." << std::endl;
+
+  delete search;
+
   return 0;
 }
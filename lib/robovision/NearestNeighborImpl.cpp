@@ -22,4 +22,37 @@ void NearestNeighborImpl::initialize(const std::vector<Point3f>& pts)
   initialize(pts, indexes);
 }
 
+void NearestNeighborImpl::radiusNeighbors(const std::vector<Point3f>& queries, float r,
+    std::vector<uint32_t>& offsets, std::vector<uint32_t>& neighbors, const Norm& dist) const
+{
+  offsets.resize(queries.size() + 1);
+  offsets[0] = 0;
+  neighbors.clear();
+
+  std::vector<uint32_t> result;
+  for (uint32_t i = 0; i < queries.size(); ++i)
+  {
+    radiusNeighbors(queries[i], r, result, dist);
+    neighbors.insert(neighbors.end(), result.begin(), result.end());
+    offsets[i + 1] = neighbors.size();
+  }
+}
+
+uint32_t NearestNeighborImpl::countNeighbors(const Point3f& q, float r, const Norm& dist) const
+{
+  std::vector<uint32_t> neighbors;
+  radiusNeighbors(q, r, neighbors, dist);
+
+  return neighbors.size();
+}
+
+int32_t NearestNeighborImpl::nearestNeighbor(const Point3f& q, const Norm& dist) const
+{
+  std::vector<uint32_t> neighbors;
+  knnNeighbors(q, 1, neighbors, dist);
+  if (neighbors.empty()) return -1;
+
+  return neighbors[0];
+}
+
 }
@@ -25,6 +25,14 @@ PointDescriptor::~PointDescriptor()
 
 }
 
+void PointDescriptor::evaluate(float* values, const std::vector<uint32_t>& indexes, const Normal3f& ref,
+    const Laserscan& scan, const NearestNeighborImpl& nn) const
+{
+  const uint32_t D = dim();
+  for (uint32_t i = 0; i < indexes.size(); ++i)
+    evaluate(values + i * D, scan.point(indexes[i]), ref, scan, nn);
+}
+
 const ParameterList& PointDescriptor::params() const
 {
   return params_;
@@ -38,6 +38,61 @@ class NearestNeighborImpl
      * @param dist      norm for radius neighbors search
      */
     virtual void radiusNeighbors(const Point3f& q, float r, std::vector<uint32_t>& neighbors, const Norm& dist) const = 0;
+
+    /** \brief search radius neighbors of multiple query points.
+     *
+     *  The neighbors of the i-th query are stored in neighbors[offsets[i]], ..., neighbors[offsets[i+1]-1].
+     *  The default implementation searches the radius neighbors of each query separately.
+     *
+     * @param queries   query points
+     * @param r         maximal distance of neighbors
+     * @param offsets   start of the neighbors of each query in neighbors, contains queries.size() + 1 elements.
+     * @param neighbors contains indexes of neighbor points of all queries
+     * @param dist      norm for radius neighbors search
+     */
+    virtual void radiusNeighbors(const std::vector<Point3f>& queries, float r, std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& neighbors, const Norm& dist) const;
+
+    /** \brief search radius neighbors and their offsets to the query.
+     *
+     * @param q         query point q
+     * @param r         maximal distance of neighbors
+     * @param neighbors contains indexes of neighbor points
+     * @param offsets   contains the offset p - q of every neighbor p in the same order as neighbors.
+     * @param dist      norm for radius neighbors search
+     */
+    virtual void radiusNeighbors(const Point3f& q, float r, std::vector<uint32_t>& neighbors,
+        std::vector<Vector3f>& offsets, const Norm& dist) const = 0;
+
+    /** \brief number of radius neighbors.
+     *
+     *  The default implementation searches the radius neighbors and returns their number.
+     *
+     * @param q         query point q
+     * @param r         maximal distance of neighbors
+     * @param dist      norm for radius neighbors search
+     */
+    virtual uint32_t countNeighbors(const Point3f& q, float r, const Norm& dist) const;
+
+    /** \brief search the k nearest neighbors of q.
+     *
+     * @param q         query point q
+     * @param k         number of neighbors
+     * @param neighbors contains indexes of the min(k, N) nearest points sorted by increasing distance.
+     * @param dist      norm for nearest neighbors search
+     */
+    virtual void knnNeighbors(const Point3f& q, uint32_t k, std::vector<uint32_t>& neighbors, const Norm& dist) const = 0;
+
+    /** \brief search the nearest neighbor of q.
+     *
+     *  The default implementation searches the k = 1 nearest neighbors.
+     *
+     * @param q         query point q
+     * @param dist      norm for nearest neighbor search
+     *
+     * @return index of nearest point, or -1 if there are no points.
+     */
+    virtual int32_t nearestNeighbor(const Point3f& q, const Norm& dist) const;
 };
 
 }
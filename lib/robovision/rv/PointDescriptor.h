@@ -50,6 +50,21 @@ class PointDescriptor
     virtual void evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan& scan,
         const NearestNeighborImpl& nn) const = 0;
 
+    /** \brief evaluate the PointDescriptor for multiple points of the scan.
+     *
+     *  The feature vectors are written consecutively, i.e., values must provide space for
+     *  indexes.size() * dim() values and the feature vector of scan.point(indexes[i]) starts at
+     *  values + i * dim(). The default implementation evaluates the points one after another.
+     *
+     *  \param values   pointer to start of feature values.
+     *  \param indexes  indexes of the query points in scan.
+     *  \param ref      normal/reference axis of all query points
+     *  \param scan     points used to generate the nearest neighbor datastructure
+     *  \param nn       nearest neighbor implementation using pts.
+     */
+    virtual void evaluate(float* values, const std::vector<uint32_t>& indexes, const Normal3f& ref,
+        const Laserscan& scan, const NearestNeighborImpl& nn) const;
+
     /** \brief dimension of the PointDescriptor. **/
     virtual uint32_t dim() const = 0;
 
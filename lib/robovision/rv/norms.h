@@ -8,11 +8,81 @@
 #define NORMS_H_
 
 #include <cmath>
+#include <algorithm>
+#include <typeinfo>
 
 namespace rv
 {
 
+/** \brief compile-time policies of the standard norms.
+ *
+ *  The policies are used as template parameter of the searches of Octree and VoxelHashGrid, which dispatch once
+ *  per query from the norm to its policy, such that the distance computation can be inlined. Every policy provides
+ *    compute(x, y, z)     the norm of the vector (x, y, z),
+ *    compare(x, y, z)     a value, which is monotonic in the norm and cheaper to compute, and
+ *    threshold(radius)    the value of compare for a vector of norm radius.
+ *
+ *  Thus, a point is inside the ball with given radius iff compare(x, y, z) <= threshold(radius), where the
+ *  threshold is only computed once per query.
+ */
+struct EuclideanDistance
+{
+    inline float compute(float x, float y, float z) const
+    {
+      return std::sqrt(x * x + y * y + z * z);
+    }
+
+    // comparing squared distances avoids the square root.
+    inline float compare(float x, float y, float z) const
+    {
+      return x * x + y * y + z * z;
+    }
+
+    inline float threshold(float radius) const
+    {
+      return radius * radius;
+    }
+};
+
+struct ManhattenDistance
+{
+    inline float compute(float x, float y, float z) const
+    {
+      return std::abs(x) + std::abs(y) + std::abs(z);
+    }
+
+    inline float compare(float x, float y, float z) const
+    {
+      return compute(x, y, z);
+    }
+
+    inline float threshold(float radius) const
+    {
+      return radius;
+    }
+};
+
+struct MaximumDistance
+{
+    inline float compute(float x, float y, float z) const
+    {
+      return std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+    }
+
+    inline float compare(float x, float y, float z) const
+    {
+      return compute(x, y, z);
+    }
+
+    inline float threshold(float radius) const
+    {
+      return radius;
+    }
+};
+
 /** \brief definition of standard norms
+ *
+ *  The norms are thin adapters of the policies above for code, which selects the norm at runtime.
  * 
  *  \author behley
  */
@@ -38,7 +108,7 @@ class ManhattenNorm: public Norm
   public:
     float compute(float x, float y, float z) const
     {
-      return std::abs(x) + std::abs(y) + std::abs(z);
+      return ManhattenDistance().compute(x, y, z);
     }
 };
 
@@ -47,7 +117,7 @@ class EuclideanNorm: public Norm
   public:
     float compute(float x, float y, float z) const
     {
-      return std::sqrt(std::pow(x, 2) + std::pow(y, 2) + std::pow(z, 2));
+      return EuclideanDistance().compute(x, y, z);
     }
 };
 
@@ -56,13 +126,55 @@ class MaximumNorm: public Norm
   public:
     float compute(float x, float y, float z) const
     {
-      float maximum = std::max(std::abs(x), std::abs(y));
-      maximum = std::max(maximum, std::abs(z));
+      return MaximumDistance().compute(x, y, z);
+    }
+};
 
-      return maximum;
+/** \brief policy for any other norm, which uses the virtual method of the norm. **/
+struct NormDistance
+{
+    NormDistance(const Norm& n) :
+        norm(n)
+    {
     }
+
+    inline float compute(float x, float y, float z) const
+    {
+      return norm.compute(x, y, z);
+    }
+
+    inline float compare(float x, float y, float z) const
+    {
+      return norm.compute(x, y, z);
+    }
+
+    inline float threshold(float radius) const
+    {
+      return radius;
+    }
+
+    const Norm& norm;
 };
 
+/** \brief call f(dist) with the policy of the norm.
+ *
+ *  The standard norms are mapped to their policies, any other norm to NormDistance. Thus, a search templated
+ *  on the policy is selected once per query and the distance computation can be inlined.
+ */
+template<class F>
+void dispatchNorm(const Norm& norm, F& f)
+{
+  const std::type_info& type = typeid(norm);
+  if (type == typeid(EuclideanNorm))
+    f(EuclideanDistance());
+  else if (type == typeid(MaximumNorm))
+    f(MaximumDistance());
+  else if (type == typeid(ManhattenNorm))
+    f(ManhattenDistance());
+  else
+    f(NormDistance(norm));
+}
+
 }
 
 #endif /* NORMS_H_ */
@@ -1,14 +1,28 @@
 #include "BagOfWordsDescriptor.h"
 
 #include <cmath>
+#include <algorithm>
 
 using namespace rv;
 
+const uint32_t BagOfWordsDescriptor::BLOCK_SIZE;
+
 BagOfWordsDescriptor::BagOfWordsDescriptor(const ParameterList& params, const PointDescriptor& descriptor,
     const std::vector<std::vector<float> >& vocabulary) :
-    SegmentDescriptor(params), descriptor_(descriptor.clone()), vocabulary_(vocabulary)
+    SegmentDescriptor(params), descriptor_(descriptor.clone()), vocabulary_(vocabulary), keypoints_(params)
 {
   normalizer_ = getNormalizerByName(params_["normalizer"]);
+  initializeWords();
+}
+
+BagOfWordsDescriptor::BagOfWordsDescriptor(const ParameterList& params, const PointDescriptor& descriptor,
+    const VocabularyTree& tree) :
+    SegmentDescriptor(params), descriptor_(descriptor.clone()), vocabulary_(tree.words()), keypoints_(params)
+{
+  normalizer_ = getNormalizerByName(params_["normalizer"]);
+  // a flat vocabulary is searched by the matrix multiplication.
+  if (tree.depth() > 1) tree_ = tree;
+  initializeWords();
 }
 
 BagOfWordsDescriptor::~BagOfWordsDescriptor()
@@ -19,7 +33,8 @@ BagOfWordsDescriptor::~BagOfWordsDescriptor()
 
 BagOfWordsDescriptor::BagOfWordsDescriptor(const BagOfWordsDescriptor& other) :
     SegmentDescriptor(other.params_), descriptor_(other.descriptor_->clone()), normalizer_(other.normalizer_->clone()), vocabulary_(
-        other.vocabulary_)
+        other.vocabulary_), keypoints_(other.keypoints_), tree_(other.tree_), words_(other.words_), wordNorms_(
+        other.wordNorms_)
 {
 
 }
@@ -32,6 +47,11 @@ BagOfWordsDescriptor& BagOfWordsDescriptor::operator=(const BagOfWordsDescriptor
   params_ = other.params_;
   descriptor_ = other.descriptor_->clone();
   normalizer_ = other.normalizer_->clone();
+  vocabulary_ = other.vocabulary_;
+  keypoints_ = other.keypoints_;
+  tree_ = other.tree_;
+  words_ = other.words_;
+  wordNorms_ = other.wordNorms_;
 
   return *this;
 }
@@ -49,39 +69,111 @@ uint32_t BagOfWordsDescriptor::dim() const
 void BagOfWordsDescriptor::evaluate(float* values, const IndexedSegment& segment, const Laserscan& scan,
     const NearestNeighborImpl& nn) const
 {
-  memset(values, 0, sizeof(float) * vocabulary_.size());
   Normal3f upvector(0.f, 0.f, 1.f); // use up-vector for computation of point descriptors.
-  std::vector<float> pfeature(descriptor_->dim());
+  const uint32_t D = descriptor_->dim();
 
-  for(int i = 0; i < segment.indexes.size(); i ++)
+  // only the point descriptors of the keypoints are needed, which bounds the costs of large segments.
+  const std::vector<uint32_t>* indexes = &segment.indexes;
+  std::vector<uint32_t> positions, selected;
+  if (!keypoints_.selectsAll())
   {
-	  float * v = pfeature.data();
-
-	  descriptor_->evaluate(v, scan.point(segment.indexes[i]), upvector, scan, nn);
-	  float mn = INT_MAX;
-	  int index = -1;
-	  for(int j = 0; j < vocabulary_.size(); j ++)
-	  {
-		   float d = distance(pfeature, vocabulary_[j]);
-		   if(d < mn)
-		   {
-			   mn = d;
-			   index = j;
-		   }
-	  }
-	  ++ values[index];
+    keypoints_.select(segment, scan, positions);
+    selected.resize(positions.size());
+    for (uint32_t i = 0; i < positions.size(); ++i)
+      selected[i] = segment.indexes[positions[i]];
+    indexes = &selected;
   }
 
+  // the point descriptors of all points are computed at once, which might be parallelized by the descriptor.
+  std::vector<float> features(indexes->size() * D);
+  if (!indexes->empty()) descriptor_->evaluate(&features[0], *indexes, upvector, scan, nn);
+
+  evaluate(values, features.empty() ? 0 : &features[0], indexes->size());
+}
+
+void BagOfWordsDescriptor::evaluate(float* values, const float* descriptors, uint32_t numPoints) const
+{
+  evaluate(values, reinterpret_cast<const uint8_t*>(descriptors), FORMAT_FLOAT32, numPoints);
+}
+
+void BagOfWordsDescriptor::evaluate(float* values, const uint8_t* descriptors, DescriptorFormat format,
+    uint32_t numPoints) const
+{
+  memset(values, 0, sizeof(float) * vocabulary_.size());
+  assignWords(values, descriptors, format, 0, numPoints);
   normalizer_->normalize(values, vocabulary_.size());
 }
 
-// Determine for each point in segment the descriptor and find nearest word in dictionary.
-float BagOfWordsDescriptor::distance(const std::vector<float>& a, const std::vector<float>& b) const
+void BagOfWordsDescriptor::evaluate(float* values, const uint8_t* descriptors, DescriptorFormat format,
+    const IndexedSegment& segment, const Laserscan& scan) const
 {
-  float distance = 0.0f;
-  for (uint32_t i = 0; i < a.size(); ++i)
-    distance += std::pow(a[i] - b[i], 2);
+  if (keypoints_.selectsAll())
+  {
+    evaluate(values, descriptors, format, segment.size());
+    return;
+  }
 
-  return distance;
+  memset(values, 0, sizeof(float) * vocabulary_.size());
+  std::vector<uint32_t> positions;
+  keypoints_.select(segment, scan, positions);
+  if (!positions.empty()) assignWords(values, descriptors, format, &positions[0], positions.size());
+  normalizer_->normalize(values, vocabulary_.size());
+}
+
+void BagOfWordsDescriptor::initializeWords()
+{
+  if (tree_.depth() > 1) return;
+
+  const uint32_t W = vocabulary_.size();
+  const uint32_t D = (W > 0) ? vocabulary_[0].size() : 0;
+
+  words_.resize(D, W);
+  wordNorms_.resize(W);
+  for (uint32_t j = 0; j < W; ++j)
+  {
+    words_.col(j) = Eigen::Map<const Eigen::VectorXf>(&vocabulary_[j][0], D);
+    wordNorms_[j] = words_.col(j).squaredNorm();
+  }
 }
 
+// find for each point descriptor the nearest word in dictionary.
+void BagOfWordsDescriptor::assignWords(float* values, const uint8_t* descriptors, DescriptorFormat format,
+    const uint32_t* rows, uint32_t n) const
+{
+  if (vocabulary_.empty()) return;
+
+  const uint32_t D = descriptor_->dim();
+  const uint64_t rowBytes = descriptorBytes(format, D);
+
+  // decoded point descriptors of a block and their scores for all words, allocated once per segment.
+  RowMatrixXf block, scores;
+
+  for (uint32_t start = 0; start < n; start += BLOCK_SIZE)
+  {
+    const uint32_t m = std::min<uint32_t>(BLOCK_SIZE, n - start);
+    block.resize(m, D);
+    for (uint32_t i = 0; i < m; ++i)
+    {
+      const uint64_t row = (rows != 0) ? rows[start + i] : start + i;
+      decodeDescriptor(format, descriptors + row * rowBytes, D, block.row(i).data());
+    }
+
+    if (tree_.depth() > 1)
+    {
+      for (uint32_t i = 0; i < m; ++i)
+        ++values[tree_.lookup(block.row(i).data())];
+      continue;
+    }
+
+    // ||x - v||^2 - ||x||^2 = ||v||^2 - 2 <x, v> for all descriptors x of the block and all words v.
+    scores.noalias() = -2.0f * block * words_;
+    scores.rowwise() += wordNorms_;
+
+    for (uint32_t i = 0; i < m; ++i)
+    {
+      Eigen::DenseIndex index;
+      scores.row(i).minCoeff(&index);
+      ++values[index];
+    }
+  }
+}
@@ -5,11 +5,25 @@
 #include <rv/PointDescriptor.h>
 #include <rv/ParameterList.h>
 #include <rv/Normalizer.h>
+#include <eigen3/Eigen/Dense>
+
+#include "DescriptorFormat.h"
+#include "KeypointSelection.h"
+#include "VocabularyTree.h"
 
 /** \brief Implementation of a Bag-of-Words descriptor for a segment
  *
  *  The descriptor takes a pre-trained vocabulary and a point descriptor
- *  to compute a Bag-of-Words histogram.
+ *  to compute a Bag-of-Words histogram. The point descriptors are only evaluated for the keypoints of the segment
+ *  chosen by KeypointSelection with the parameters "keypoints", "max-descriptors", and "keypoint-voxel-size".
+ *
+ *  The nearest words of a block of point descriptors X are determined at once by the squared distances
+ *  ||x||^2 - 2 * X * V^T + ||v||^2 to the words V, where the product is a single matrix multiplication and
+ *  ||x||^2 is omitted, since it does not change the nearest word of x.
+ *
+ *  With a VocabularyTree of depth greater than 1, the histogram bins are the leaves of the tree and the word of a
+ *  point descriptor is looked up in the tree with b * L distance computations instead of computing the distances
+ *  to all words, which allows vocabularies with many thousand words.
  * 
  *  \author behley
  */
@@ -19,6 +33,9 @@ class BagOfWordsDescriptor: public rv::SegmentDescriptor
   public:
     BagOfWordsDescriptor(const rv::ParameterList& params, const rv::PointDescriptor& descriptor,
         const std::vector<std::vector<float> >& vocabulary);
+    /** \brief Bag-of-Words descriptor with the leaves of the given vocabulary tree as words. **/
+    BagOfWordsDescriptor(const rv::ParameterList& params, const rv::PointDescriptor& descriptor,
+        const VocabularyTree& tree);
     ~BagOfWordsDescriptor();
     BagOfWordsDescriptor(const BagOfWordsDescriptor& other);
     BagOfWordsDescriptor& operator=(const BagOfWordsDescriptor& other);
@@ -28,14 +45,48 @@ class BagOfWordsDescriptor: public rv::SegmentDescriptor
     void evaluate(float* values, const rv::IndexedSegment& segment, const rv::Laserscan& scan,
         const rv::NearestNeighborImpl& nn) const;
 
+    /** \brief evaluate the descriptor with the given point descriptors of all points of a segment.
+     *
+     *  The point descriptors are stored consecutively, e.g., as provided by DescriptorCache.
+     */
+    void evaluate(float* values, const float* descriptors, uint32_t numPoints) const;
+
+    /** \brief evaluate the descriptor with encoded point descriptors, which are decoded block by block. **/
+    void evaluate(float* values, const uint8_t* descriptors, DescriptorFormat format, uint32_t numPoints) const;
+
+    /** \brief evaluate the descriptor with the encoded point descriptors of all points of the segment, where only
+     *  the descriptors of the keypoints are used as in the evaluation of the segment.
+     */
+    void evaluate(float* values, const uint8_t* descriptors, DescriptorFormat format, const rv::IndexedSegment& segment,
+        const rv::Laserscan& scan) const;
+
     uint32_t dim() const;
 
   protected:
-    float distance(const std::vector<float>& a, const std::vector<float>& b) const;
+    typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXf;
+
+    /** \brief store the words as columns of a matrix and their squared norms, if they are not looked up in a tree. **/
+    void initializeWords();
+
+    /** \brief increment the histogram bins of the nearest words of n encoded point descriptors, where the i-th
+     *  descriptor is the row rows[i], or the i-th row if no rows are given.
+     */
+    void assignWords(float* values, const uint8_t* descriptors, DescriptorFormat format, const uint32_t* rows,
+        uint32_t n) const;
+
+    // number of point descriptors, which are assigned to words at once.
+    static const uint32_t BLOCK_SIZE = 256;
 
     rv::PointDescriptor* descriptor_;
     rv::Normalizer* normalizer_;
     std::vector<std::vector<float> > vocabulary_;
+    KeypointSelection keypoints_;
+    // hierarchical vocabulary, which is empty if all words are compared.
+    VocabularyTree tree_;
+
+    // words as columns of a D x W matrix and their squared norms.
+    Eigen::MatrixXf words_;
+    Eigen::RowVectorXf wordNorms_;
 };
 
 #endif /* BAGOFWORDSDESCRIPTOR_H_ */
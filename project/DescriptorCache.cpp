@@ -0,0 +1,169 @@
+#include "DescriptorCache.h"
+#include "utils.h"
+
+#include <fstream>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+using namespace rv;
+
+namespace
+{
+
+/** header of the binary file written by DescriptorCache::save. **/
+struct DescriptorHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t format;
+    uint32_t rowBytes;
+    uint32_t numSegments;
+    uint32_t numRows;
+    uint64_t key;
+    uint64_t fingerprint;
+};
+
+const char DESCRIPTOR_MAGIC[8] = "DESCR";
+const uint32_t DESCRIPTOR_VERSION = 2;
+
+}
+
+DescriptorCache::DescriptorCache() :
+    dim_(0), format_(FORMAT_FLOAT32), rowBytes_(0), key_(0), fingerprint_(0), data_(0)
+{
+
+}
+
+uint64_t DescriptorCache::key(const ParameterList& params, const ParameterList& search)
+{
+  float epsilon = 0.0f;
+  if (search.hasParam("approximation")) epsilon = search["approximation"];
+
+  // the number of threads does not change the descriptors, and shared neighborhoods only with an exact search.
+  std::vector<std::string> ignored;
+  ignored.push_back("num-threads");
+  if (epsilon == 0.0f) ignored.push_back("shared-neighborhoods");
+  uint64_t key = fingerprint(params, ignored);
+
+  if (epsilon > 0.0f) key = hashBytes(key, &epsilon, sizeof(float));
+
+  return key;
+}
+
+void DescriptorCache::compute(const PointDescriptor& descriptor, uint64_t key, const Laserscan& scan,
+    const std::vector<IndexedSegment>& segments, SegmentNeighborSearch& nn, DescriptorFormat format)
+{
+  if (file_.is_open()) file_.close();
+
+  dim_ = descriptor.dim();
+  format_ = format;
+  rowBytes_ = descriptorBytes(format, dim_);
+  key_ = key;
+  fingerprint_ = fingerprint(scan.points(), segments);
+
+  offsets_.resize(segments.size() + 1);
+  offsets_[0] = 0;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+    offsets_[s + 1] = offsets_[s] + segments[s].size();
+
+  values_.resize(uint64_t(offsets_.back()) * rowBytes_);
+  data_ = values_.empty() ? 0 : &values_[0];
+
+  // descriptors are computed segment by segment as floats and encoded afterwards.
+  std::vector<float> features;
+  Normal3f upvector(0.f, 0.f, 1.f);
+  for (uint32_t s = 0; s < segments.size(); ++s)
+  {
+    if (segments[s].indexes.empty()) continue;
+
+    nn.setSegment(s);
+    features.resize(segments[s].size() * dim_);
+    descriptor.evaluate(&features[0], segments[s].indexes, upvector, scan, nn);
+
+    for (uint32_t k = 0; k < segments[s].size(); ++k)
+      encodeDescriptor(format_, &features[k * dim_], dim_, &values_[uint64_t(offsets_[s] + k) * rowBytes_]);
+  }
+}
+
+bool DescriptorCache::save(const std::string& filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out.is_open()) return false;
+
+  DescriptorHeader header;
+  std::copy(DESCRIPTOR_MAGIC, DESCRIPTOR_MAGIC + 8, header.magic);
+  header.version = DESCRIPTOR_VERSION;
+  header.dim = dim_;
+  header.format = format_;
+  header.rowBytes = rowBytes_;
+  header.numSegments = offsets_.empty() ? 0 : offsets_.size() - 1;
+  header.numRows = offsets_.empty() ? 0 : offsets_.back();
+  header.key = key_;
+  header.fingerprint = fingerprint_;
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(DescriptorHeader));
+  if (data_ != 0) out.write(reinterpret_cast<const char*>(data_), uint64_t(header.numRows) * rowBytes_);
+
+  return out.good();
+}
+
+bool DescriptorCache::load(const std::string& filename, uint64_t key, const Laserscan& scan,
+    const std::vector<IndexedSegment>& segments)
+{
+  if (!boost::filesystem::exists(filename)) return false;
+
+  boost::iostreams::mapped_file_source file(filename);
+  if (!file.is_open() || file.size() < sizeof(DescriptorHeader)) return false;
+
+  DescriptorHeader header;
+  std::copy(file.data(), file.data() + sizeof(DescriptorHeader), reinterpret_cast<char*>(&header));
+
+  if (!std::equal(DESCRIPTOR_MAGIC, DESCRIPTOR_MAGIC + 8, header.magic) || header.version != DESCRIPTOR_VERSION)
+    return false;
+  if (header.format > FORMAT_UINT8) return false;
+
+  const DescriptorFormat format = static_cast<DescriptorFormat>(header.format);
+  if (header.rowBytes != descriptorBytes(format, header.dim)) return false;
+  const uint64_t size = sizeof(DescriptorHeader) + uint64_t(header.numRows) * header.rowBytes;
+  if (header.key != key || header.numSegments != segments.size() || file.size() != size) return false;
+  if (header.fingerprint != fingerprint(scan.points(), segments)) return false;
+
+  dim_ = header.dim;
+  format_ = format;
+  rowBytes_ = header.rowBytes;
+  key_ = header.key;
+  fingerprint_ = header.fingerprint;
+
+  offsets_.resize(segments.size() + 1);
+  offsets_[0] = 0;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+    offsets_[s + 1] = offsets_[s] + segments[s].size();
+
+  // the descriptors are not copied, but read directly from the mapped file.
+  values_.clear();
+  file_ = file;
+  data_ = reinterpret_cast<const uint8_t*>(file_.data() + sizeof(DescriptorHeader));
+
+  return true;
+}
+
+uint32_t DescriptorCache::dim() const
+{
+  return dim_;
+}
+
+DescriptorFormat DescriptorCache::format() const
+{
+  return format_;
+}
+
+uint32_t DescriptorCache::rowBytes() const
+{
+  return rowBytes_;
+}
+
+const uint8_t* DescriptorCache::descriptors(uint32_t segment) const
+{
+  return data_ + uint64_t(offsets_[segment]) * rowBytes_;
+}
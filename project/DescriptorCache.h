@@ -0,0 +1,86 @@
+#ifndef DESCRIPTORCACHE_H_
+#define DESCRIPTORCACHE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <rv/PointDescriptor.h>
+#include <rv/IndexedSegment.h>
+#include <rv/ParameterList.h>
+
+#include "SegmentNeighborSearch.h"
+#include "DescriptorFormat.h"
+
+/** \brief point descriptors of all points of all segments of a scan, which can be stored for subsequent runs.
+ *
+ *  The descriptors of a segment are computed with the neighbor search restricted to this segment and are stored
+ *  consecutively as encoded rows (see DescriptorFormat.h), i.e., the descriptor of the k-th point of segment s
+ *  starts at descriptors(s) + k * rowBytes(). With float16 or uint8 rows, the file is 2 or almost 4 times smaller.
+ *
+ *  The file contains a header followed by the descriptors as stored in memory. Loading maps the file into
+ *  memory, such that descriptors are only read from disk when accessed. The header stores a fingerprint of the
+ *  points and segments and a key of the descriptor parameters (see key()), such that outdated files are
+ *  rejected and the descriptors must be computed again.
+ *
+ *  \author you
+ */
+class DescriptorCache
+{
+  public:
+    DescriptorCache();
+
+    /** \brief key of the descriptor parameters, which ignores parameters not changing the descriptors.
+     *
+     *  The descriptor parameters are given by params, and search contains the parameters of the neighbor search,
+     *  where only the approximation of the radius search changes the resulting descriptors. With an approximate
+     *  search, shared neighborhoods of spin images also change the descriptors and are part of the key.
+     */
+    static uint64_t key(const rv::ParameterList& params, const rv::ParameterList& search);
+
+    /** \brief compute the descriptors of all segments with the up-vector as reference axis.
+     *
+     *  The neighbor search must be initialized with the segments. The descriptors are stored in the given format,
+     *  which should be part of the key, e.g., as "format" parameter of the descriptor.
+     */
+    void compute(const rv::PointDescriptor& descriptor, uint64_t key, const rv::Laserscan& scan,
+        const std::vector<rv::IndexedSegment>& segments, SegmentNeighborSearch& nn,
+        DescriptorFormat format = FORMAT_FLOAT32);
+
+    /** \brief write the descriptors to a binary file. **/
+    bool save(const std::string& filename) const;
+
+    /** \brief map the descriptors of a file written by save with the given key, points, and segments. **/
+    bool load(const std::string& filename, uint64_t key, const rv::Laserscan& scan,
+        const std::vector<rv::IndexedSegment>& segments);
+
+    /** \brief dimension of the descriptors. **/
+    uint32_t dim() const;
+
+    /** \brief format of the stored descriptors. **/
+    DescriptorFormat format() const;
+
+    /** \brief number of bytes of a stored descriptor. **/
+    uint32_t rowBytes() const;
+
+    /** \brief encoded descriptors of the points of the given segment. **/
+    const uint8_t* descriptors(uint32_t segment) const;
+
+  protected:
+    uint32_t dim_;
+    DescriptorFormat format_;
+    uint32_t rowBytes_;
+    uint64_t key_;
+    uint64_t fingerprint_;
+    // first row of each segment and the total number of rows as last entry.
+    std::vector<uint32_t> offsets_;
+
+    // either the computed descriptors or the mapped file.
+    std::vector<uint8_t> values_;
+    boost::iostreams::mapped_file_source file_;
+    const uint8_t* data_;
+};
+
+#endif /* DESCRIPTORCACHE_H_ */
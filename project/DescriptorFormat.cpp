@@ -0,0 +1,318 @@
+#include "DescriptorFormat.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <rv/Error.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/** offset and scale of a quantized descriptor, which precede the quantized values. **/
+inline void readRange(const uint8_t* in, float& offset, float& scale)
+{
+  memcpy(&offset, in, sizeof(float));
+  memcpy(&scale, in + sizeof(float), sizeof(float));
+}
+
+inline uint16_t readHalf(const uint8_t* in, uint32_t i)
+{
+  uint16_t value;
+  memcpy(&value, in + 2 * i, sizeof(uint16_t));
+  return value;
+}
+
+}
+
+DescriptorFormat parseDescriptorFormat(const std::string& name)
+{
+  if (name == "float32") return FORMAT_FLOAT32;
+  if (name == "float16") return FORMAT_FLOAT16;
+  if (name == "uint8") return FORMAT_UINT8;
+
+  throw rv::Error("Unknown descriptor format '" + name + "'.");
+}
+
+uint32_t descriptorBytes(DescriptorFormat format, uint32_t dim)
+{
+  switch (format)
+  {
+    case FORMAT_FLOAT32:
+      return dim * sizeof(float);
+    case FORMAT_FLOAT16:
+      return dim * sizeof(uint16_t);
+    case FORMAT_UINT8:
+      return 2 * sizeof(float) + dim;
+  }
+
+  return 0;
+}
+
+void encodeDescriptor(DescriptorFormat format, const float* values, uint32_t dim, uint8_t* out)
+{
+  switch (format)
+  {
+    case FORMAT_FLOAT32:
+      memcpy(out, values, dim * sizeof(float));
+      break;
+    case FORMAT_FLOAT16:
+      for (uint32_t i = 0; i < dim; ++i)
+      {
+        const uint16_t half = floatToHalf(values[i]);
+        memcpy(out + 2 * i, &half, sizeof(uint16_t));
+      }
+      break;
+    case FORMAT_UINT8:
+    {
+      float offset = 0.0f, scale = 0.0f;
+      if (dim > 0)
+      {
+        const float minimum = *std::min_element(values, values + dim);
+        const float maximum = *std::max_element(values, values + dim);
+        offset = minimum;
+        scale = (maximum - minimum) / 255.0f;
+      }
+      memcpy(out, &offset, sizeof(float));
+      memcpy(out + sizeof(float), &scale, sizeof(float));
+
+      uint8_t* q = out + 2 * sizeof(float);
+      for (uint32_t i = 0; i < dim; ++i)
+        q[i] = (scale > 0.0f) ? static_cast<uint8_t>(std::min(255.0f, (values[i] - offset) / scale + 0.5f)) : 0;
+      break;
+    }
+  }
+}
+
+void decodeDescriptor(DescriptorFormat format, const uint8_t* in, uint32_t dim, float* values)
+{
+  std::fill(values, values + dim, 0.0f);
+  addDescriptor(format, in, dim, values);
+}
+
+float descriptorDistanceSqr(DescriptorFormat format, const uint8_t* in, const float* b, uint32_t dim)
+{
+  float distance = 0.0f;
+  switch (format)
+  {
+    case FORMAT_FLOAT32:
+    {
+      const float* a = reinterpret_cast<const float*>(in);
+      for (uint32_t i = 0; i < dim; ++i)
+        distance += (a[i] - b[i]) * (a[i] - b[i]);
+      break;
+    }
+    case FORMAT_FLOAT16:
+    {
+      uint32_t i = 0;
+#if defined(__F16C__)
+      __m256 sum = _mm256_setzero_ps();
+      for (; i + 8 <= dim; i += 8)
+      {
+        const __m256 a = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i)));
+        const __m256 diff = _mm256_sub_ps(a, _mm256_loadu_ps(b + i));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+      }
+      float partial[8];
+      _mm256_storeu_ps(partial, sum);
+      for (uint32_t k = 0; k < 8; ++k)
+        distance += partial[k];
+#endif
+      for (; i < dim; ++i)
+      {
+        const float diff = halfToFloat(readHalf(in, i)) - b[i];
+        distance += diff * diff;
+      }
+      break;
+    }
+    case FORMAT_UINT8:
+    {
+      float offset, scale;
+      readRange(in, offset, scale);
+      const uint8_t* q = in + 2 * sizeof(float);
+      for (uint32_t i = 0; i < dim; ++i)
+      {
+        const float diff = offset + q[i] * scale - b[i];
+        distance += diff * diff;
+      }
+      break;
+    }
+  }
+
+  return distance;
+}
+
+void addDescriptor(DescriptorFormat format, const uint8_t* in, uint32_t dim, float* sum)
+{
+  switch (format)
+  {
+    case FORMAT_FLOAT32:
+    {
+      const float* a = reinterpret_cast<const float*>(in);
+      for (uint32_t i = 0; i < dim; ++i)
+        sum[i] += a[i];
+      break;
+    }
+    case FORMAT_FLOAT16:
+      for (uint32_t i = 0; i < dim; ++i)
+        sum[i] += halfToFloat(readHalf(in, i));
+      break;
+    case FORMAT_UINT8:
+    {
+      float offset, scale;
+      readRange(in, offset, scale);
+      const uint8_t* q = in + 2 * sizeof(float);
+      for (uint32_t i = 0; i < dim; ++i)
+        sum[i] += offset + q[i] * scale;
+      break;
+    }
+  }
+}
+
+uint16_t floatToHalf(float value)
+{
+  uint32_t f;
+  memcpy(&f, &value, sizeof(float));
+
+  const uint32_t sign = (f >> 16) & 0x8000;
+  const int32_t exponent = int32_t((f >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = f & 0x7FFFFF;
+
+  // infinity and NaN.
+  if (exponent == 0xFF - 127 + 15) return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+  // overflow to infinity.
+  if (exponent >= 0x1F) return sign | 0x7C00;
+
+  // subnormal half-precision values or underflow to zero.
+  if (exponent <= 0)
+  {
+    if (exponent < -10) return sign;
+
+    mantissa |= 0x800000;
+    const uint32_t shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+
+    return sign | half;
+  }
+
+  // rounding might carry into the exponent, which gives the correct result.
+  uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;
+
+  return sign | half;
+}
+
+float halfToFloat(uint16_t value)
+{
+  const uint32_t sign = uint32_t(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1F;
+  uint32_t mantissa = value & 0x3FF;
+  uint32_t f;
+
+  if (exponent == 0x1F)
+  {
+    f = sign | 0x7F800000 | (mantissa << 13);
+  }
+  else if (exponent == 0)
+  {
+    if (mantissa == 0)
+    {
+      f = sign;
+    }
+    else
+    {
+      // normalize the subnormal value.
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0)
+      {
+        mantissa <<= 1;
+        --exponent;
+      }
+      f = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  }
+  else
+  {
+    f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float result;
+  memcpy(&result, &f, sizeof(float));
+  return result;
+}
+
+DescriptorMatrix::DescriptorMatrix(DescriptorFormat format, uint32_t dim) :
+    format_(format), dim_(dim), rowBytes_(descriptorBytes(format, dim))
+{
+
+}
+
+void DescriptorMatrix::push_back(const float* values)
+{
+  data_.resize(data_.size() + rowBytes_);
+  encodeDescriptor(format_, values, dim_, &data_[data_.size() - rowBytes_]);
+}
+
+void DescriptorMatrix::push_back(const DescriptorMatrix& other, uint32_t i)
+{
+  data_.insert(data_.end(), other.row(i), other.row(i) + rowBytes_);
+}
+
+void DescriptorMatrix::reserve(uint32_t rows)
+{
+  data_.reserve(uint64_t(rows) * rowBytes_);
+}
+
+void DescriptorMatrix::clear()
+{
+  data_.clear();
+}
+
+uint32_t DescriptorMatrix::size() const
+{
+  return (rowBytes_ == 0) ? 0 : data_.size() / rowBytes_;
+}
+
+uint32_t DescriptorMatrix::dim() const
+{
+  return dim_;
+}
+
+DescriptorFormat DescriptorMatrix::format() const
+{
+  return format_;
+}
+
+uint32_t DescriptorMatrix::rowBytes() const
+{
+  return rowBytes_;
+}
+
+const uint8_t* DescriptorMatrix::row(uint32_t i) const
+{
+  return &data_[uint64_t(i) * rowBytes_];
+}
+
+std::vector<float> DescriptorMatrix::operator[](uint32_t i) const
+{
+  std::vector<float> values(dim_);
+  if (dim_ > 0) decodeDescriptor(format_, row(i), dim_, &values[0]);
+
+  return values;
+}
+
+float DescriptorMatrix::distanceSqr(uint32_t i, const float* b) const
+{
+  return descriptorDistanceSqr(format_, row(i), b, dim_);
+}
+
+void DescriptorMatrix::add(uint32_t i, float* sum) const
+{
+  addDescriptor(format_, row(i), dim_, sum);
+}
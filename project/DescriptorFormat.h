@@ -0,0 +1,84 @@
+#ifndef DESCRIPTORFORMAT_H_
+#define DESCRIPTORFORMAT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Reduced-precision storage of descriptors.
+ *
+ * A descriptor of dimension D is stored as a row of descriptorBytes(format, D) bytes:
+ *   FORMAT_FLOAT32  D floats (4 bytes per value),
+ *   FORMAT_FLOAT16  D IEEE half-precision floats (2 bytes per value),
+ *   FORMAT_UINT8    offset and scale as floats followed by D bytes q, where a value is offset + q * scale,
+ *                   i.e., the range of every descriptor is quantized separately.
+ *
+ * The distance kernels compare an encoded row directly with a float vector, e.g., a word of a vocabulary, without
+ * decoding the row first. If compiled with F16C support, 8 half-precision values are converted at once.
+ */
+
+enum DescriptorFormat
+{
+  FORMAT_FLOAT32, FORMAT_FLOAT16, FORMAT_UINT8
+};
+
+/** \brief format with the given name "float32", "float16", or "uint8"; throws an rv::Error otherwise. **/
+DescriptorFormat parseDescriptorFormat(const std::string& name);
+
+/** \brief number of bytes of an encoded descriptor with dim values. **/
+uint32_t descriptorBytes(DescriptorFormat format, uint32_t dim);
+
+/** \brief encode the dim values and write descriptorBytes(format, dim) bytes to out. **/
+void encodeDescriptor(DescriptorFormat format, const float* values, uint32_t dim, uint8_t* out);
+
+/** \brief decode the encoded descriptor into dim values. **/
+void decodeDescriptor(DescriptorFormat format, const uint8_t* in, uint32_t dim, float* values);
+
+/** \brief squared Euclidean distance between the encoded descriptor and the given vector. **/
+float descriptorDistanceSqr(DescriptorFormat format, const uint8_t* in, const float* b, uint32_t dim);
+
+/** \brief add the decoded values of the encoded descriptor to sum. **/
+void addDescriptor(DescriptorFormat format, const uint8_t* in, uint32_t dim, float* sum);
+
+/** \brief conversion between single and half-precision floats with rounding to nearest even. **/
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+/** \brief encoded descriptors of the same dimension stored consecutively as rows. **/
+class DescriptorMatrix
+{
+  public:
+    DescriptorMatrix(DescriptorFormat format = FORMAT_FLOAT32, uint32_t dim = 0);
+
+    /** \brief encode and append the descriptor with dim() values. **/
+    void push_back(const float* values);
+    /** \brief append the i-th row of other, which must have the same format and dimension. **/
+    void push_back(const DescriptorMatrix& other, uint32_t i);
+
+    void reserve(uint32_t rows);
+    void clear();
+
+    uint32_t size() const;
+    uint32_t dim() const;
+    DescriptorFormat format() const;
+    /** \brief number of bytes of a row. **/
+    uint32_t rowBytes() const;
+
+    const uint8_t* row(uint32_t i) const;
+    /** \brief decoded values of the i-th row. **/
+    std::vector<float> operator[](uint32_t i) const;
+
+    /** \brief squared Euclidean distance between the i-th row and the given vector. **/
+    float distanceSqr(uint32_t i, const float* b) const;
+    /** \brief add the decoded values of the i-th row to sum. **/
+    void add(uint32_t i, float* sum) const;
+
+  protected:
+    DescriptorFormat format_;
+    uint32_t dim_;
+    uint32_t rowBytes_;
+    std::vector<uint8_t> data_;
+};
+
+#endif /* DESCRIPTORFORMAT_H_ */
@@ -0,0 +1,540 @@
+#include "DynamicOctree.h"
+#include <rv/Error.h>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+using namespace rv;
+
+const uint32_t DynamicOctree::MAX_DEPTH;
+const uint32_t DynamicOctree::MAX_LEVELS;
+const uint32_t DynamicOctree::EMPTY;
+
+DynamicOctree::Octant::Octant() :
+    isLeaf(true), x(0.0f), y(0.0f), z(0.0f), extent(0.0f), size(0)
+{
+  std::fill(children, children + 8, EMPTY);
+}
+
+DynamicOctree::DynamicOctree(uint32_t bucketSize, float minExtent) :
+    bucketSize_(bucketSize), minExtent_(minExtent), minSplitExtent_(std::ldexp(minExtent, -int32_t(MAX_DEPTH))), root_(
+        EMPTY)
+{
+
+}
+
+void DynamicOctree::clear()
+{
+  octants_.clear();
+  freeOctants_.clear();
+  root_ = EMPTY;
+}
+
+void DynamicOctree::initialize(const std::vector<Point3f>& points, const std::vector<uint32_t>& indexes)
+{
+  clear();
+
+  for (uint32_t i = 0; i < indexes.size(); ++i)
+    insert(points[indexes[i]], indexes[i]);
+}
+
+uint32_t DynamicOctree::size() const
+{
+  if (root_ == EMPTY) return 0;
+
+  return octants_[root_].size;
+}
+
+uint32_t DynamicOctree::createOctant(float x, float y, float z, float extent)
+{
+  uint32_t idx;
+  if (freeOctants_.empty())
+  {
+    idx = octants_.size();
+    octants_.push_back(Octant());
+  }
+  else
+  {
+    idx = freeOctants_.back();
+    freeOctants_.pop_back();
+  }
+
+  Octant& octant = octants_[idx];
+  octant.isLeaf = true;
+  octant.x = x;
+  octant.y = y;
+  octant.z = z;
+  octant.extent = extent;
+  octant.size = 0;
+  std::fill(octant.children, octant.children + 8, EMPTY);
+  octant.points.clear();
+
+  return idx;
+}
+
+void DynamicOctree::releaseOctant(uint32_t octant)
+{
+  Octant& o = octants_[octant];
+  for (uint32_t c = 0; c < 8; ++c)
+  {
+    if (o.children[c] != EMPTY) releaseOctant(o.children[c]);
+    o.children[c] = EMPTY;
+  }
+  // the capacity of the points is kept for the next use of the octant.
+  o.points.clear();
+  o.size = 0;
+  o.isLeaf = true;
+
+  freeOctants_.push_back(octant);
+}
+
+uint32_t DynamicOctree::mortonCode(float px, float py, float pz, const Octant& octant)
+{
+  uint32_t code = 0;
+  if (px > octant.x) code |= 1;
+  if (py > octant.y) code |= 2;
+  if (pz > octant.z) code |= 4;
+
+  return code;
+}
+
+void DynamicOctree::enlargeRoot(float x, float y, float z)
+{
+  while (true)
+  {
+    const Octant& root = octants_[root_];
+    if (std::abs(x - root.x) <= root.extent && std::abs(y - root.y) <= root.extent
+        && std::abs(z - root.z) <= root.extent) return;
+
+    // every enlargement adds a level above the leafs, which are split until minExtent / 2^MAX_DEPTH.
+    if (root.extent >= std::ldexp(minExtent_, int32_t(MAX_LEVELS - MAX_DEPTH - 1)))
+      throw Error("Point is too far away from the points of the dynamic octree.");
+
+    // the new root has twice the extent and the old root becomes the child in direction of the point.
+    const float cx = root.x + ((x < root.x) ? -root.extent : root.extent);
+    const float cy = root.y + ((y < root.y) ? -root.extent : root.extent);
+    const float cz = root.z + ((z < root.z) ? -root.extent : root.extent);
+    const uint32_t oldRoot = root_;
+
+    root_ = createOctant(cx, cy, cz, 2.0f * octants_[oldRoot].extent);
+    Octant& newRoot = octants_[root_];
+    const Octant& child = octants_[oldRoot];
+    newRoot.isLeaf = false;
+    newRoot.size = child.size;
+    newRoot.children[mortonCode(child.x, child.y, child.z, newRoot)] = oldRoot;
+  }
+}
+
+void DynamicOctree::insert(const Point3f& point, uint32_t index)
+{
+  Entry entry;
+  entry.x = point.x();
+  entry.y = point.y();
+  entry.z = point.z();
+  entry.index = index;
+
+  // an empty root is placed at the new point.
+  if (root_ != EMPTY && octants_[root_].size == 0)
+  {
+    releaseOctant(root_);
+    root_ = EMPTY;
+  }
+  if (root_ == EMPTY) root_ = createOctant(entry.x, entry.y, entry.z, minExtent_);
+
+  enlargeRoot(entry.x, entry.y, entry.z);
+
+  uint32_t idx = root_;
+  while (true)
+  {
+    Octant& octant = octants_[idx];
+    octant.size += 1;
+
+    if (octant.isLeaf)
+    {
+      octant.points.push_back(entry);
+      if (octant.points.size() > bucketSize_ && octant.extent > minSplitExtent_) split(idx);
+      return;
+    }
+
+    const uint32_t code = mortonCode(entry.x, entry.y, entry.z, octant);
+    if (octant.children[code] == EMPTY)
+    {
+      const float e = 0.5f * octant.extent;
+      const float cx = octant.x + ((code & 1) ? e : -e);
+      const float cy = octant.y + ((code & 2) ? e : -e);
+      const float cz = octant.z + ((code & 4) ? e : -e);
+      // Note: octants_ might be reallocated, therefore octant is not used afterwards.
+      const uint32_t child = createOctant(cx, cy, cz, e);
+      octants_[idx].children[code] = child;
+    }
+
+    idx = octants_[idx].children[code];
+  }
+}
+
+void DynamicOctree::split(uint32_t octant)
+{
+  std::vector<Entry> points;
+  points.swap(octants_[octant].points);
+  octants_[octant].isLeaf = false;
+
+  for (uint32_t i = 0; i < points.size(); ++i)
+  {
+    const Octant& o = octants_[octant];
+    const uint32_t code = mortonCode(points[i].x, points[i].y, points[i].z, o);
+    if (o.children[code] == EMPTY)
+    {
+      const float e = 0.5f * o.extent;
+      const uint32_t child = createOctant(o.x + ((code & 1) ? e : -e), o.y + ((code & 2) ? e : -e),
+          o.z + ((code & 4) ? e : -e), e);
+      octants_[octant].children[code] = child;
+    }
+
+    Octant& child = octants_[octants_[octant].children[code]];
+    child.points.push_back(points[i]);
+    child.size += 1;
+  }
+
+  // all points might fall into the same child.
+  for (uint32_t c = 0; c < 8; ++c)
+  {
+    const uint32_t child = octants_[octant].children[c];
+    if (child == EMPTY) continue;
+    if (octants_[child].points.size() > bucketSize_ && octants_[child].extent > minSplitExtent_) split(child);
+  }
+}
+
+void DynamicOctree::merge(uint32_t octant)
+{
+  std::vector<Entry> points;
+  collect(octant, points);
+
+  Octant& o = octants_[octant];
+  for (uint32_t c = 0; c < 8; ++c)
+  {
+    if (o.children[c] != EMPTY) releaseOctant(o.children[c]);
+    o.children[c] = EMPTY;
+  }
+
+  o.isLeaf = true;
+  o.points.swap(points);
+}
+
+void DynamicOctree::collect(uint32_t octant, std::vector<Entry>& points) const
+{
+  const Octant& o = octants_[octant];
+  if (o.isLeaf)
+  {
+    points.insert(points.end(), o.points.begin(), o.points.end());
+    return;
+  }
+
+  for (uint32_t c = 0; c < 8; ++c)
+    if (o.children[c] != EMPTY) collect(o.children[c], points);
+}
+
+bool DynamicOctree::remove(const Point3f& point, uint32_t index)
+{
+  if (root_ == EMPTY) return false;
+
+  Entry entry;
+  entry.x = point.x();
+  entry.y = point.y();
+  entry.z = point.z();
+  entry.index = index;
+
+  return remove(root_, entry);
+}
+
+bool DynamicOctree::remove(uint32_t octant, const Entry& entry)
+{
+  if (octants_[octant].isLeaf)
+  {
+    std::vector<Entry>& points = octants_[octant].points;
+    for (uint32_t i = 0; i < points.size(); ++i)
+    {
+      if (points[i].index != entry.index) continue;
+
+      points[i] = points.back();
+      points.pop_back();
+      octants_[octant].size -= 1;
+      return true;
+    }
+
+    return false;
+  }
+
+  // points on the border between children might be in either child, since the root was enlarged.
+  for (uint32_t c = 0; c < 8; ++c)
+  {
+    const uint32_t child = octants_[octant].children[c];
+    if (child == EMPTY) continue;
+
+    const Octant& o = octants_[child];
+    if (std::abs(entry.x - o.x) > o.extent || std::abs(entry.y - o.y) > o.extent
+        || std::abs(entry.z - o.z) > o.extent) continue;
+
+    if (remove(child, entry))
+    {
+      Octant& parent = octants_[octant];
+      parent.size -= 1;
+      if (octants_[child].size == 0)
+      {
+        parent.children[c] = EMPTY;
+        releaseOctant(child);
+      }
+
+      // merge subtrees with too few points into a leaf.
+      if (2 * octants_[octant].size < bucketSize_) merge(octant);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+struct DynamicOctree::RadiusSearch
+{
+    RadiusSearch(const DynamicOctree& o, const Point3f& q, float r, std::vector<uint32_t>& n,
+        std::vector<Vector3f>* off) :
+        octree(o), query(q), radius(r), neighbors(n), offsets(off)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      octree.radiusSearch(query, radius, neighbors, offsets, dist);
+    }
+
+    const DynamicOctree& octree;
+    const Point3f& query;
+    float radius;
+    std::vector<uint32_t>& neighbors;
+    std::vector<Vector3f>* offsets;
+};
+
+struct DynamicOctree::KnnSearch
+{
+    KnnSearch(const DynamicOctree& o, const Point3f& q, uint32_t num, std::vector<uint32_t>& n) :
+        octree(o), query(q), k(num), neighbors(n)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      octree.knnSearch(query, k, neighbors, dist);
+    }
+
+    const DynamicOctree& octree;
+    const Point3f& query;
+    uint32_t k;
+    std::vector<uint32_t>& neighbors;
+};
+
+void DynamicOctree::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    const Norm& norm) const
+{
+  neighbors.clear();
+  if (root_ == EMPTY) return;
+
+  // dispatch once to the search specialized for the norm.
+  RadiusSearch search(*this, query, radius, neighbors, 0);
+  dispatchNorm(norm, search);
+}
+
+void DynamicOctree::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>& offsets, const Norm& norm) const
+{
+  neighbors.clear();
+  offsets.clear();
+  if (root_ == EMPTY) return;
+
+  RadiusSearch search(*this, query, radius, neighbors, &offsets);
+  dispatchNorm(norm, search);
+}
+
+template<typename Distance>
+void DynamicOctree::radiusSearch(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>* offsets, const Distance& dist) const
+{
+  const float threshold = dist.threshold(radius);
+
+  // depth-first traversal: at most 7 siblings per level wait on the stack.
+  uint32_t stack[8 * MAX_LEVELS + 1];
+  uint32_t top = 0;
+  stack[top++] = root_;
+
+  while (top > 0)
+  {
+    const Octant& octant = octants_[stack[--top]];
+
+    if (octant.size == 0) continue;
+
+    // octants inside the search ball are added as a whole, including all their children.
+    if (contains(query, threshold, octant, dist))
+    {
+      addOctant(octant, query, neighbors, offsets);
+      continue;
+    }
+
+    if (octant.isLeaf)
+    {
+      for (uint32_t i = 0; i < octant.points.size(); ++i)
+      {
+        const Entry& p = octant.points[i];
+        const float x = p.x - query.x(), y = p.y - query.y(), z = p.z - query.z();
+        if (dist.compare(x, y, z) > threshold) continue;
+
+        neighbors.push_back(p.index);
+        if (offsets != 0) offsets->push_back(Vector3f(x, y, z));
+      }
+      continue;
+    }
+
+    for (int32_t c = 7; c >= 0; --c)
+    {
+      const uint32_t child = octant.children[c];
+      if (child != EMPTY && overlaps(query, radius, threshold, octants_[child], dist)) stack[top++] = child;
+    }
+  }
+}
+
+void DynamicOctree::addOctant(const Octant& octant, const Point3f& query, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>* offsets) const
+{
+  if (octant.isLeaf)
+  {
+    for (uint32_t i = 0; i < octant.points.size(); ++i)
+    {
+      const Entry& p = octant.points[i];
+      neighbors.push_back(p.index);
+      if (offsets != 0) offsets->push_back(Vector3f(p.x - query.x(), p.y - query.y(), p.z - query.z()));
+    }
+    return;
+  }
+
+  // the recursion is bounded by MAX_LEVELS.
+  for (uint32_t c = 0; c < 8; ++c)
+    if (octant.children[c] != EMPTY) addOctant(octants_[octant.children[c]], query, neighbors, offsets);
+}
+
+void DynamicOctree::knnNeighbors(const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+    const Norm& norm) const
+{
+  neighbors.clear();
+  if (root_ == EMPTY || k == 0) return;
+
+  KnnSearch search(*this, query, k, neighbors);
+  dispatchNorm(norm, search);
+}
+
+template<typename Distance>
+void DynamicOctree::knnSearch(const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  // the heaps are ordered by dist.compare, which is monotonic in the distance.
+  typedef std::pair<float, uint32_t> Candidate;
+  const std::greater<Candidate> farther;
+
+  // max-heap of the k closest points found so far, i.e., the current k-th neighbor is at the front.
+  std::vector<Candidate> closest;
+  closest.reserve(k);
+  // min-heap of octants ordered by their distance to the query.
+  std::vector<Candidate> queue;
+  queue.push_back(Candidate(minDistance(query, octants_[root_], dist), root_));
+
+  while (!queue.empty())
+  {
+    std::pop_heap(queue.begin(), queue.end(), farther);
+    const Candidate next = queue.back();
+    queue.pop_back();
+
+    // all remaining octants are farther away than the current k-th neighbor.
+    if (closest.size() == k && next.first > closest.front().first) break;
+
+    const Octant& octant = octants_[next.second];
+    if (octant.isLeaf)
+    {
+      for (uint32_t i = 0; i < octant.points.size(); ++i)
+      {
+        const Entry& p = octant.points[i];
+        const Candidate candidate(dist.compare(p.x - query.x(), p.y - query.y(), p.z - query.z()), p.index);
+        if (closest.size() < k)
+        {
+          closest.push_back(candidate);
+          std::push_heap(closest.begin(), closest.end());
+        }
+        else if (candidate < closest.front())
+        {
+          std::pop_heap(closest.begin(), closest.end());
+          closest.back() = candidate;
+          std::push_heap(closest.begin(), closest.end());
+        }
+      }
+      continue;
+    }
+
+    for (uint32_t c = 0; c < 8; ++c)
+    {
+      if (octant.children[c] == EMPTY) continue;
+
+      const float d = minDistance(query, octants_[octant.children[c]], dist);
+      if (closest.size() == k && d > closest.front().first) continue;
+
+      queue.push_back(Candidate(d, octant.children[c]));
+      std::push_heap(queue.begin(), queue.end(), farther);
+    }
+  }
+
+  std::sort_heap(closest.begin(), closest.end());
+  neighbors.resize(closest.size());
+  for (uint32_t i = 0; i < closest.size(); ++i)
+    neighbors[i] = closest[i].second;
+}
+
+template<typename Distance>
+bool DynamicOctree::overlaps(const Point3f& query, float radius, float threshold, const Octant& o,
+    const Distance& dist)
+{
+  // we exploit the symmetry to reduce the test to testing if its inside the Minkowski sum around the positive quadrant.
+  float x = std::abs(query.x() - o.x);
+  float y = std::abs(query.y() - o.y);
+  float z = std::abs(query.z() - o.z);
+
+  // (1) checking the line region.
+  float maxdist = radius + o.extent;
+
+  // a. completely outside, since q' is outside the relevant area.
+  if (x > maxdist || y > maxdist || z > maxdist) return false;
+
+  // b. inside the line region, one of the coordinates is inside the square.
+  if (x < o.extent || y < o.extent || z < o.extent) return true;
+
+  // (2) checking the corner region...
+  return (dist.compare(x - o.extent, y - o.extent, z - o.extent) <= threshold);
+}
+
+template<typename Distance>
+bool DynamicOctree::contains(const Point3f& query, float threshold, const Octant& o, const Distance& dist)
+{
+  // we exploit the symmetry to reduce the test to test whether the farthest corner is inside the search ball.
+  float x = std::abs(query.x() - o.x) + o.extent;
+  float y = std::abs(query.y() - o.y) + o.extent;
+  float z = std::abs(query.z() - o.z) + o.extent;
+
+  return (dist.compare(x, y, z) <= threshold);
+}
+
+template<typename Distance>
+float DynamicOctree::minDistance(const Point3f& query, const Octant& o, const Distance& dist)
+{
+  // distance to the closest point of the box along each axis.
+  float x = std::max(0.0f, std::abs(query.x() - o.x) - o.extent);
+  float y = std::max(0.0f, std::abs(query.y() - o.y) - o.extent);
+  float z = std::max(0.0f, std::abs(query.z() - o.z) - o.extent);
+
+  return dist.compare(x, y, z);
+}
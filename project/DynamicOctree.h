@@ -0,0 +1,178 @@
+#ifndef DYNAMICOCTREE_H_
+#define DYNAMICOCTREE_H_
+
+#include <vector>
+#include <rv/geometry.h>
+#include <rv/norms.h>
+#include <rv/NearestNeighborImpl.h>
+
+// forward declaration needed for gtest access to protected/private members ...
+namespace
+{
+class DynamicOctreeTest;
+}
+
+/** \brief Octree supporting insertion and removal of single points.
+ *
+ *  The Octree sorts all points by their Morton code, which makes it fast to build and query, but does not
+ *  allow to change the points afterwards. The DynamicOctree is intended for a sliding window of points, e.g.,
+ *  the last N scans around the vehicle, where the cost of an update is proportional to the number of
+ *  points that changed:
+ *
+ *  - a leaf is split, when it contains more than bucketSize points,
+ *  - an octant is merged into a leaf, when its subtree contains less than bucketSize / 2 points,
+ *  - the root is enlarged, when a point outside of the root octant is inserted.
+ *
+ *  Points are identified by their index, which is returned by the neighbor searches. Removal needs the
+ *  coordinates of the point to find its leaf.
+ *
+ *  The root can be enlarged until its extent is minExtent * 2^(MAX_LEVELS - MAX_DEPTH - 1), which bounds
+ *  the depth of the octree, such that the searches need no allocation for their stack.
+ *
+ *  \author you
+ */
+class DynamicOctree: public rv::NearestNeighborImpl
+{
+    friend class ::DynamicOctreeTest;
+  public:
+    /** \param bucketSize    maximal number of points in a leaf.
+     *  \param minExtent     extent of the root, when the first point is inserted.
+     */
+    DynamicOctree(uint32_t bucketSize = 32, float minExtent = 1.0f);
+
+    void clear();
+
+    /** \brief insert the indexed points into an empty octree. **/
+    void initialize(const std::vector<rv::Point3f>& points, const std::vector<uint32_t>& indexes);
+
+    /** \brief insert point with given index.
+     *
+     *  Throws rv::Error, if the root would have to be enlarged beyond its maximal extent.
+     */
+    void insert(const rv::Point3f& point, uint32_t index);
+
+    /** \brief remove point with given index, which was inserted at the given coordinates.
+     *  \return true, if the point was found, false otherwise.
+     */
+    bool remove(const rv::Point3f& point, uint32_t index);
+
+    /** \brief number of points in the octree. **/
+    uint32_t size() const;
+
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        const rv::Norm& dist) const;
+
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>& offsets, const rv::Norm& dist) const;
+
+    void knnNeighbors(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+        const rv::Norm& dist) const;
+
+    // "unhide" the base implementations.
+    using rv::NearestNeighborImpl::initialize;
+    using rv::NearestNeighborImpl::radiusNeighbors;
+  protected:
+    class Entry
+    {
+      public:
+        float x, y, z;
+        uint32_t index;
+    };
+
+    class Octant
+    {
+      public:
+        Octant();
+
+        bool isLeaf;
+
+        // bounding box of the octant needed for overlap and contains tests...
+        float x, y, z;
+        float extent;
+
+        // number of points in the subtree.
+        uint32_t size;
+
+        // index of child octants in octants_ in the order of the Morton codes, or EMPTY.
+        uint32_t children[8];
+
+        // points of a leaf.
+        std::vector<Entry> points;
+    };
+
+    /** \brief get a free octant from the pool. **/
+    uint32_t createOctant(float x, float y, float z, float extent);
+
+    /** \brief return octant and its subtree to the pool. **/
+    void releaseOctant(uint32_t octant);
+
+    /** \brief get Morton code of (px, py, pz) in respect to the center of the octant. **/
+    static uint32_t mortonCode(float px, float py, float pz, const Octant& octant);
+
+    /** \brief enlarge the root until it contains the point. **/
+    void enlargeRoot(float x, float y, float z);
+
+    /** \brief move the points of a leaf into new child octants. **/
+    void split(uint32_t octant);
+
+    /** \brief replace the subtree of the octant by a leaf containing all points. **/
+    void merge(uint32_t octant);
+
+    /** \brief remove the point from the subtree of the octant and merge octants with too few points. **/
+    bool remove(uint32_t octant, const Entry& entry);
+
+    /** \brief append all points of the subtree. **/
+    void collect(uint32_t octant, std::vector<Entry>& points) const;
+
+    /** \brief depth-first radius neighbors search specialized for the distance of a norm.
+     *
+     *  The Distance is a norm policy of rv/norms.h, such that a point p is a neighbor if
+     *  compare(p - q) <= threshold(radius). The offsets are only collected if given.
+     */
+    template<typename Distance>
+    void radiusSearch(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>* offsets, const Distance& dist) const;
+
+    /** \brief best-first k nearest neighbors search specialized for the distance of a norm. **/
+    template<typename Distance>
+    void knnSearch(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+
+    /** \brief functors calling the specialized searches with the policy given by rv::dispatchNorm. **/
+    struct RadiusSearch;
+    struct KnnSearch;
+
+    /** \brief add all points of the subtree, which is inside the search ball, without testing their distance. **/
+    void addOctant(const Octant& octant, const rv::Point3f& query, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>* offsets) const;
+
+    /** \brief test if search ball S(q,r) overlaps with octant, where threshold corresponds to the radius. **/
+    template<typename Distance>
+    static bool overlaps(const rv::Point3f& query, float radius, float threshold, const Octant& o,
+        const Distance& dist);
+
+    /** \brief test if search ball S(q,r) contains octant, where threshold corresponds to the radius. **/
+    template<typename Distance>
+    static bool contains(const rv::Point3f& query, float threshold, const Octant& o, const Distance& dist);
+
+    /** \brief dist.compare of the query to the closest point of the octant, which is zero for queries inside. **/
+    template<typename Distance>
+    static float minDistance(const rv::Point3f& query, const Octant& o, const Distance& dist);
+
+    // leafs with extent smaller than minExtent / 2^MAX_DEPTH are not split any further.
+    static const uint32_t MAX_DEPTH = 16;
+    // maximal depth of the octree including enlargements of the root, which bounds the stack of the search.
+    static const uint32_t MAX_LEVELS = 64;
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    uint32_t bucketSize_;
+    float minExtent_;
+    float minSplitExtent_;
+
+    // pool of octants, where released octants are reused.
+    std::vector<Octant> octants_;
+    std::vector<uint32_t> freeOctants_;
+    uint32_t root_;
+};
+
+#endif /* DYNAMICOCTREE_H_ */
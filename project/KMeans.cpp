@@ -8,6 +8,37 @@
 #include<cmath>
 using namespace rv;
 
+namespace
+{
+
+// access to the rows of the data, which are either vectors or encoded descriptors.
+inline float rowDistanceSqr(const std::vector<std::vector<float> >& data, uint32_t i, const std::vector<float>& b)
+{
+  float d = 0.0f;
+  for (uint32_t j = 0; j < b.size(); ++j)
+    d += (data[i][j] - b[j]) * (data[i][j] - b[j]);
+
+  return d;
+}
+
+inline float rowDistanceSqr(const DescriptorMatrix& data, uint32_t i, const std::vector<float>& b)
+{
+  return data.distanceSqr(i, &b[0]);
+}
+
+inline void addRow(const std::vector<std::vector<float> >& data, uint32_t i, std::vector<float>& sum)
+{
+  for (uint32_t j = 0; j < data[i].size(); ++j)
+    sum[j] += data[i][j];
+}
+
+inline void addRow(const DescriptorMatrix& data, uint32_t i, std::vector<float>& sum)
+{
+  data.add(i, &sum[0]);
+}
+
+}
+
 KMeans::KMeans()
 {
 
@@ -15,9 +46,17 @@ KMeans::KMeans()
 
 std::vector<std::vector<float> > KMeans::cluster(const std::vector<std::vector<float> >& data, uint32_t C)
 {
-  const uint32_t N = data.size();
-  const uint32_t D = data[0].size();
+  return cluster(data, data.size(), data[0].size(), C);
+}
+
+std::vector<std::vector<float> > KMeans::cluster(const DescriptorMatrix& data, uint32_t C)
+{
+  return cluster(data, data.size(), data.dim(), C);
+}
 
+template<class Data>
+std::vector<std::vector<float> > KMeans::cluster(const Data& data, uint32_t N, uint32_t D, uint32_t C)
+{
   std::vector<std::vector<float> > centers(C, std::vector<float>(D, 0.0f));
 
   // TODO: (1) initialize centers and (2) compute new centers until convergence.
@@ -33,9 +72,9 @@ std::vector<std::vector<float> > KMeans::cluster(const std::vector<std::vector<f
   bool IsConveraged;
   do
   {
-  for(int i=0;i<data.size();++i)
+  for(int i=0;i<N;++i)
   {
-	  uint32_t nearestClusterIdx = getNearestCluster(clusters,data[i]);
+	  uint32_t nearestClusterIdx = getNearestCluster(clusters,data,i);
 	  clusters[nearestClusterIdx]->add(i);
   }
   IsConveraged = true;
@@ -73,17 +112,18 @@ float KMeans::distanceSqr(const std::vector<float>& a, const std::vector<float>&
 
   return d;
 }
-uint32_t KMeans::getNearestCluster(const std::vector<KMeans::Cluster*>& K_Clusters,const std::vector<float>& fv) const
+template<class Data>
+uint32_t KMeans::getNearestCluster(const std::vector<KMeans::Cluster*>& K_Clusters, const Data& data, uint32_t i) const
 {
 	uint32_t nearestClusterIdx;
 	float minDist = FLT_MAX ;
-	for(int i=0;i<K_Clusters.size();++i)
+	for(int k=0;k<K_Clusters.size();++k)
 	{
-		float dist = distanceSqr(K_Clusters[i]->getCentroid(),fv);
+		float dist = rowDistanceSqr(data,i,K_Clusters[k]->getCentroid());
 		if(dist < minDist)
 		{
 			minDist = dist;
-			nearestClusterIdx = i;
+			nearestClusterIdx = k;
 		}
 	}
 	return nearestClusterIdx;
@@ -112,15 +152,14 @@ void KMeans::Cluster::add(uint32_t featureVectIndx)
 		return;
 	m_clusterData.push_back(featureVectIndx);
 }
-bool KMeans::Cluster::updateCentroid(const std::vector<std::vector<float> >& data)
+template<class Data>
+bool KMeans::Cluster::updateCentroid(const Data& data)
 {
 	std::vector<float> prevCentroid (m_centroid);
 	std::fill(m_centroid.begin(), m_centroid.end(), 0);
 	for(int idx=0;idx < m_clusterData.size();++idx)
 	{
-		uint32_t fvIndx = m_clusterData[idx];
-		for(int i=0;i<data[fvIndx].size();++i)
-			m_centroid[i] += data[fvIndx][i];
+		addRow(data,m_clusterData[idx],m_centroid);
 	}
 	float centroidSum=0,prevCentroidSum=0;
 	for(int i=0;i<m_centroid.size();++i)
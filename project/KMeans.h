@@ -4,6 +4,7 @@
 #include <vector>
 #include <stdint.h>
 
+#include "DescriptorFormat.h"
 
 /** \brief 
  *
@@ -20,8 +21,13 @@ class KMeans
      **/
     std::vector<std::vector<float> > cluster(const std::vector<std::vector<float> >& data, uint32_t C);
 
-  protected:
+    /** \brief cluster encoded descriptors, which are compared to the centers without decoding them first. **/
+    std::vector<std::vector<float> > cluster(const DescriptorMatrix& data, uint32_t C);
 
+  protected:
+    /** \brief clustering of N rows of data with dimension D, which is either vector of vectors or DescriptorMatrix. **/
+    template<class Data>
+    std::vector<std::vector<float> > cluster(const Data& data, uint32_t N, uint32_t D, uint32_t C);
 
     // some helper methods:
     float distanceSqr(const std::vector<float>& a, const std::vector<float>& b) const;
@@ -38,13 +44,15 @@ class KMeans
     	void add(uint32_t);
         void clear();
         bool isExist(uint32_t) const;
-        bool updateCentroid(const std::vector<std::vector<float> >& data);
+        template<class Data>
+        bool updateCentroid(const Data& data);
     private:
         std::vector<uint32_t> m_clusterData;
         std::vector<float> m_centroid;
 
     };
-    uint32_t getNearestCluster(const std::vector<KMeans::Cluster*>& K_Clusters,const std::vector<float>& fv) const;
+    template<class Data>
+    uint32_t getNearestCluster(const std::vector<KMeans::Cluster*>& K_Clusters, const Data& data, uint32_t i) const;
 };
 
 #endif /* KMEANS_H_ */
@@ -0,0 +1,180 @@
+#include "KeypointSelection.h"
+#include "utils.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <rv/Error.h>
+
+using namespace rv;
+
+namespace
+{
+
+inline float distanceSqr(const Point3f& a, const Point3f& b)
+{
+  const float dx = a.x() - b.x(), dy = a.y() - b.y(), dz = a.z() - b.z();
+  return dx * dx + dy * dy + dz * dz;
+}
+
+}
+
+KeypointSelection::KeypointSelection(const ParameterList& params) :
+    strategy_(ALL), maxDescriptors_(0), voxelSize_(0.1f)
+{
+  if (params.hasParam("keypoints"))
+  {
+    std::string name = params["keypoints"];
+    if (name == "all")
+      strategy_ = ALL;
+    else if (name == "random")
+      strategy_ = RANDOM;
+    else if (name == "voxel-grid")
+      strategy_ = VOXEL_GRID;
+    else if (name == "farthest-point")
+      strategy_ = FARTHEST_POINT;
+    else
+      throw Error("Unknown keypoint selection '" + name + "'.");
+  }
+  if (params.hasParam("max-descriptors")) maxDescriptors_ = params["max-descriptors"];
+  if (params.hasParam("keypoint-voxel-size")) voxelSize_ = params["keypoint-voxel-size"];
+}
+
+bool KeypointSelection::selectsAll() const
+{
+  return strategy_ == ALL || (strategy_ != VOXEL_GRID && maxDescriptors_ == 0);
+}
+
+void KeypointSelection::select(const IndexedSegment& segment, const Laserscan& scan,
+    std::vector<uint32_t>& positions) const
+{
+  const uint32_t N = segment.size();
+  positions.clear();
+  if (N == 0) return;
+
+  if (selectsAll() || (strategy_ != VOXEL_GRID && N <= maxDescriptors_))
+  {
+    for (uint32_t i = 0; i < N; ++i)
+      positions.push_back(i);
+    return;
+  }
+
+  // the seed depends only on the segment, such that the selection is independent of previous segments.
+  Random rand(static_cast<int32_t>(N * 2654435761u + segment.indexes[0]));
+
+  switch (strategy_)
+  {
+    case RANDOM:
+      for (uint32_t i = 0; i < N; ++i)
+        positions.push_back(i);
+      sample(rand, maxDescriptors_, positions);
+      break;
+    case VOXEL_GRID:
+      selectVoxels(rand, segment, scan, positions);
+      break;
+    case FARTHEST_POINT:
+      selectFarthest(segment, scan, positions);
+      break;
+    default:
+      break;
+  }
+
+  std::sort(positions.begin(), positions.end());
+}
+
+void KeypointSelection::sample(Random& rand, uint32_t k, std::vector<uint32_t>& positions) const
+{
+  if (k >= positions.size()) return;
+
+  // partial (knuth-)fisher-yates shuffle.
+  for (uint32_t i = 0; i < k; ++i)
+    std::swap(positions[i], positions[i + rand.getInt(positions.size() - i)]);
+  positions.resize(k);
+}
+
+void KeypointSelection::selectVoxels(Random& rand, const IndexedSegment& segment, const Laserscan& scan,
+    std::vector<uint32_t>& positions) const
+{
+  std::vector<uint32_t> order, groups;
+  groupByVoxels(segment.indexes, scan, voxelSize_, order, groups);
+
+  for (uint32_t v = 0; v + 1 < groups.size(); ++v)
+  {
+    const uint32_t start = groups[v], end = groups[v + 1];
+
+    float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+    for (uint32_t i = start; i < end; ++i)
+    {
+      const Point3f& p = scan.point(segment[order[i]]);
+      cx += p.x();
+      cy += p.y();
+      cz += p.z();
+    }
+    const Point3f centroid(cx / (end - start), cy / (end - start), cz / (end - start));
+
+    uint32_t nearest = order[start];
+    float minDistance = std::numeric_limits<float>::max();
+    for (uint32_t i = start; i < end; ++i)
+    {
+      const float d = distanceSqr(scan.point(segment[order[i]]), centroid);
+      if (d < minDistance)
+      {
+        minDistance = d;
+        nearest = order[i];
+      }
+    }
+    positions.push_back(nearest);
+  }
+
+  if (maxDescriptors_ > 0) sample(rand, maxDescriptors_, positions);
+}
+
+void KeypointSelection::selectFarthest(const IndexedSegment& segment, const Laserscan& scan,
+    std::vector<uint32_t>& positions) const
+{
+  const uint32_t N = segment.size();
+
+  float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const Point3f& p = scan.point(segment[i]);
+    cx += p.x();
+    cy += p.y();
+    cz += p.z();
+  }
+  const Point3f centroid(cx / N, cy / N, cz / N);
+
+  uint32_t next = 0;
+  float minDistance = std::numeric_limits<float>::max();
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const float d = distanceSqr(scan.point(segment[i]), centroid);
+    if (d < minDistance)
+    {
+      minDistance = d;
+      next = i;
+    }
+  }
+
+  // distance of every point to the nearest selected point.
+  std::vector<float> distances(N, std::numeric_limits<float>::max());
+  while (positions.size() < maxDescriptors_)
+  {
+    positions.push_back(next);
+    const Point3f& q = scan.point(segment[next]);
+
+    float maxDistance = -1.0f;
+    for (uint32_t i = 0; i < N; ++i)
+    {
+      distances[i] = std::min(distances[i], distanceSqr(scan.point(segment[i]), q));
+      if (distances[i] > maxDistance)
+      {
+        maxDistance = distances[i];
+        next = i;
+      }
+    }
+
+    // all points coincide with selected points, e.g., duplicate returns, thus no further point can be selected.
+    if (maxDistance <= 0.0f) break;
+  }
+}
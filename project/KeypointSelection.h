@@ -0,0 +1,66 @@
+#ifndef KEYPOINTSELECTION_H_
+#define KEYPOINTSELECTION_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <rv/Laserscan.h>
+#include <rv/IndexedSegment.h>
+#include <rv/ParameterList.h>
+#include <rv/Random.h>
+
+/** \brief selection of the points of a segment, whose point descriptors are evaluated.
+ *
+ *  The point descriptors of a subset of the points of large segments give almost the same Bag-of-Words histogram
+ *  as the descriptors of all points, but bound the costs of a segment by the number of selected points.
+ *
+ *  Parameters
+ *    keypoints:string             =  "all", "random", "voxel-grid", or "farthest-point". [default: all]
+ *    max-descriptors:integer      =  maximal number of selected points of a segment, 0 = unbounded. [default: 0]
+ *    keypoint-voxel-size:float    =  edge length of the voxels of "voxel-grid". [default: 0.1]
+ *
+ *  Strategies
+ *    all             every point; the maximal number is ignored.
+ *    random          uniformly sampled points.
+ *    voxel-grid      the point nearest to the centroid of the points of every occupied voxel, where voxels are
+ *                    sampled uniformly if there are more voxels than the maximal number.
+ *    farthest-point  starting with the point nearest to the centroid, the point with the largest distance to the
+ *                    selected points is added. Needs a maximal number, since all points are selected otherwise.
+ *                    Stops early if all remaining points coincide with selected points.
+ *
+ *  The selection of a segment is deterministic, i.e., the same segment always gives the same points, independent
+ *  of the order of evaluation. Thus, descriptors of a DescriptorCache can be selected in the same way.
+ *
+ *  \author you
+ */
+class KeypointSelection
+{
+  public:
+    enum Strategy
+    {
+      ALL, RANDOM, VOXEL_GRID, FARTHEST_POINT
+    };
+
+    KeypointSelection(const rv::ParameterList& params);
+
+    /** \brief select the positions in segment.indexes of the keypoints, which are sorted ascendingly. **/
+    void select(const rv::IndexedSegment& segment, const rv::Laserscan& scan, std::vector<uint32_t>& positions) const;
+
+    /** \brief true, if every point is selected regardless of the segment. **/
+    bool selectsAll() const;
+
+  protected:
+    /** \brief uniformly sample k of the given positions. **/
+    void sample(rv::Random& rand, uint32_t k, std::vector<uint32_t>& positions) const;
+
+    void selectVoxels(rv::Random& rand, const rv::IndexedSegment& segment, const rv::Laserscan& scan,
+        std::vector<uint32_t>& positions) const;
+    void selectFarthest(const rv::IndexedSegment& segment, const rv::Laserscan& scan,
+        std::vector<uint32_t>& positions) const;
+
+    Strategy strategy_;
+    uint32_t maxDescriptors_;
+    float voxelSize_;
+};
+
+#endif /* KEYPOINTSELECTION_H_ */
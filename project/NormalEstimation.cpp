@@ -0,0 +1,312 @@
+#include "NormalEstimation.h"
+
+#include <cmath>
+#include <algorithm>
+#include <rv/Math.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace rv;
+
+namespace
+{
+
+#if defined(__AVX2__)
+
+inline float horizontalSum(__m256 v)
+{
+  float values[8];
+  _mm256_storeu_ps(values, v);
+
+  return ((values[0] + values[1]) + (values[2] + values[3])) + ((values[4] + values[5]) + (values[6] + values[7]));
+}
+
+uint32_t accumulate(const float* x, const float* y, const float* z, uint32_t n, float* sums)
+{
+  __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+  __m256 sxx = _mm256_setzero_ps(), sxy = _mm256_setzero_ps(), sxz = _mm256_setzero_ps();
+  __m256 syy = _mm256_setzero_ps(), syz = _mm256_setzero_ps(), szz = _mm256_setzero_ps();
+
+  uint32_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    const __m256 dx = _mm256_loadu_ps(x + k), dy = _mm256_loadu_ps(y + k), dz = _mm256_loadu_ps(z + k);
+
+    sx = _mm256_add_ps(sx, dx);
+    sy = _mm256_add_ps(sy, dy);
+    sz = _mm256_add_ps(sz, dz);
+    sxx = _mm256_add_ps(sxx, _mm256_mul_ps(dx, dx));
+    sxy = _mm256_add_ps(sxy, _mm256_mul_ps(dx, dy));
+    sxz = _mm256_add_ps(sxz, _mm256_mul_ps(dx, dz));
+    syy = _mm256_add_ps(syy, _mm256_mul_ps(dy, dy));
+    syz = _mm256_add_ps(syz, _mm256_mul_ps(dy, dz));
+    szz = _mm256_add_ps(szz, _mm256_mul_ps(dz, dz));
+  }
+
+  sums[0] += horizontalSum(sx);
+  sums[1] += horizontalSum(sy);
+  sums[2] += horizontalSum(sz);
+  sums[3] += horizontalSum(sxx);
+  sums[4] += horizontalSum(sxy);
+  sums[5] += horizontalSum(sxz);
+  sums[6] += horizontalSum(syy);
+  sums[7] += horizontalSum(syz);
+  sums[8] += horizontalSum(szz);
+
+  return k;
+}
+
+#elif defined(__SSE2__)
+
+inline float horizontalSum(__m128 v)
+{
+  float values[4];
+  _mm_storeu_ps(values, v);
+
+  return (values[0] + values[1]) + (values[2] + values[3]);
+}
+
+uint32_t accumulate(const float* x, const float* y, const float* z, uint32_t n, float* sums)
+{
+  __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+  __m128 sxx = _mm_setzero_ps(), sxy = _mm_setzero_ps(), sxz = _mm_setzero_ps();
+  __m128 syy = _mm_setzero_ps(), syz = _mm_setzero_ps(), szz = _mm_setzero_ps();
+
+  uint32_t k = 0;
+  for (; k + 4 <= n; k += 4)
+  {
+    const __m128 dx = _mm_loadu_ps(x + k), dy = _mm_loadu_ps(y + k), dz = _mm_loadu_ps(z + k);
+
+    sx = _mm_add_ps(sx, dx);
+    sy = _mm_add_ps(sy, dy);
+    sz = _mm_add_ps(sz, dz);
+    sxx = _mm_add_ps(sxx, _mm_mul_ps(dx, dx));
+    sxy = _mm_add_ps(sxy, _mm_mul_ps(dx, dy));
+    sxz = _mm_add_ps(sxz, _mm_mul_ps(dx, dz));
+    syy = _mm_add_ps(syy, _mm_mul_ps(dy, dy));
+    syz = _mm_add_ps(syz, _mm_mul_ps(dy, dz));
+    szz = _mm_add_ps(szz, _mm_mul_ps(dz, dz));
+  }
+
+  sums[0] += horizontalSum(sx);
+  sums[1] += horizontalSum(sy);
+  sums[2] += horizontalSum(sz);
+  sums[3] += horizontalSum(sxx);
+  sums[4] += horizontalSum(sxy);
+  sums[5] += horizontalSum(sxz);
+  sums[6] += horizontalSum(syy);
+  sums[7] += horizontalSum(syz);
+  sums[8] += horizontalSum(szz);
+
+  return k;
+}
+
+#else
+
+uint32_t accumulate(const float* x, const float* y, const float* z, uint32_t n, float* sums)
+{
+  return 0;
+}
+
+#endif
+
+inline void cross(const double* a, const double* b, double* c)
+{
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot(const double* a, const double* b)
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+}
+
+const uint32_t NormalEstimation::BLOCK_SIZE;
+
+NormalEstimation::NormalEstimation(const ParameterList& params) :
+    radius_(0.0f), numThreads_(1)
+{
+  if (params.hasParam("radius")) radius_ = params["radius"];
+  if (params.hasParam("normal-radius")) radius_ = params["normal-radius"];
+  if (params.hasParam("num-threads")) numThreads_ = params["num-threads"];
+}
+
+void NormalEstimation::estimate(Laserscan& scan, const std::vector<IndexedSegment>& segments,
+    const NearestNeighborImpl& nn) const
+{
+  scan.normals().assign(scan.points().size(), Normal3f(0.0f, 0.0f, 1.0f));
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+    indexes.insert(indexes.end(), segments[s].indexes.begin(), segments[s].indexes.end());
+
+  const Point3f sensor = scan.pose()(Point3f(0.0f, 0.0f, 0.0f));
+  uint32_t next = 0;
+  boost::mutex mutex;
+
+  const uint32_t numBlocks = (indexes.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  if (numThreads_ < 2 || numBlocks < 2)
+  {
+    estimateBlocks(&scan, &indexes, &sensor, &nn, &next, &mutex);
+    return;
+  }
+
+  boost::thread_group threads;
+  for (uint32_t t = 0; t < std::min<uint32_t>(numThreads_, numBlocks); ++t)
+    threads.create_thread(
+        boost::bind(&NormalEstimation::estimateBlocks, this, &scan, &indexes, &sensor, &nn, &next, &mutex));
+  threads.join_all();
+}
+
+void NormalEstimation::estimateBlocks(Laserscan* scan, const std::vector<uint32_t>* indexes, const Point3f* sensor,
+    const NearestNeighborImpl* nn, uint32_t* next, boost::mutex* mutex) const
+{
+  Buffers buffers;
+
+  while (true)
+  {
+    uint32_t start;
+    {
+      boost::mutex::scoped_lock lock(*mutex);
+      if (*next >= indexes->size()) return;
+      start = *next;
+      *next += BLOCK_SIZE;
+    }
+
+    // every point has its own normal, therefore no further synchronization is needed.
+    const uint32_t end = std::min<uint32_t>(start + BLOCK_SIZE, indexes->size());
+    for (uint32_t i = start; i < end; ++i)
+    {
+      const uint32_t idx = (*indexes)[i];
+      scan->normals()[idx] = estimate(scan->point(idx), *sensor, *nn, buffers);
+    }
+  }
+}
+
+Normal3f NormalEstimation::estimate(const Point3f& p, const Point3f& sensor, const NearestNeighborImpl& nn,
+    Buffers& buffers) const
+{
+  EuclideanNorm norm;
+  nn.radiusNeighbors(p, radius_, buffers.neighbors, buffers.offsets, norm);
+
+  const uint32_t N = buffers.offsets.size();
+  if (N < 3) return Normal3f(0.0f, 0.0f, 1.0f);
+
+  buffers.x.resize(N);
+  buffers.y.resize(N);
+  buffers.z.resize(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    buffers.x[i] = buffers.offsets[i].x();
+    buffers.y[i] = buffers.offsets[i].y();
+    buffers.z[i] = buffers.offsets[i].z();
+  }
+
+  float sums[9];
+  covarianceSums(&buffers.x[0], &buffers.y[0], &buffers.z[0], N, sums);
+
+  // the offsets to the query point are used, which avoids cancellation for points far away from the origin.
+  const float mx = sums[0] / N, my = sums[1] / N, mz = sums[2] / N;
+  float covariance[6];
+  covariance[0] = sums[3] / N - mx * mx;
+  covariance[1] = sums[4] / N - mx * my;
+  covariance[2] = sums[5] / N - mx * mz;
+  covariance[3] = sums[6] / N - my * my;
+  covariance[4] = sums[7] / N - my * mz;
+  covariance[5] = sums[8] / N - mz * mz;
+
+  Normal3f normal = smallestEigenvector(covariance);
+  const float orientation = normal.x() * (sensor.x() - p.x()) + normal.y() * (sensor.y() - p.y())
+      + normal.z() * (sensor.z() - p.z());
+  if (orientation < 0.0f) normal = -normal;
+
+  return normal;
+}
+
+void covarianceSums(const float* x, const float* y, const float* z, uint32_t n, float* sums)
+{
+  std::fill(sums, sums + 9, 0.0f);
+
+  // the vectorized kernel processes full vectors and the remaining offsets are added by the reference.
+  const uint32_t k = accumulate(x, y, z, n, sums);
+
+  float tail[9];
+  covarianceSumsScalar(x + k, y + k, z + k, n - k, tail);
+  for (uint32_t i = 0; i < 9; ++i)
+    sums[i] += tail[i];
+}
+
+void covarianceSumsScalar(const float* x, const float* y, const float* z, uint32_t n, float* sums)
+{
+  std::fill(sums, sums + 9, 0.0f);
+
+  for (uint32_t k = 0; k < n; ++k)
+  {
+    sums[0] += x[k];
+    sums[1] += y[k];
+    sums[2] += z[k];
+    sums[3] += x[k] * x[k];
+    sums[4] += x[k] * y[k];
+    sums[5] += x[k] * z[k];
+    sums[6] += y[k] * y[k];
+    sums[7] += y[k] * z[k];
+    sums[8] += z[k] * z[k];
+  }
+}
+
+Normal3f smallestEigenvector(const float* covariance)
+{
+  const double a00 = covariance[0], a01 = covariance[1], a02 = covariance[2];
+  const double a11 = covariance[3], a12 = covariance[4], a22 = covariance[5];
+
+  // eigenvalues of A are q + p * eigenvalues of B = (A - q * I) / p, where det(B) / 2 = cos(3 * phi).
+  const double q = (a00 + a11 + a22) / 3.0;
+  const double b00 = a00 - q, b11 = a11 - q, b22 = a22 - q;
+  const double p2 = b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * (a01 * a01 + a02 * a02 + a12 * a12);
+  // multiple of the identity, i.e., every direction is an eigenvector.
+  if (p2 <= 0.0) return Normal3f(0.0f, 0.0f, 1.0f);
+
+  const double p = std::sqrt(p2 / 6.0);
+  const double det = b00 * (b11 * b22 - a12 * a12) - a01 * (a01 * b22 - a12 * a02) + a02 * (a01 * a12 - b11 * a02);
+  const double r = std::max(-1.0, std::min(1.0, det / (2.0 * p * p * p)));
+  const double phi = std::acos(r) / 3.0;
+  const double lambda = q + 2.0 * p * std::cos(phi + 2.0 * M_PI / 3.0);
+
+  // the eigenvector is orthogonal to the rows of (A - lambda * I).
+  const double rows[3][3] = { { a00 - lambda, a01, a02 }, { a01, a11 - lambda, a12 }, { a02, a12, a22 - lambda } };
+  double candidates[3][3];
+  cross(rows[0], rows[1], candidates[0]);
+  cross(rows[0], rows[2], candidates[1]);
+  cross(rows[1], rows[2], candidates[2]);
+
+  uint32_t best = 0;
+  for (uint32_t i = 1; i < 3; ++i)
+    if (dot(candidates[i], candidates[i]) > dot(candidates[best], candidates[best])) best = i;
+
+  double v[3] = { candidates[best][0], candidates[best][1], candidates[best][2] };
+  if (dot(v, v) <= 1e-12 * p2 * p2)
+  {
+    // the smallest eigenvalue is a double eigenvalue, thus every vector orthogonal to the remaining row works.
+    uint32_t row = 0;
+    for (uint32_t i = 1; i < 3; ++i)
+      if (dot(rows[i], rows[i]) > dot(rows[row], rows[row])) row = i;
+
+    uint32_t axis = 0;
+    for (uint32_t i = 1; i < 3; ++i)
+      if (std::abs(rows[row][i]) < std::abs(rows[row][axis])) axis = i;
+
+    double e[3] = { 0.0, 0.0, 0.0 };
+    e[axis] = 1.0;
+    cross(rows[row], e, v);
+  }
+
+  const double length = std::sqrt(dot(v, v));
+  return Normal3f(v[0] / length, v[1] / length, v[2] / length);
+}
@@ -0,0 +1,86 @@
+#ifndef NORMALESTIMATION_H_
+#define NORMALESTIMATION_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <rv/Laserscan.h>
+#include <rv/IndexedSegment.h>
+#include <rv/NearestNeighborImpl.h>
+#include <rv/ParameterList.h>
+
+namespace boost
+{
+class mutex;
+}
+
+/** \brief estimation of surface normals by principal component analysis of the radius neighbors.
+ *
+ *  The normal of a point is the eigenvector of the smallest eigenvalue of the covariance of its neighbors,
+ *  which is oriented towards the sensor. The covariance is accumulated by a vectorized kernel and the eigenvector
+ *  is determined in closed form, thus no iterative eigen solver is needed.
+ *
+ *  Parameters
+ *    normal-radius:float  =  radius of the neighborhood. [default: radius]
+ *    num-threads:integer  =  number of threads used for the estimation. [default: 1]
+ *
+ *  The parameters are part of the descriptor parameters, such that the radius of the spin image is used if no
+ *  separate radius is given.
+ *
+ *  \author you
+ */
+class NormalEstimation
+{
+  public:
+    NormalEstimation(const rv::ParameterList& params);
+
+    /** \brief estimate the normals of all points of the given segments and store them in scan.normals().
+     *
+     *  The nearest neighbor search must be initialized with the points of the scan and must support concurrent
+     *  queries if multiple threads are used. Points without segment or with less than 3 neighbors get the
+     *  up-vector as normal.
+     */
+    void estimate(rv::Laserscan& scan, const std::vector<rv::IndexedSegment>& segments,
+        const rv::NearestNeighborImpl& nn) const;
+
+  protected:
+    /** \brief buffers of the radius search and the offsets as structure of arrays for the covariance kernel. **/
+    struct Buffers
+    {
+        std::vector<uint32_t> neighbors;
+        std::vector<rv::Vector3f> offsets;
+        std::vector<float> x, y, z;
+    };
+
+    /** \brief normal of a single point oriented towards the sensor. **/
+    rv::Normal3f estimate(const rv::Point3f& p, const rv::Point3f& sensor, const rv::NearestNeighborImpl& nn,
+        Buffers& buffers) const;
+
+    /** \brief estimate blocks of points until all points are taken by threads. **/
+    void estimateBlocks(rv::Laserscan* scan, const std::vector<uint32_t>* indexes, const rv::Point3f* sensor,
+        const rv::NearestNeighborImpl* nn, uint32_t* next, boost::mutex* mutex) const;
+
+    // number of points, which are estimated by a thread at once.
+    static const uint32_t BLOCK_SIZE = 256;
+
+    float radius_;
+    uint32_t numThreads_;
+};
+
+/** \brief accumulate the sums of x, y, z, xx, xy, xz, yy, yz, zz of n offsets given as structure of arrays.
+ *
+ *  Depending on the instruction set, 8 (AVX2) or 4 (SSE2) offsets are accumulated at once.
+ */
+void covarianceSums(const float* x, const float* y, const float* z, uint32_t n, float* sums);
+
+/** \brief scalar reference implementation of covarianceSums. **/
+void covarianceSumsScalar(const float* x, const float* y, const float* z, uint32_t n, float* sums);
+
+/** \brief unit eigenvector of the smallest eigenvalue of the symmetric matrix given by xx, xy, xz, yy, yz, zz.
+ *
+ *  The eigenvalues are determined by the trigonometric solution of the characteristic polynomial and the
+ *  eigenvector by the largest cross product of two rows of (A - lambda * I).
+ */
+rv::Normal3f smallestEigenvector(const float* covariance);
+
+#endif /* NORMALESTIMATION_H_ */
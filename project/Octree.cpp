@@ -1,16 +1,52 @@
 #include "Octree.h"
-#include<queue>
+#include "RadiusScan.h"
+#include "utils.h"
+#include <rv/Error.h>
+#include <algorithm>
+#include <functional>
+#include <boost/bind.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include "stdio.h"
 using namespace rv;
 
+namespace
+{
+
+/** header of the binary file written by Octree::save. **/
+struct OctreeHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t octantSize;
+    uint32_t bucketSize;
+    uint32_t numPoints;
+    uint32_t numOctants;
+    uint32_t hasSegments;
+    uint64_t fingerprint;
+};
+
+const char OCTREE_MAGIC[8] = "OCTREE";
+const uint32_t OCTREE_VERSION = 1;
+
+}
+
+const uint32_t Octree::MAX_DEPTH;
+const uint32_t Octree::QUERY_BLOCK_SIZE;
+const uint32_t Octree::MIN_TASK_SIZE;
+
 Octree::Octree(uint32_t bucketSize) :
-    data_(0), root_(0), bucketSize_(bucketSize)
+    bucketSize_(bucketSize), segment_(ALL_SEGMENTS), numThreads_(1), taskSize_(0), fingerprint_(0), epsilon_(0.0f),
+    numApproximated_(0)
 {
 
 }
 
 Octree::Octree(const Octree& other) :
-    data_(0), root_(0), bucketSize_(0)
+    bucketSize_(0), segment_(ALL_SEGMENTS), numThreads_(1), taskSize_(0), fingerprint_(0), epsilon_(0.0f),
+    numApproximated_(0)
 {
 
 }
@@ -22,28 +58,27 @@ Octree& Octree::operator=(const Octree& other)
 
 Octree::~Octree()
 {
-  delete root_;
+
 }
 
 Octree::Octant::Octant() :
-    isLeaf(true), x(0.0f), y(0.0f), z(0.0f), extent(0.0f), start(0), end(0), size(0)
+    isLeaf(true), numChildren(0), reserved(0), x(0.0f), y(0.0f), z(0.0f), extent(0.0f), start(0), end(0), size(0),
+        child(0), segment(ALL_SEGMENTS)
 {
-  memset(&child, 0, 8 * sizeof(Octant*));
-
-}
 
-Octree::Octant::~Octant()
-{
-  for (uint32_t i = 0; i < 8; ++i)
-    delete child[i];
 }
 
 void Octree::clear()
 {
-  delete root_;
-  root_ = 0;
-  data_ = 0;
-  successors_.clear();
+  // keep the capacity of the buffers for the next initialization.
+  octants_.clear();
+  indexes_.clear();
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  segmentIds_.clear();
+  segment_ = ALL_SEGMENTS;
+  fingerprint_ = 0;
 }
 
 void Octree::initialize(const std::vector<Point3f>& points, const std::vector<uint32_t>& indexes)
@@ -52,36 +87,198 @@ void Octree::initialize(const std::vector<Point3f>& points, const std::vector<ui
 
   if (indexes.size() == 0) return;
 
-  const uint32_t N = points.size();
-  successors_ = std::vector<uint32_t>(N);
-  data_ = &points;
+  const uint32_t N = indexes.size();
+  indexes_.assign(indexes.begin(), indexes.end());
+  x_.resize(N);
+  y_.resize(N);
+  z_.resize(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const Point3f& p = points[indexes[i]];
+    x_[i] = p.x();
+    y_[i] = p.y();
+    z_[i] = p.z();
+  }
+
+  build();
+}
+
+void Octree::initialize(const std::vector<Point3f>& points, const std::vector<IndexedSegment>& segments)
+{
+  clear();
+
+  uint32_t N = 0;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+    N += segments[s].size();
+
+  if (N == 0) return;
+
+  indexes_.resize(N);
+  x_.resize(N);
+  y_.resize(N);
+  z_.resize(N);
+  segmentIds_.resize(N);
+  for (uint32_t s = 0, i = 0; s < segments.size(); ++s)
+  {
+    const std::vector<uint32_t>& indexes = segments[s].indexes;
+    for (uint32_t j = 0; j < indexes.size(); ++j, ++i)
+    {
+      indexes_[i] = indexes[j];
+      const Point3f& p = points[indexes[j]];
+      x_[i] = p.x();
+      y_[i] = p.y();
+      z_[i] = p.z();
+      segmentIds_[i] = s;
+    }
+  }
+
+  fingerprint_ = fingerprint(points, segments);
+  build();
+}
+
+void Octree::setSegment(uint32_t segment)
+{
+  segment_ = segment;
+}
+
+bool Octree::save(const std::string& filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out.is_open()) return false;
+
+  OctreeHeader header;
+  std::copy(OCTREE_MAGIC, OCTREE_MAGIC + 8, header.magic);
+  header.version = OCTREE_VERSION;
+  // the octants are written raw, thus the layout must not contain implicit padding.
+  BOOST_STATIC_ASSERT(sizeof(Octant) == 40);
+  header.octantSize = sizeof(Octant);
+  header.bucketSize = bucketSize_;
+  header.numPoints = indexes_.size();
+  header.numOctants = octants_.size();
+  header.hasSegments = !segmentIds_.empty();
+  header.fingerprint = fingerprint_;
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(OctreeHeader));
+  if (!octants_.empty())
+  {
+    out.write(reinterpret_cast<const char*>(&octants_[0]), octants_.size() * sizeof(Octant));
+    out.write(reinterpret_cast<const char*>(&indexes_[0]), indexes_.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&x_[0]), x_.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(&y_[0]), y_.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(&z_[0]), z_.size() * sizeof(float));
+  }
+  if (!segmentIds_.empty())
+    out.write(reinterpret_cast<const char*>(&segmentIds_[0]), segmentIds_.size() * sizeof(uint32_t));
+
+  return out.good();
+}
+
+bool Octree::load(const std::string& filename, const std::vector<Point3f>& points,
+    const std::vector<IndexedSegment>& segments)
+{
+  if (!boost::filesystem::exists(filename)) return false;
+
+  boost::iostreams::mapped_file_source file(filename);
+  if (!file.is_open() || file.size() < sizeof(OctreeHeader)) return false;
+
+  OctreeHeader header;
+  std::copy(file.data(), file.data() + sizeof(OctreeHeader), reinterpret_cast<char*>(&header));
+
+  const uint32_t N = header.numPoints;
+  const uint64_t size = sizeof(OctreeHeader) + uint64_t(header.numOctants) * sizeof(Octant)
+      + uint64_t(N) * (4 + (header.hasSegments ? 1 : 0)) * sizeof(uint32_t);
+
+  if (!std::equal(OCTREE_MAGIC, OCTREE_MAGIC + 8, header.magic) || header.version != OCTREE_VERSION) return false;
+  if (header.octantSize != sizeof(Octant) || header.bucketSize != bucketSize_) return false;
+  if (header.fingerprint != fingerprint(points, segments) || file.size() != size) return false;
+
+  clear();
+  fingerprint_ = header.fingerprint;
+
+  // the arrays are copied as a whole, since the octree owns its buffers for the next initialization.
+  const char* data = file.data() + sizeof(OctreeHeader);
+  const Octant* octants = reinterpret_cast<const Octant*>(data);
+  octants_.assign(octants, octants + header.numOctants);
+  data += header.numOctants * sizeof(Octant);
+
+  const uint32_t* indexes = reinterpret_cast<const uint32_t*>(data);
+  indexes_.assign(indexes, indexes + N);
+  const float* coords = reinterpret_cast<const float*>(indexes + N);
+  x_.assign(coords, coords + N);
+  y_.assign(coords + N, coords + 2 * N);
+  z_.assign(coords + 2 * N, coords + 3 * N);
+  if (header.hasSegments)
+  {
+    const uint32_t* segmentIds = reinterpret_cast<const uint32_t*>(coords + 3 * N);
+    segmentIds_.assign(segmentIds, segmentIds + N);
+  }
+
+  return true;
+}
+
+void Octree::setNumThreads(uint32_t numThreads)
+{
+  numThreads_ = numThreads;
+}
+
+void Octree::setApproximation(float epsilon)
+{
+  if (!(epsilon >= 0.0f && epsilon < 1.0f)) throw Error("Approximation of the octree must be in [0, 1).");
+  epsilon_ = epsilon;
+}
+
+uint64_t Octree::approximatedPoints() const
+{
+  return numApproximated_.load();
+}
+
+void Octree::resetApproximatedPoints()
+{
+  numApproximated_ = 0;
+}
+
+uint32_t Octree::resultSize(const std::vector<uint32_t>& neighbors)
+{
+  return neighbors.size();
+}
+
+uint32_t Octree::resultSize(const OffsetResult& result)
+{
+  return result.neighbors.size();
+}
+
+uint32_t Octree::resultSize(const uint32_t& count)
+{
+  return count;
+}
+
+void Octree::build()
+{
+  const uint32_t N = indexes_.size();
+  tmpIndexes_.resize(N);
+  tmpX_.resize(N);
+  tmpY_.resize(N);
+  tmpZ_.resize(N);
+  tmpSegmentIds_.resize(segmentIds_.size());
+  codes_.resize(N);
 
   // determine axis-aligned bounding box.
-  uint32_t lastIdx = indexes[0];
   float min[3], max[3];
-  min[0] = points[lastIdx].x();
-  min[1] = points[lastIdx].y();
-  min[2] = points[lastIdx].z();
+  min[0] = x_[0];
+  min[1] = y_[0];
+  min[2] = z_[0];
   max[0] = min[0];
   max[1] = min[1];
   max[2] = min[2];
 
-  for (uint32_t i = 1; i < indexes.size(); ++i)
+  for (uint32_t i = 1; i < N; ++i)
   {
-    uint32_t idx = indexes[i];
-    // initially each element links simply to the following element.
-    successors_[lastIdx] = idx;
-
-    const Point3f& p = points[idx];
-
-    if (p.x() < min[0]) min[0] = p.x();
-    if (p.y() < min[1]) min[1] = p.y();
-    if (p.z() < min[2]) min[2] = p.z();
-    if (p.x() > max[0]) max[0] = p.x();
-    if (p.y() > max[1]) max[1] = p.y();
-    if (p.z() > max[2]) max[2] = p.z();
-
-    lastIdx = idx;
+    if (x_[i] < min[0]) min[0] = x_[i];
+    if (y_[i] < min[1]) min[1] = y_[i];
+    if (z_[i] < min[2]) min[2] = z_[i];
+    if (x_[i] > max[0]) max[0] = x_[i];
+    if (y_[i] > max[1]) max[1] = y_[i];
+    if (z_[i] > max[2]) max[2] = z_[i];
   }
 
   float ctr[3] =
@@ -95,145 +292,672 @@ void Octree::initialize(const std::vector<Point3f>& points, const std::vector<ui
     ctr[i] += extent;
     if (extent > maxextent) maxextent = extent;
   }
-  root_ = createOctant(ctr[0], ctr[1], ctr[2], maxextent, indexes[0], lastIdx, indexes.size());
+
+  octants_.resize(1);
+
+  taskSize_ = std::max(MIN_TASK_SIZE, N / (8 * std::max(numThreads_, 1u)));
+  if (numThreads_ < 2 || N <= taskSize_)
+  {
+    createOctant(octants_, 0, ctr[0], ctr[1], ctr[2], maxextent, 0, N, 0, 0);
+    return;
+  }
+
+  // (1) build the upper levels and collect the subtrees with less than taskSize_ points.
+  std::vector<BuildTask> tasks;
+  createOctant(octants_, 0, ctr[0], ctr[1], ctr[2], maxextent, 0, N, 0, &tasks);
+  const uint32_t numUpper = octants_.size();
+
+  // (2) build the subtrees in parallel.
+  uint32_t next = 0;
+  boost::mutex mutex;
+  boost::thread_group threads;
+  for (uint32_t t = 0; t < std::min<uint32_t>(numThreads_, tasks.size()); ++t)
+    threads.create_thread(boost::bind(&Octree::buildTasks, this, &tasks, &next, &mutex));
+  threads.join_all();
+
+  // (3) append the octants of the subtrees, where the root of a subtree replaces its placeholder.
+  for (uint32_t t = 0; t < tasks.size(); ++t)
+  {
+    const std::vector<Octant>& octants = tasks[t].octants;
+    const uint32_t offset = octants_.size() - 1;
+
+    octants_[tasks[t].octant] = octants[0];
+    if (!octants[0].isLeaf) octants_[tasks[t].octant].child += offset;
+    for (uint32_t i = 1; i < octants.size(); ++i)
+    {
+      octants_.push_back(octants[i]);
+      if (!octants[i].isLeaf) octants_.back().child += offset;
+    }
+  }
+
+  // (4) segments of the upper levels depend on the subtrees; children are stored after their parents.
+  if (!segmentIds_.empty())
+  {
+    for (int32_t i = numUpper - 1; i >= 0; --i)
+      if (!octants_[i].isLeaf) updateSegment(octants_, i);
+  }
 }
 
-uint32_t Octree::mortonCode(const Point3f& p, float x, float y, float z) const
+uint32_t Octree::mortonCode(float px, float py, float pz, float x, float y, float z) const
 {
   uint32_t mortonCode = 0;
 
-  if (p.x() > x) mortonCode |= 1;
-  if (p.y() > y) mortonCode |= 2;
-  if (p.z() > z) mortonCode |= 4;
+  if (px > x) mortonCode |= 1;
+  if (py > y) mortonCode |= 2;
+  if (pz > z) mortonCode |= 4;
 
   return mortonCode;
 }
 
-Octree::Octant* Octree::createOctant(float x, float y, float z, float extent, uint32_t startIdx, uint32_t endIdx,
-    uint32_t size)
-{
-	Octant* oct = new Octant();
-	oct->x=x;oct->y=y;oct->z=z;
-	oct->size = size;
-	oct->start = startIdx;
-	oct->end = endIdx;
-	oct->extent = extent;
-
-	uint32_t M[8],Start[8],End[8];
-	for(int i=0;i<8;++i)
-		M[i]=0,Start[i]=0,End[i]=0;
-
-	if(size > bucketSize_)
-	{
-		uint32_t i = startIdx,j=0;
-		uint32_t lastChild = j;
-		uint32_t firstChild = 8;
-		while(j<size)
-		{
-			Point3f curP;
-			curP = (*data_)[i];
-			uint32_t k = mortonCode(curP,x,y,z);
-			if(M[k] ==0)
-				Start[k] = i;
-			else
-			{
-				successors_[End[k]]=i;
-			}
-			End[k] = i;
-			++ M[k];
-			i = successors_[i];
-			++j;
-
-			if(k < firstChild)
-				firstChild = k;
-		}
-
-		for(int k=0;k<8;++k)
-		{
-			if(M[k]>0)
-			{
-				oct->isLeaf = false;
-				float cX,cY,cZ;
-				cX = x + (((k & 1) > 0 ? 0.5 : -0.5)*extent);
-				cY = y + (((k & 2) > 0 ? 0.5 : -0.5)*extent);
-				cZ = z + (((k & 4) > 0 ? 0.5 : -0.5)*extent);
-				oct->child[k] = createOctant(cX,cY,cZ,extent/2.0,Start[k],End[k],M[k]);
-				Start[k] = oct->child[k]->start;
-				End[k] = oct->child[k]->end;
-				if(k == firstChild)
-					oct->start=Start[k];
-				else
-				{
-					successors_[End[lastChild]]=Start[k];
-				}
-				oct->end = End[k];
-				lastChild = k;
-			}
-		}
-	}
-  return oct;
+void Octree::createOctant(std::vector<Octant>& octants, uint32_t octant, float x, float y, float z, float extent,
+    uint32_t start, uint32_t end, uint32_t depth, std::vector<BuildTask>* tasks)
+{
+  // Note: octants might be reallocated by the recursion, therefore only indexes are kept.
+  Octant* oct = &octants[octant];
+  oct->x = x;
+  oct->y = y;
+  oct->z = z;
+  oct->extent = extent;
+  oct->start = start;
+  oct->end = end;
+  oct->size = end - start;
+
+  // duplicate points cannot be separated, therefore the depth is limited.
+  if (oct->size <= bucketSize_ || depth == MAX_DEPTH)
+  {
+    if (!segmentIds_.empty())
+    {
+      oct->segment = segmentIds_[start];
+      for (uint32_t i = start + 1; i < end; ++i)
+        if (segmentIds_[i] != oct->segment) oct->segment = ALL_SEGMENTS;
+    }
+    return;
+  }
+
+  // partition the range by the Morton code in respect to the center, i.e., one step of a
+  // MSD radix sort. After the recursion, the whole permutation is sorted by Morton code.
+  uint32_t M[8] =
+  { 0, 0, 0, 0, 0, 0, 0, 0 };
+  for (uint32_t i = start; i < end; ++i)
+  {
+    codes_[i] = mortonCode(x_[i], y_[i], z_[i], x, y, z);
+    M[codes_[i]] += 1;
+  }
+
+  uint32_t Start[8];
+  uint32_t numChildren = 0;
+  Start[0] = start;
+  for (uint32_t k = 0; k < 8; ++k)
+  {
+    if (k > 0) Start[k] = Start[k - 1] + M[k - 1];
+    if (M[k] > 0) ++numChildren;
+  }
+
+  uint32_t pos[8];
+  std::copy(Start, Start + 8, pos);
+  for (uint32_t i = start; i < end; ++i)
+  {
+    uint32_t k = codes_[i];
+    tmpIndexes_[pos[k]] = indexes_[i];
+    tmpX_[pos[k]] = x_[i];
+    tmpY_[pos[k]] = y_[i];
+    tmpZ_[pos[k]] = z_[i];
+    if (!segmentIds_.empty()) tmpSegmentIds_[pos[k]] = segmentIds_[i];
+    pos[k] += 1;
+  }
+  std::copy(tmpIndexes_.begin() + start, tmpIndexes_.begin() + end, indexes_.begin() + start);
+  std::copy(tmpX_.begin() + start, tmpX_.begin() + end, x_.begin() + start);
+  std::copy(tmpY_.begin() + start, tmpY_.begin() + end, y_.begin() + start);
+  std::copy(tmpZ_.begin() + start, tmpZ_.begin() + end, z_.begin() + start);
+  if (!segmentIds_.empty())
+    std::copy(tmpSegmentIds_.begin() + start, tmpSegmentIds_.begin() + end, segmentIds_.begin() + start);
+
+  // allocate all children at once, such that siblings are adjacent.
+  const uint32_t firstChild = octants.size();
+  octants.resize(firstChild + numChildren);
+  oct = &octants[octant];
+  oct->isLeaf = false;
+  oct->numChildren = numChildren;
+  oct->child = firstChild;
+
+  uint32_t c = firstChild;
+  for (uint32_t k = 0; k < 8; ++k)
+  {
+    if (M[k] == 0) continue;
+
+    float cX = x + (((k & 1) > 0 ? 0.5f : -0.5f) * extent);
+    float cY = y + (((k & 2) > 0 ? 0.5f : -0.5f) * extent);
+    float cZ = z + (((k & 4) > 0 ? 0.5f : -0.5f) * extent);
+    if (tasks != 0 && M[k] <= taskSize_)
+    {
+      // the subtree is built later by one of the threads.
+      BuildTask task;
+      task.octant = c;
+      task.x = cX;
+      task.y = cY;
+      task.z = cZ;
+      task.extent = 0.5f * extent;
+      task.start = Start[k];
+      task.end = Start[k] + M[k];
+      task.depth = depth + 1;
+      tasks->push_back(task);
+    }
+    else
+    {
+      createOctant(octants, c, cX, cY, cZ, 0.5f * extent, Start[k], Start[k] + M[k], depth + 1, tasks);
+    }
+    ++c;
+  }
+
+  if (!segmentIds_.empty()) updateSegment(octants, octant);
+}
+
+void Octree::updateSegment(std::vector<Octant>& octants, uint32_t octant)
+{
+  Octant* oct = &octants[octant];
+  oct->segment = octants[oct->child].segment;
+  for (uint32_t i = 1; i < oct->numChildren; ++i)
+    if (octants[oct->child + i].segment != oct->segment) oct->segment = ALL_SEGMENTS;
+}
+
+void Octree::buildTasks(std::vector<BuildTask>* tasks, uint32_t* next, boost::mutex* mutex)
+{
+  while (true)
+  {
+    uint32_t t;
+    {
+      boost::mutex::scoped_lock lock(*mutex);
+      if (*next >= tasks->size()) return;
+      t = (*next)++;
+    }
+
+    // the subtrees cover disjoint ranges of the points, therefore no further synchronization is needed.
+    BuildTask& task = (*tasks)[t];
+    task.octants.resize(1);
+    createOctant(task.octants, 0, task.x, task.y, task.z, task.extent, task.start, task.end, task.depth, 0);
+  }
+}
+
+void Octree::addOctant(const Octant* octant, std::vector<uint32_t>& neighbors) const
+{
+  if (segment_ == ALL_SEGMENTS || segmentIds_.empty() || octant->segment == segment_)
+  {
+    // all points of the octant are stored consecutively.
+    neighbors.insert(neighbors.end(), indexes_.begin() + octant->start, indexes_.begin() + octant->end);
+  }
+  else
+  {
+    for (uint32_t i = octant->start; i < octant->end; ++i)
+      if (segmentIds_[i] == segment_) neighbors.push_back(indexes_[i]);
+  }
+}
+
+template<typename Distance>
+void Octree::scanOctant(const Octant* octant, const Point3f& query, float threshold, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  if (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && octant->segment != segment_)
+  {
+    for (uint32_t i = octant->start; i < octant->end; ++i)
+    {
+      if (segmentIds_[i] != segment_) continue;
+      if (dist.compare(x_[i] - query.x(), y_[i] - query.y(), z_[i] - query.z()) <= threshold)
+        neighbors.push_back(indexes_[i]);
+    }
+  }
+  else
+  {
+    const uint32_t s = octant->start;
+    const uint32_t offset = neighbors.size();
+    neighbors.resize(offset + octant->size);
+    uint32_t count = radiusScan(dist, &x_[s], &y_[s], &z_[s], &indexes_[s], octant->size, query.x(), query.y(),
+        query.z(), threshold, &neighbors[offset]);
+    neighbors.resize(offset + count);
+  }
+}
+
+void Octree::addOctant(const Octant* octant, OffsetResult& result) const
+{
+  const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && octant->segment != segment_);
+  for (uint32_t i = octant->start; i < octant->end; ++i)
+  {
+    if (restricted && segmentIds_[i] != segment_) continue;
+    result.neighbors.push_back(indexes_[i]);
+    result.offsets.push_back(
+        Vector3f(x_[i] - result.query.x(), y_[i] - result.query.y(), z_[i] - result.query.z()));
+  }
+}
+
+void Octree::addOctant(const Octant* octant, uint32_t& count) const
+{
+  if (segment_ == ALL_SEGMENTS || segmentIds_.empty() || octant->segment == segment_)
+  {
+    // no need to visit the points.
+    count += octant->size;
+  }
+  else
+  {
+    for (uint32_t i = octant->start; i < octant->end; ++i)
+      if (segmentIds_[i] == segment_) ++count;
+  }
+}
+
+template<typename Distance>
+void Octree::scanOctant(const Octant* octant, const Point3f& query, float threshold, OffsetResult& result,
+    const Distance& dist) const
+{
+  const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && octant->segment != segment_);
+  for (uint32_t i = octant->start; i < octant->end; ++i)
+  {
+    if (restricted && segmentIds_[i] != segment_) continue;
+
+    const float x = x_[i] - query.x(), y = y_[i] - query.y(), z = z_[i] - query.z();
+    if (dist.compare(x, y, z) <= threshold)
+    {
+      result.neighbors.push_back(indexes_[i]);
+      result.offsets.push_back(Vector3f(x, y, z));
+    }
+  }
+}
+
+template<typename Distance>
+void Octree::scanOctant(const Octant* octant, const Point3f& query, float threshold, uint32_t& count,
+    const Distance& dist) const
+{
+  const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && octant->segment != segment_);
+  for (uint32_t i = octant->start; i < octant->end; ++i)
+  {
+    if (restricted && segmentIds_[i] != segment_) continue;
+    if (dist.compare(x_[i] - query.x(), y_[i] - query.y(), z_[i] - query.z()) <= threshold) ++count;
+  }
+}
+
+bool Octree::skip(const Octant* octant) const
+{
+  // with a restriction to a segment, octants of other segments can be skipped.
+  return (segment_ != ALL_SEGMENTS && octant->segment != ALL_SEGMENTS && octant->segment != segment_
+      && !segmentIds_.empty());
+}
+
+uint32_t Octree::segmentSize(const Octant* octant) const
+{
+  if (segment_ == ALL_SEGMENTS || segmentIds_.empty() || octant->segment == segment_) return octant->size;
+
+  uint32_t count = 0;
+  for (uint32_t i = octant->start; i < octant->end; ++i)
+    if (segmentIds_[i] == segment_) ++count;
+
+  return count;
+}
+
+template<typename Distance, typename Result>
+void Octree::radiusNeighbors(const Octant* octant, const Point3f& query, float radius, Result& result,
+    const Distance& dist) const
+{
+  const float threshold = dist.threshold(radius);
+  // octants inside the enlarged ball are added as a whole and octants outside the shrunken ball are skipped.
+  const bool approximate = (epsilon_ > 0.0f);
+  const float outerThreshold = dist.threshold((1.0f + epsilon_) * radius);
+  const float innerRadius = (1.0f - epsilon_) * radius;
+  const float innerThreshold = dist.threshold(innerRadius);
+  uint64_t numApproximated = 0;
+
+  // depth-first traversal: at most 7 siblings per level wait on the stack.
+  uint32_t stack[8 * MAX_DEPTH + 1];
+  uint32_t top = 0;
+  stack[top++] = octant - &octants_[0];
+
+  while (top > 0)
+  {
+    const Octant* curOct = &octants_[stack[--top]];
+
+    if (skip(curOct)) continue;
+
+    if (contains(query, outerThreshold, curOct, dist))
+    {
+      if (approximate && !contains(query, threshold, curOct, dist))
+      {
+        const uint32_t size = resultSize(result);
+        addOctant(curOct, result);
+        numApproximated += resultSize(result) - size;
+      }
+      else
+      {
+        addOctant(curOct, result);
+      }
+      continue;
+    }
+
+    if (curOct->isLeaf)
+    {
+      scanOctant(curOct, query, threshold, result, dist);
+      continue;
+    }
+
+    // push children in reverse order, such that they are visited in Morton order.
+    for (int32_t c = curOct->numChildren - 1; c >= 0; --c)
+    {
+      const uint32_t child = curOct->child + c;
+      if (overlaps(query, innerRadius, innerThreshold, &octants_[child], dist))
+        stack[top++] = child;
+      else if (approximate && !skip(&octants_[child]) && overlaps(query, radius, threshold, &octants_[child], dist))
+        numApproximated += segmentSize(&octants_[child]);
+    }
+  }
+
+  // the search is const and called concurrently, therefore the count is added once per query.
+  if (numApproximated > 0) numApproximated_.fetch_add(numApproximated, boost::memory_order_relaxed);
+}
+
+template<typename Distance>
+void Octree::radiusNeighbors(const std::vector<Point3f>& queries, float radius, std::vector<uint32_t>& offsets,
+    std::vector<uint32_t>& neighbors, const Distance& dist) const
+{
+  const uint32_t N = queries.size();
+  const float threshold = dist.threshold(radius);
+  const Octant& root = octants_[0];
+
+  // (1) sort the queries spatially by their Morton code in respect to the root octant.
+  std::vector<std::pair<uint32_t, uint32_t> > order(N);
+  const float scale = 1024.0f / (2.0f * root.extent + 1e-6f);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    float coords[3] =
+    { queries[i].x() - root.x + root.extent, queries[i].y() - root.y + root.extent, queries[i].z() - root.z
+        + root.extent };
+    uint32_t cell[3];
+    for (uint32_t d = 0; d < 3; ++d)
+      cell[d] = std::min(1023.0f, std::max(0.0f, scale * coords[d]));
+
+    uint32_t code = 0;
+    for (uint32_t b = 0; b < 10; ++b)
+      code |= (((cell[0] >> b) & 1) << (3 * b)) | (((cell[1] >> b) & 1) << (3 * b + 1))
+          | (((cell[2] >> b) & 1) << (3 * b + 2));
+
+    order[i] = std::make_pair(code, i);
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<uint32_t> results;
+  std::vector<uint32_t> begin(N), end(N);
+  std::vector<uint32_t> frontier;
+  uint32_t stack[8 * MAX_DEPTH + 1];
+
+  // (2) traverse the upper levels once for a block of neighboring queries.
+  for (uint32_t blockStart = 0; blockStart < N; blockStart += QUERY_BLOCK_SIZE)
+  {
+    const uint32_t blockEnd = std::min(N, blockStart + QUERY_BLOCK_SIZE);
+
+    float min[3], max[3];
+    const Point3f& first = queries[order[blockStart].second];
+    min[0] = max[0] = first.x();
+    min[1] = max[1] = first.y();
+    min[2] = max[2] = first.z();
+    for (uint32_t i = blockStart + 1; i < blockEnd; ++i)
+    {
+      const Point3f& q = queries[order[i].second];
+      min[0] = std::min(min[0], q.x());
+      min[1] = std::min(min[1], q.y());
+      min[2] = std::min(min[2], q.z());
+      max[0] = std::max(max[0], q.x());
+      max[1] = std::max(max[1], q.y());
+      max[2] = std::max(max[2], q.z());
+    }
+
+    // collect octants, which are either inside the search balls of all queries or leafs overlapping the block.
+    frontier.clear();
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const uint32_t idx = stack[--top];
+      const Octant* octant = &octants_[idx];
+
+      if (skip(octant)) continue;
+
+      if (octant->x + octant->extent + radius < min[0] || octant->x - octant->extent - radius > max[0]) continue;
+      if (octant->y + octant->extent + radius < min[1] || octant->y - octant->extent - radius > max[1]) continue;
+      if (octant->z + octant->extent + radius < min[2] || octant->z - octant->extent - radius > max[2]) continue;
+
+      // farthest corner of the octant in respect to all queries inside the block.
+      float x = std::max(max[0] - octant->x + octant->extent, octant->x + octant->extent - min[0]);
+      float y = std::max(max[1] - octant->y + octant->extent, octant->y + octant->extent - min[1]);
+      float z = std::max(max[2] - octant->z + octant->extent, octant->z + octant->extent - min[2]);
+
+      if (octant->isLeaf || dist.compare(x, y, z) < threshold)
+      {
+        frontier.push_back(idx);
+        continue;
+      }
+
+      for (int32_t c = octant->numChildren - 1; c >= 0; --c)
+        stack[top++] = octant->child + c;
+    }
+
+    // (3) search every query of the block only in the collected octants.
+    for (uint32_t i = blockStart; i < blockEnd; ++i)
+    {
+      const uint32_t q = order[i].second;
+      const Point3f& query = queries[q];
+      begin[q] = results.size();
+
+      for (uint32_t j = 0; j < frontier.size(); ++j)
+      {
+        const Octant* octant = &octants_[frontier[j]];
+        if (contains(query, threshold, octant, dist))
+          addOctant(octant, results);
+        else if (octant->isLeaf && overlaps(query, radius, threshold, octant, dist))
+          scanOctant(octant, query, threshold, results, dist);
+      }
+
+      end[q] = results.size();
+    }
+  }
+
+  // (4) copy the results in the order of the queries.
+  offsets.resize(N + 1);
+  neighbors.resize(results.size());
+  offsets[0] = 0;
+  for (uint32_t q = 0; q < N; ++q)
+  {
+    std::copy(results.begin() + begin[q], results.begin() + end[q], neighbors.begin() + offsets[q]);
+    offsets[q + 1] = offsets[q] + (end[q] - begin[q]);
+  }
+}
+
+template<typename Distance>
+void Octree::knnNeighbors(const Octant* octant, const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  typedef std::pair<float, uint32_t> Entry;
+  const std::greater<Entry> farther;
+
+  // max-heap of the k closest points found so far, i.e., the current k-th neighbor is at the front.
+  std::vector<Entry> closest;
+  closest.reserve(k);
+  // min-heap of octants ordered by their distance to the query.
+  std::vector<Entry> queue;
+  queue.push_back(Entry(minDistance(query, octant, dist), octant - &octants_[0]));
+
+  while (!queue.empty())
+  {
+    std::pop_heap(queue.begin(), queue.end(), farther);
+    const Entry next = queue.back();
+    queue.pop_back();
+
+    // all remaining octants are farther away than the current k-th neighbor.
+    if (closest.size() == k && next.first > closest.front().first) break;
+
+    const Octant* curOct = &octants_[next.second];
+    if (skip(curOct)) continue;
+
+    if (curOct->isLeaf)
+    {
+      const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && curOct->segment != segment_);
+      for (uint32_t i = curOct->start; i < curOct->end; ++i)
+      {
+        if (restricted && segmentIds_[i] != segment_) continue;
+
+        const Entry candidate(dist.compare(x_[i] - query.x(), y_[i] - query.y(), z_[i] - query.z()), indexes_[i]);
+        if (closest.size() < k)
+        {
+          closest.push_back(candidate);
+          std::push_heap(closest.begin(), closest.end());
+        }
+        else if (candidate < closest.front())
+        {
+          std::pop_heap(closest.begin(), closest.end());
+          closest.back() = candidate;
+          std::push_heap(closest.begin(), closest.end());
+        }
+      }
+      continue;
+    }
+
+    for (uint32_t c = 0; c < curOct->numChildren; ++c)
+    {
+      const float d = minDistance(query, &octants_[curOct->child + c], dist);
+      if (closest.size() == k && d > closest.front().first) continue;
+
+      queue.push_back(Entry(d, curOct->child + c));
+      std::push_heap(queue.begin(), queue.end(), farther);
+    }
+  }
+
+  std::sort_heap(closest.begin(), closest.end());
+  neighbors.resize(closest.size());
+  for (uint32_t i = 0; i < closest.size(); ++i)
+    neighbors[i] = closest[i].second;
 }
 
+template<typename Result>
+struct Octree::RadiusSearch
+{
+    RadiusSearch(const Octree& o, const Point3f& q, float r, Result& res) :
+        octree(o), query(q), radius(r), result(res)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      octree.radiusNeighbors(&octree.octants_[0], query, radius, result, dist);
+    }
+
+    const Octree& octree;
+    const Point3f& query;
+    float radius;
+    Result& result;
+};
+
+struct Octree::BatchSearch
+{
+    BatchSearch(const Octree& o, const std::vector<Point3f>& q, float r, std::vector<uint32_t>& off,
+        std::vector<uint32_t>& n) :
+        octree(o), queries(q), radius(r), offsets(off), neighbors(n)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      octree.radiusNeighbors(queries, radius, offsets, neighbors, dist);
+    }
+
+    const Octree& octree;
+    const std::vector<Point3f>& queries;
+    float radius;
+    std::vector<uint32_t>& offsets;
+    std::vector<uint32_t>& neighbors;
+};
+
+struct Octree::KnnSearch
+{
+    KnnSearch(const Octree& o, const Point3f& q, uint32_t num, std::vector<uint32_t>& n) :
+        octree(o), query(q), k(num), neighbors(n)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      octree.knnNeighbors(&octree.octants_[0], query, k, neighbors, dist);
+    }
+
+    const Octree& octree;
+    const Point3f& query;
+    uint32_t k;
+    std::vector<uint32_t>& neighbors;
+};
+
 void Octree::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
     const Norm& norm) const
 {
   neighbors.clear();
-  if (root_ == 0) return;
+  if (octants_.empty()) return;
+
+  // dispatch once to the search specialized for the norm.
+  RadiusSearch<std::vector<uint32_t> > search(*this, query, radius, neighbors);
+  dispatchNorm(norm, search);
+}
+
+void Octree::radiusNeighbors(const std::vector<Point3f>& queries, float radius, std::vector<uint32_t>& offsets,
+    std::vector<uint32_t>& neighbors, const Norm& norm) const
+{
+  if (octants_.empty() || queries.empty())
+  {
+    offsets.assign(queries.size() + 1, 0);
+    neighbors.clear();
+    return;
+  }
+
+  // the shared traversal is exact, thus an approximate search answers every query separately.
+  if (epsilon_ > 0.0f)
+  {
+    NearestNeighborImpl::radiusNeighbors(queries, radius, offsets, neighbors, norm);
+    return;
+  }
+
+  BatchSearch search(*this, queries, radius, offsets, neighbors);
+  dispatchNorm(norm, search);
+}
+
+void Octree::knnNeighbors(const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors, const Norm& norm) const
+{
+  neighbors.clear();
+  if (octants_.empty() || k == 0) return;
+
+  KnnSearch search(*this, query, k, neighbors);
+  dispatchNorm(norm, search);
+}
+
+void Octree::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>& offsets, const Norm& norm) const
+{
+  neighbors.clear();
+  offsets.clear();
+  if (octants_.empty()) return;
 
-  radiusNeighbors(root_, query, radius, neighbors, norm);
+  OffsetResult result(query, neighbors, offsets);
+  RadiusSearch<OffsetResult> search(*this, query, radius, result);
+  dispatchNorm(norm, search);
 }
-bool Octree::PointInSphere(const Point3f& p, float radius, const Point3f& center,const Norm& norm) const
+
+uint32_t Octree::countNeighbors(const Point3f& query, float radius, const Norm& norm) const
 {
-	float dist = norm.compute(p,center);
-	return dist <= radius;
+  uint32_t count = 0;
+  if (octants_.empty()) return count;
+
+  RadiusSearch<uint32_t> search(*this, query, radius, count);
+  dispatchNorm(norm, search);
+
+  return count;
 }
-void Octree::radiusNeighbors(const Octant* octant, const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
-    const Norm& norm) const
+
+template<typename Distance>
+bool Octree::overlaps(const Point3f& query, float radius, float threshold, const Octant* o, const Distance& dist)
 {
-	queue<Octant*> Q;
-	Q.push((Octant*)octant);
-	while(!Q.empty())
-	{
-		Octant* curOct = Q.front();
-		Q.pop();
-
-		if(contains(query,radius,curOct,norm))
-		{
-			int p=curOct->start;
-			while(p!=curOct->end)
-			{
-				neighbors.push_back(p);
-				p = successors_[p];
-			}
-			neighbors.push_back(p);
-			continue;
-		}
-		if(curOct->isLeaf)
-		{
-			int p=curOct->start;
-			while(p!=curOct->end)
-			{
-				if (PointInSphere((*data_)[p], radius, query,norm))
-					neighbors.push_back(p);
-				p = successors_[p];
-			}
-			if (PointInSphere((*data_)[p], radius, query,norm) )
-			neighbors.push_back(p);
-		}
-		for(int i=0;i<8;++i)
-		{
-			if(curOct->child[i] == NULL)
-				continue;
-
-			if(overlaps(query,radius,curOct->child[i],norm))
-				Q.push(curOct->child[i]);
-		}
-	}
-}
-
-bool Octree::overlaps(const Point3f& query, float radius, const Octant* o, const Norm& dist)
-{
-// we exploit the symmetry to reduce the test to testing if its inside the Minkowski sum around the positive quadrant.
+  // we exploit the symmetry to reduce the test to testing if its inside the Minkowski sum around the positive quadrant.
   float x = query.x() - o->x;
   float y = query.y() - o->y;
   float z = query.z() - o->z;
@@ -242,27 +966,28 @@ bool Octree::overlaps(const Point3f& query, float radius, const Octant* o, const
   y = std::abs(y);
   z = std::abs(z);
 
-// (1) checking the line region.
+  // (1) checking the line region.
   float maxdist = radius + o->extent;
 
-// a. completely outside, since q' is outside the relevant area.
+  // a. completely outside, since q' is outside the relevant area.
   if (x > maxdist || y > maxdist || z > maxdist) return false;
 
-// b. inside the line region, one of the coordinates is inside the square.
+  // b. inside the line region, one of the coordinates is inside the square.
   if (x < o->extent || y < o->extent || z < o->extent) return true;
 
-// (2) checking the corner region...
+  // (2) checking the corner region...
   x -= o->extent;
   y -= o->extent;
   z -= o->extent;
 
-  return (dist.compute(x, y, z) < radius);
+  return (dist.compare(x, y, z) < threshold);
 }
 
-bool Octree::contains(const Point3f& query, float radius, const Octant* o, const Norm& dist)
+template<typename Distance>
+bool Octree::contains(const Point3f& query, float threshold, const Octant* o, const Distance& dist)
 {
-// we exploit the symmetry to reduce the test to test
-// whether the farthest corner is inside the search ball.
+  // we exploit the symmetry to reduce the test to test
+  // whether the farthest corner is inside the search ball.
   float x = query.x() - o->x;
   float y = query.y() - o->y;
   float z = query.z() - o->z;
@@ -270,10 +995,21 @@ bool Octree::contains(const Point3f& query, float radius, const Octant* o, const
   x = std::abs(x);
   y = std::abs(y);
   z = std::abs(z);
-// reminder: (x, y, z) - (-e, -e, -e) = (x, y, z) + (e, e, e)
+  // reminder: (x, y, z) - (-e, -e, -e) = (x, y, z) + (e, e, e)
   x += o->extent;
   y += o->extent;
   z += o->extent;
 
-  return (dist.compute(x, y, z) < radius);
+  return (dist.compare(x, y, z) < threshold);
+}
+
+template<typename Distance>
+float Octree::minDistance(const Point3f& query, const Octant* o, const Distance& dist)
+{
+  // distance to the closest point of the box along each axis.
+  float x = std::max(0.0f, std::abs(query.x() - o->x) - o->extent);
+  float y = std::max(0.0f, std::abs(query.y() - o->y) - o->extent);
+  float z = std::max(0.0f, std::abs(query.z() - o->z) - o->extent);
+
+  return dist.compare(x, y, z);
 }
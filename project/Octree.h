@@ -2,9 +2,11 @@
 #define OCTREE_H_
 
 #include <vector>
+#include <boost/atomic.hpp>
 #include <rv/geometry.h>
 #include <rv/norms.h>
-#include <rv/NearestNeighborImpl.h>
+#include <rv/IndexedSegment.h>
+#include "SegmentNeighborSearch.h"
 #include<iostream>
 #include <fstream>
 using namespace std;
@@ -14,26 +16,113 @@ namespace
 class OctreeTest;
 }
 
+namespace boost
+{
+class mutex;
+}
+
 /** \brief Octree for searching radius neighbors
+ *
+ *  All octants are stored in a single flat array, where the children of an octant are stored
+ *  adjacent to each other and are addressed by the index of the first child. The array is reused
+ *  by subsequent calls of initialize, such that rebuilding the octree does not allocate memory
+ *  once the capacity is large enough.
+ *
+ *  The indexed points are sorted by their Morton code, i.e., the point indexes are reordered such
+ *  that every octant corresponds to a range [start, end) of the permutation. The coordinates are
+ *  copied in the same order as separate x, y, and z arrays, therefore leaf octants are tested with SIMD
+ *  instructions (see RadiusScan.h) and the points of an octant completely inside the search ball are
+ *  appended as a whole range.
+ *
+ *  An octree can be also initialized with all segments of a scan. The radius neighbors search can then be
+ *  restricted to a single segment, which gives the same result as an octree initialized only with the
+ *  points of this segment. Thus, the octree has to be built only once per scan and not for every segment.
  *
  *  \author you
  */
-class Octree: public rv::NearestNeighborImpl
+class Octree: public SegmentNeighborSearch
 {
     friend class ::OctreeTest;
   public:
     Octree(uint32_t bucketSize = 32);
     ~Octree();
 
+    /** \brief remove all points, where the octants and buffers keep their capacity for the next initialization. **/
     void clear();
 
-
     void initialize(const std::vector<rv::Point3f>& points, const std::vector<uint32_t>& indexes);
 
+    void initialize(const std::vector<rv::Point3f>& points, const std::vector<rv::IndexedSegment>& segments);
+
+    void setSegment(uint32_t segment);
+
+    /** \brief write octants, point permutation, coordinates, and segments to a binary file.
+     *
+     *  The file contains a header followed by the arrays as stored in memory, therefore loading requires
+     *  no parsing at all.
+     */
+    bool save(const std::string& filename) const;
+
+    /** \brief load an octree written by save via memory mapping.
+     *
+     *  The header stores the bucket size and a fingerprint of the indexed points, such that outdated files
+     *  are rejected and the octree must be built again.
+     */
+    bool load(const std::string& filename, const std::vector<rv::Point3f>& points,
+        const std::vector<rv::IndexedSegment>& segments);
+
+    /** \brief number of threads used for building the octree. [default: 1]
+     *
+     *  Subtrees with less than MIN_TASK_SIZE points are always built by a single thread. The resulting
+     *  octree gives exactly the same results as an octree built with a single thread.
+     */
+    void setNumThreads(uint32_t numThreads);
+
+    /** \brief approximate radius search with relative error epsilon. [default: 0, i.e., exact search]
+     *
+     *  Octants inside the search ball with radius (1 + epsilon) * r are added as a whole and octants, which
+     *  do not overlap the search ball with radius (1 - epsilon) * r, are skipped. Thus, only neighbors with
+     *  distance in [(1 - epsilon) * r, (1 + epsilon) * r] might be missing or added in error, but fewer leaf
+     *  points must be tested. With approximation, the batch search answers every query by the single query search.
+     *
+     *  Throws rv::Error if epsilon is not in [0, 1), since the shrunken ball would be empty.
+     */
+    void setApproximation(float epsilon);
+
+    /** \brief number of points added or skipped by the approximation without testing their distance.
+     *
+     *  With a restriction to a segment, only the points of the current segment are counted.
+     *  The counter accumulates over all queries and initializations until it is reset. Every query adds its
+     *  count atomically, thus the counter is also exact if multiple threads search concurrently.
+     */
+    uint64_t approximatedPoints() const;
+    void resetApproximatedPoints();
+
     void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors, const rv::Norm& dist) const;
 
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>& offsets, const rv::Norm& dist) const;
+
+    /** \brief number of radius neighbors, where octants inside the search ball are counted as a whole. **/
+    uint32_t countNeighbors(const rv::Point3f& query, float radius, const rv::Norm& dist) const;
+
+    /** \brief radius neighbors of multiple queries.
+     *
+     *  The queries are processed in blocks of spatially neighboring queries, which share the traversal
+     *  of the upper levels of the octree.
+     */
+    void radiusNeighbors(const std::vector<rv::Point3f>& queries, float radius, std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& neighbors, const rv::Norm& dist) const;
+
+    /** \brief k nearest neighbors sorted by increasing distance.
+     *
+     *  Octants are visited best-first in the order of their distance to the query. Octants, which are farther
+     *  away than the current k-th neighbor, are pruned.
+     */
+    void knnNeighbors(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors, const rv::Norm& dist) const;
+
     // "unhide" the base implementation of initialize.
-    using rv::NearestNeighborImpl::initialize;
+    using SegmentNeighborSearch::initialize;
   protected:
     // Octree can not be copied/assigned.
     Octree(const Octree& other);
@@ -43,68 +132,192 @@ class Octree: public rv::NearestNeighborImpl
     {
       public:
         Octant();
-        ~Octant();
 
         bool isLeaf;
+        // number of non-empty children stored consecutively starting at child.
+        uint8_t numChildren;
+        // explicit padding, which is zeroed such that save writes no uninitialized bytes.
+        uint16_t reserved;
 
         // bounding box of the octant needed for overlap and contains tests...
         float x, y, z;
         float extent;
 
-        // start and end in successors_
+        // range [start, end) in indexes_ and the coordinates x_, y_, z_
         uint32_t start, end;
         // number of points
         uint32_t size;
 
-        Octant* child[8];
+        // index of first child in octants_.
+        uint32_t child;
+
+        // segment of all points inside the octant, or ALL_SEGMENTS if the points belong to different segments.
+        uint32_t segment;
+    };
+
+    /** \brief subtree, which is built separately by one of the threads. **/
+    struct BuildTask
+    {
+        // placeholder of the subtree's root in octants_.
+        uint32_t octant;
+        float x, y, z, extent;
+        uint32_t start, end, depth;
+        // octants of the subtree with the root at index 0.
+        std::vector<Octant> octants;
     };
 
-    /** \brief get Morton code of p in respect to x, y, z **/
-    uint32_t mortonCode(const rv::Point3f& p, float x, float y, float z) const;
+    /** \brief build octree from the coordinates and segment ids already copied to x_, y_, z_ and segmentIds_. **/
+    void build();
+
+    /** \brief build subtrees of tasks until all tasks are taken by threads. **/
+    void buildTasks(std::vector<BuildTask>* tasks, uint32_t* next, boost::mutex* mutex);
+
+    /** \brief determine the segment of the octant from the segments of its children. **/
+    void updateSegment(std::vector<Octant>& octants, uint32_t octant);
+
+    /** \brief get Morton code of (px, py, pz) in respect to x, y, z **/
+    uint32_t mortonCode(float px, float py, float pz, float x, float y, float z) const;
 
     /**
-     * \brief creation of an octant using the elements starting at startIdx.
+     * \brief creation of an octant using the elements in the range [start, end).
      *
-     * The method reorders the index such that all points are correctly linked to successors belonging
-     * to the same octant.
+     * The method reorders indexes_, the coordinates, and segmentIds_ such that the points of each child octant are
+     * stored consecutively in the order of the children's Morton codes.
      *
+     * \param octants         octants of the (sub)tree
+     * \param octant          index of octant in octants, which gets initialized.
      * \param x,y,z           center coordinates of octant
      * \param extent          extent of octant ( half of side length)
-     * \param startIdx        first index of points inside octant
-     * \param endIdx          last index of points inside octant
-     * \param size            number of points in octant
+     * \param start           first index of points inside octant
+     * \param end             index after the last point inside octant
+     * \param depth           depth of the octant, where octants at MAX_DEPTH are not subdivided.
+     * \param tasks           if given, subtrees with at most taskSize_ points are not built, but added as tasks.
+     */
+    void createOctant(std::vector<Octant>& octants, uint32_t octant, float x, float y, float z, float extent,
+        uint32_t start, uint32_t end, uint32_t depth, std::vector<BuildTask>* tasks);
+
+    /** \brief neighbors and their offsets to the query. **/
+    struct OffsetResult
+    {
+        OffsetResult(const rv::Point3f& q, std::vector<uint32_t>& n, std::vector<rv::Vector3f>& o) :
+            query(q), neighbors(n), offsets(o)
+        {
+        }
+
+        const rv::Point3f& query;
+        std::vector<uint32_t>& neighbors;
+        std::vector<rv::Vector3f>& offsets;
+    };
+
+    /** \brief depth-first radius neighbors search specialized for the distance of a norm.
+     *
+     *  The Distance is a norm policy of rv/norms.h, such that a point p is a neighbor if
+     *  compare(p - q) <= threshold(radius), e.g., squared distances for the Euclidean norm.
      *
-     * \return  octant with children nodes.
+     *  The Result is either the neighbors (std::vector<uint32_t>), the neighbors with offsets (OffsetResult),
+     *  or the number of neighbors (uint32_t), which are collected by the corresponding addOctant and scanOctant.
      */
-    Octant* createOctant(float x, float y, float z, float extent, uint32_t startIdx, uint32_t endIdx, uint32_t size);
+    template<typename Distance, typename Result>
+    void radiusNeighbors(const Octant* octant, const rv::Point3f& query, float radius, Result& result,
+        const Distance& dist) const;
+
+    template<typename Distance>
+    void radiusNeighbors(const std::vector<rv::Point3f>& queries, float radius, std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& neighbors, const Distance& dist) const;
+
+    /** \brief best-first k nearest neighbors search specialized for the distance of a norm. **/
+    template<typename Distance>
+    void knnNeighbors(const Octant* octant, const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+
+    /** \brief functors calling the specialized searches with the policy given by rv::dispatchNorm. **/
+    template<typename Result>
+    struct RadiusSearch;
+    struct BatchSearch;
+    struct KnnSearch;
 
-    void radiusNeighbors(const Octant* octant, const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
-        const rv::Norm& dist) const;
+    /** \brief number of neighbors found so far. **/
+    static uint32_t resultSize(const std::vector<uint32_t>& neighbors);
+    static uint32_t resultSize(const OffsetResult& result);
+    static uint32_t resultSize(const uint32_t& count);
+
+    /** \brief add all points of the octant, which belong to the current segment. **/
+    void addOctant(const Octant* octant, std::vector<uint32_t>& neighbors) const;
+    void addOctant(const Octant* octant, OffsetResult& result) const;
+    void addOctant(const Octant* octant, uint32_t& count) const;
+
+    /** \brief add points of the octant inside the search ball, which belong to the current segment. **/
+    template<typename Distance>
+    void scanOctant(const Octant* octant, const rv::Point3f& query, float threshold, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+    template<typename Distance>
+    void scanOctant(const Octant* octant, const rv::Point3f& query, float threshold, OffsetResult& result,
+        const Distance& dist) const;
+    template<typename Distance>
+    void scanOctant(const Octant* octant, const rv::Point3f& query, float threshold, uint32_t& count,
+        const Distance& dist) const;
+
+    /** \brief octant contains only points of segments other than the current segment? **/
+    bool skip(const Octant* octant) const;
+
+    /** \brief number of points of the octant, which belong to the current segment. **/
+    uint32_t segmentSize(const Octant* octant) const;
 
     /** \brief test if search ball S(q,r) overlaps with octant
      *
-     * @param query   query point
-     * @param radius  "squared" radius
-     * @param o       pointer to octant
+     * @param query     query point
+     * @param radius    radius r
+     * @param threshold threshold of the distance corresponding to the radius
+     * @param o         pointer to octant
      *
      * @return true, if search ball overlaps with octant, false otherwise.
      */
-    static bool overlaps(const rv::Point3f& query, float radius, const Octant* o, const rv::Norm& dist);
+    template<typename Distance>
+    static bool overlaps(const rv::Point3f& query, float radius, float threshold, const Octant* o, const Distance& dist);
+
+    /** \brief distance of the query to the closest point of the octant, which is zero for queries inside. **/
+    template<typename Distance>
+    static float minDistance(const rv::Point3f& query, const Octant* o, const Distance& dist);
 
     /** \brief test if search ball S(q,r) contains octant
      *
-     * @param query    query point
-     * @param sqRadius "squared" radius
-     * @param octant   pointer to octant
+     * @param query     query point
+     * @param threshold threshold of the distance corresponding to the radius
+     * @param octant    pointer to octant
      *
      * @return true, if search ball overlaps with octant, false otherwise.
      */
-    static bool contains(const rv::Point3f& query, float radius, const Octant* octant, const rv::Norm& dist);
-    bool PointInSphere(const rv::Point3f&, float, const rv::Point3f&,const rv::Norm&) const;
-    const std::vector<rv::Point3f>* data_;
-    Octant* root_;
+    template<typename Distance>
+    static bool contains(const rv::Point3f& query, float threshold, const Octant* octant, const Distance& dist);
+
+    // maximal depth of the octree, which bounds the stack of the search.
+    static const uint32_t MAX_DEPTH = 32;
+    // number of queries sharing the traversal of the upper levels in the batch search.
+    static const uint32_t QUERY_BLOCK_SIZE = 32;
+    // minimal number of points of a subtree built in parallel.
+    static const uint32_t MIN_TASK_SIZE = 4096;
+
+    // all octants with root at index 0 (if not empty).
+    std::vector<Octant> octants_;
     uint32_t bucketSize_;
-    std::vector<uint32_t> successors_;
+    // point indexes in Morton order and the corresponding coordinates stored as structure of arrays.
+    std::vector<uint32_t> indexes_;
+    std::vector<float> x_, y_, z_;
+    // segment of each point (empty, if initialized without segments) and the current restriction.
+    std::vector<uint32_t> segmentIds_;
+    uint32_t segment_;
+    // buffers for partitioning the points into child octants.
+    std::vector<uint32_t> tmpIndexes_;
+    std::vector<float> tmpX_, tmpY_, tmpZ_;
+    std::vector<uint32_t> tmpSegmentIds_;
+    std::vector<uint8_t> codes_;
+    uint32_t numThreads_;
+    uint32_t taskSize_;
+    // fingerprint of the points and segments used for initialization, which is stored by save.
+    uint64_t fingerprint_;
+    // relative error of the approximate radius search and number of approximately classified points.
+    float epsilon_;
+    mutable boost::atomic<uint64_t> numApproximated_;
     fstream logger;
 };
 
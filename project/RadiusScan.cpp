@@ -0,0 +1,233 @@
+#include "RadiusScan.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+template<ScanDistance type>
+inline float distance(float x, float y, float z)
+{
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return x * x + y * y + z * z;
+    case SCAN_MAXIMUM:
+      return std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+    case SCAN_MANHATTEN:
+      return std::abs(x) + std::abs(y) + std::abs(z);
+  }
+
+  return 0.0f;
+}
+
+template<ScanDistance type>
+uint32_t scanScalar(const float* x, const float* y, const float* z, const uint32_t* indexes, uint32_t n, float qx,
+    float qy, float qz, float threshold, uint32_t* out)
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    if (distance<type>(x[i] - qx, y[i] - qy, z[i] - qz) <= threshold) out[count++] = indexes[i];
+  }
+
+  return count;
+}
+
+#if defined(__AVX512F__)
+
+template<ScanDistance type>
+inline __m512 distance(__m512 x, __m512 y, __m512 z)
+{
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y)), _mm512_mul_ps(z, z));
+    case SCAN_MAXIMUM:
+      return _mm512_max_ps(_mm512_max_ps(_mm512_abs_ps(x), _mm512_abs_ps(y)), _mm512_abs_ps(z));
+    case SCAN_MANHATTEN:
+      return _mm512_add_ps(_mm512_add_ps(_mm512_abs_ps(x), _mm512_abs_ps(y)), _mm512_abs_ps(z));
+  }
+
+  return _mm512_setzero_ps();
+}
+
+template<ScanDistance type>
+uint32_t scan(const float* x, const float* y, const float* z, const uint32_t* indexes, uint32_t n, float qx,
+    float qy, float qz, float threshold, uint32_t* out)
+{
+  const __m512 vqx = _mm512_set1_ps(qx), vqy = _mm512_set1_ps(qy), vqz = _mm512_set1_ps(qz);
+  const __m512 vthreshold = _mm512_set1_ps(threshold);
+
+  uint32_t count = 0;
+  uint32_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + i), vqx);
+    __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + i), vqy);
+    __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(z + i), vqz);
+
+    __mmask16 mask = _mm512_cmp_ps_mask(distance<type>(dx, dy, dz), vthreshold, _CMP_LE_OQ);
+    _mm512_mask_compressstoreu_epi32(out + count, mask, _mm512_loadu_si512(indexes + i));
+    count += __builtin_popcount(mask);
+  }
+
+  return count + scanScalar<type>(x + i, y + i, z + i, indexes + i, n - i, qx, qy, qz, threshold, out + count);
+}
+
+const char* instructionSet = "AVX-512";
+
+#elif defined(__AVX2__)
+
+template<ScanDistance type>
+inline __m256 distance(__m256 x, __m256 y, __m256 z)
+{
+  const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+    case SCAN_MAXIMUM:
+      return _mm256_max_ps(_mm256_max_ps(_mm256_and_ps(x, absmask), _mm256_and_ps(y, absmask)),
+          _mm256_and_ps(z, absmask));
+    case SCAN_MANHATTEN:
+      return _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, absmask), _mm256_and_ps(y, absmask)),
+          _mm256_and_ps(z, absmask));
+  }
+
+  return _mm256_setzero_ps();
+}
+
+template<ScanDistance type>
+uint32_t scan(const float* x, const float* y, const float* z, const uint32_t* indexes, uint32_t n, float qx,
+    float qy, float qz, float threshold, uint32_t* out)
+{
+  const __m256 vqx = _mm256_set1_ps(qx), vqy = _mm256_set1_ps(qy), vqz = _mm256_set1_ps(qz);
+  const __m256 vthreshold = _mm256_set1_ps(threshold);
+
+  uint32_t count = 0;
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), vqx);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), vqy);
+    __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), vqz);
+
+    uint32_t mask = _mm256_movemask_ps(_mm256_cmp_ps(distance<type>(dx, dy, dz), vthreshold, _CMP_LE_OQ));
+    // emit the index of every set bit.
+    while (mask != 0)
+    {
+      out[count++] = indexes[i + __builtin_ctz(mask)];
+      mask &= mask - 1;
+    }
+  }
+
+  return count + scanScalar<type>(x + i, y + i, z + i, indexes + i, n - i, qx, qy, qz, threshold, out + count);
+}
+
+const char* instructionSet = "AVX2";
+
+#elif defined(__SSE2__)
+
+template<ScanDistance type>
+inline __m128 distance(__m128 x, __m128 y, __m128 z)
+{
+  const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    case SCAN_MAXIMUM:
+      return _mm_max_ps(_mm_max_ps(_mm_and_ps(x, absmask), _mm_and_ps(y, absmask)), _mm_and_ps(z, absmask));
+    case SCAN_MANHATTEN:
+      return _mm_add_ps(_mm_add_ps(_mm_and_ps(x, absmask), _mm_and_ps(y, absmask)), _mm_and_ps(z, absmask));
+  }
+
+  return _mm_setzero_ps();
+}
+
+template<ScanDistance type>
+uint32_t scan(const float* x, const float* y, const float* z, const uint32_t* indexes, uint32_t n, float qx,
+    float qy, float qz, float threshold, uint32_t* out)
+{
+  const __m128 vqx = _mm_set1_ps(qx), vqy = _mm_set1_ps(qy), vqz = _mm_set1_ps(qz);
+  const __m128 vthreshold = _mm_set1_ps(threshold);
+
+  uint32_t count = 0;
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), vqx);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), vqy);
+    __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), vqz);
+
+    uint32_t mask = _mm_movemask_ps(_mm_cmple_ps(distance<type>(dx, dy, dz), vthreshold));
+    // emit the index of every set bit.
+    while (mask != 0)
+    {
+      out[count++] = indexes[i + __builtin_ctz(mask)];
+      mask &= mask - 1;
+    }
+  }
+
+  return count + scanScalar<type>(x + i, y + i, z + i, indexes + i, n - i, qx, qy, qz, threshold, out + count);
+}
+
+const char* instructionSet = "SSE2";
+
+#else
+
+template<ScanDistance type>
+uint32_t scan(const float* x, const float* y, const float* z, const uint32_t* indexes, uint32_t n, float qx,
+    float qy, float qz, float threshold, uint32_t* out)
+{
+  return scanScalar<type>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+}
+
+const char* instructionSet = "scalar";
+
+#endif
+
+}
+
+uint32_t radiusScan(ScanDistance type, const float* x, const float* y, const float* z, const uint32_t* indexes,
+    uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return scan<SCAN_EUCLIDEAN_SQR>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+    case SCAN_MAXIMUM:
+      return scan<SCAN_MAXIMUM>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+    case SCAN_MANHATTEN:
+      return scan<SCAN_MANHATTEN>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+  }
+
+  return 0;
+}
+
+uint32_t radiusScanScalar(ScanDistance type, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  switch (type)
+  {
+    case SCAN_EUCLIDEAN_SQR:
+      return scanScalar<SCAN_EUCLIDEAN_SQR>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+    case SCAN_MAXIMUM:
+      return scanScalar<SCAN_MAXIMUM>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+    case SCAN_MANHATTEN:
+      return scanScalar<SCAN_MANHATTEN>(x, y, z, indexes, n, qx, qy, qz, threshold, out);
+  }
+
+  return 0;
+}
+
+const char* radiusScanInstructionSet()
+{
+  return instructionSet;
+}
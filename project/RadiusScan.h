@@ -0,0 +1,83 @@
+#ifndef RADIUSSCAN_H_
+#define RADIUSSCAN_H_
+
+#include <stdint.h>
+
+/**
+ * Kernels for testing a contiguous block of points against a search ball.
+ *
+ * The points are given as structure of arrays (x[], y[], z[]) and the indexes of all points p with
+ * dist(p - q) <= threshold are written consecutively to the output. Depending on the instruction set
+ * the code is compiled for, 16 (AVX-512), 8 (AVX2), or 4 (SSE2) points are tested at once. The
+ * output must provide space for n indexes, since vector stores may write up to n elements.
+ */
+
+/** \brief distances supported by the kernels; the Euclidean distance is compared squared. **/
+enum ScanDistance
+{
+  SCAN_EUCLIDEAN_SQR, SCAN_MAXIMUM, SCAN_MANHATTEN
+};
+
+/** \brief vectorized radius test of n points.
+ *
+ *  \param type       distance used for comparison with the threshold
+ *  \param x,y,z      coordinates of the points
+ *  \param indexes    index of each point, which is written to out if the point is inside the ball.
+ *  \param n          number of points
+ *  \param qx,qy,qz   query point
+ *  \param threshold  radius, or squared radius for SCAN_EUCLIDEAN_SQR
+ *  \param out        output for the indexes of points inside the ball.
+ *
+ *  \return number of indexes written to out.
+ */
+uint32_t radiusScan(ScanDistance type, const float* x, const float* y, const float* z, const uint32_t* indexes,
+    uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out);
+
+/** \brief scalar reference implementation of radiusScan. **/
+uint32_t radiusScanScalar(ScanDistance type, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out);
+
+/** \brief name of the instruction set used by radiusScan. **/
+const char* radiusScanInstructionSet();
+
+namespace rv
+{
+struct EuclideanDistance;
+struct MaximumDistance;
+struct ManhattenDistance;
+}
+
+/** \brief radius test with a norm policy of rv/norms.h, where the threshold is dist.threshold(radius).
+ *
+ *  The standard policies use the vectorized kernels, any other policy is tested point by point.
+ */
+template<typename Distance>
+inline uint32_t radiusScan(const Distance& dist, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    if (dist.compare(x[i] - qx, y[i] - qy, z[i] - qz) <= threshold) out[count++] = indexes[i];
+
+  return count;
+}
+
+inline uint32_t radiusScan(const rv::EuclideanDistance&, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  return radiusScan(SCAN_EUCLIDEAN_SQR, x, y, z, indexes, n, qx, qy, qz, threshold, out);
+}
+
+inline uint32_t radiusScan(const rv::MaximumDistance&, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  return radiusScan(SCAN_MAXIMUM, x, y, z, indexes, n, qx, qy, qz, threshold, out);
+}
+
+inline uint32_t radiusScan(const rv::ManhattenDistance&, const float* x, const float* y, const float* z,
+    const uint32_t* indexes, uint32_t n, float qx, float qy, float qz, float threshold, uint32_t* out)
+{
+  return radiusScan(SCAN_MANHATTEN, x, y, z, indexes, n, qx, qy, qz, threshold, out);
+}
+
+#endif /* RADIUSSCAN_H_ */
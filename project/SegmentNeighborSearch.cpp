@@ -0,0 +1,53 @@
+#include "SegmentNeighborSearch.h"
+#include "Octree.h"
+#include "VoxelHashGrid.h"
+
+#include <rv/Error.h>
+
+using namespace rv;
+
+const uint32_t SegmentNeighborSearch::ALL_SEGMENTS;
+
+bool SegmentNeighborSearch::save(const std::string&) const
+{
+  return false;
+}
+
+bool SegmentNeighborSearch::load(const std::string&, const std::vector<Point3f>&,
+    const std::vector<IndexedSegment>&)
+{
+  return false;
+}
+
+SegmentNeighborSearch* createNeighborSearch(const ParameterList& params)
+{
+  std::string name = "octree";
+  if (params.hasParam("neighbor-search")) name = (std::string) params["neighbor-search"];
+
+  if (name == "octree")
+  {
+    uint32_t bucketSize = 32;
+    if (params.hasParam("bucket-size")) bucketSize = params["bucket-size"];
+
+    Octree* octree = new Octree(bucketSize);
+    if (params.hasParam("num-threads")) octree->setNumThreads(params["num-threads"]);
+    if (params.hasParam("approximation"))
+    {
+      const float epsilon = params["approximation"];
+      if (!(epsilon >= 0.0f && epsilon < 1.0f))
+      {
+        delete octree;
+        throw Error("Parameter 'approximation' must be in [0, 1).");
+      }
+      octree->setApproximation(epsilon);
+    }
+
+    return octree;
+  }
+  else if (name == "voxel-grid")
+  {
+    return new VoxelHashGrid(params["cell-size"]);
+  }
+
+  throw Error("Unknown neighbor search '" + name + "'.");
+}
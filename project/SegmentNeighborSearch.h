@@ -0,0 +1,64 @@
+#ifndef SEGMENTNEIGHBORSEARCH_H_
+#define SEGMENTNEIGHBORSEARCH_H_
+
+#include <vector>
+#include <string>
+#include <rv/NearestNeighborImpl.h>
+#include <rv/IndexedSegment.h>
+#include <rv/ParameterList.h>
+
+/** \brief neighbor search, which is initialized with all segments of a scan.
+ *
+ *  The search can be restricted to a single segment, which gives the same result as a search initialized
+ *  only with the points of this segment. Thus, the data structure has to be built only once per scan and
+ *  not for every segment.
+ *
+ *  \author you
+ */
+class SegmentNeighborSearch: public rv::NearestNeighborImpl
+{
+  public:
+    /** \brief initialize with the points of all given segments.
+     *
+     *  Every point is tagged with the index of its segment. If a point is part of multiple segments,
+     *  it is inserted for each of these segments.
+     */
+    virtual void initialize(const std::vector<rv::Point3f>& points, const std::vector<rv::IndexedSegment>& segments) = 0;
+
+    /** \brief restrict the neighbors to points of the given segment.
+     *
+     *  Only applicable if initialized with segments. The restriction is reset by every initialization or
+     *  by passing ALL_SEGMENTS.
+     */
+    virtual void setSegment(uint32_t segment) = 0;
+
+    /** \brief write the data structure to a binary file, which can be loaded by load. [default: not supported]
+     *
+     *  \return true, if the file was written, false otherwise.
+     */
+    virtual bool save(const std::string& filename) const;
+
+    /** \brief load the data structure from a file written by save. [default: not supported]
+     *
+     *  The file must have been written for the same points and segments, and the same parameters.
+     *
+     *  \return true, if the file was loaded; false, if it does not exist or does not match.
+     */
+    virtual bool load(const std::string& filename, const std::vector<rv::Point3f>& points,
+        const std::vector<rv::IndexedSegment>& segments);
+
+    static const uint32_t ALL_SEGMENTS = 0xFFFFFFFF;
+
+    // "unhide" the base implementation of initialize.
+    using rv::NearestNeighborImpl::initialize;
+};
+
+/** \brief create the neighbor search specified by the parameter "neighbor-search".
+ *
+ *  Either "octree" (default) with the optional parameters "bucket-size", "num-threads", and "approximation",
+ *  or "voxel-grid" with the parameter "cell-size". The caller is responsible for deleting the returned object.
+ *  Throws rv::Error for an unknown search or an approximation outside of [0, 1).
+ */
+SegmentNeighborSearch* createNeighborSearch(const rv::ParameterList& params);
+
+#endif /* SEGMENTNEIGHBORSEARCH_H_ */
@@ -1,10 +1,18 @@
 #include "SpinImage.h"
+#include "SpinImageKernel.h"
+#include "utils.h"
 #include <rv/Math.h>
+#include <cmath>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 using namespace rv;
 
+const uint32_t SpinImage::BLOCK_SIZE;
+
 SpinImage::SpinImage(const ParameterList& params) :
-    PointDescriptor(params), normalizer_(0)
+    PointDescriptor(params), numThreads_(1), voxelSize_(0.0f), useNormals_(false), format_(FORMAT_FLOAT32), normalizer_(0)
 {
   num_bins_ = params["num-bins"];
   radius_ = params["radius"];
@@ -12,6 +20,10 @@ SpinImage::SpinImage(const ParameterList& params) :
   normalizer_ = new MaxNormalizer();
 
   if (params.hasParam("bilinear")) bilinear_interp_ = params["bilinear"];
+  if (params.hasParam("num-threads")) numThreads_ = params["num-threads"];
+  if (params.hasParam("normals")) useNormals_ = params["normals"];
+  if (params.hasParam("shared-neighborhoods")) voxelSize_ = params["shared-neighborhoods"];
+  if (params.hasParam("format")) format_ = parseDescriptorFormat((std::string) params["format"]);
   if (params.hasParam("normalizer"))
   {
     delete normalizer_;
@@ -21,7 +33,8 @@ SpinImage::SpinImage(const ParameterList& params) :
 
 SpinImage::SpinImage(const SpinImage& other) :
     PointDescriptor(other), num_bins_(other.num_bins_), radius_(other.radius_), bilinear_interp_(
-        other.bilinear_interp_), normalizer_(other.normalizer_->clone())
+        other.bilinear_interp_), numThreads_(other.numThreads_), voxelSize_(other.voxelSize_), useNormals_(
+        other.useNormals_), format_(other.format_), normalizer_(other.normalizer_->clone())
 {
 
 }
@@ -32,6 +45,10 @@ SpinImage& SpinImage::operator=(const SpinImage& other)
   num_bins_ = other.num_bins_;
   radius_ = other.radius_;
   bilinear_interp_ = other.bilinear_interp_;
+  numThreads_ = other.numThreads_;
+  voxelSize_ = other.voxelSize_;
+  useNormals_ = other.useNormals_;
+  format_ = other.format_;
 
   delete normalizer_;
   normalizer_ = other.normalizer_->clone();
@@ -49,43 +66,276 @@ SpinImage* SpinImage::clone() const
   return new SpinImage(*this);
 }
 
-void SpinImage::evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan& scan,
+void SpinImage::evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan&,
     const NearestNeighborImpl& nn) const
 {
-  /** initialize values with zeros **/
-  memset(values, 0, dim() * sizeof(float));
-  std::vector<uint32_t> neighbors;
-  // TODO: Implement computation of spin images and optionally bi-linear interpolation.
+  Buffers buffers;
+  compute(values, p, ref, nn, buffers);
+}
+
+void SpinImage::evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan&,
+    const NearestNeighborImpl& nn, Buffers& buffers) const
+{
+  compute(values, p, ref, nn, buffers);
+}
+
+void SpinImage::evaluate(float* values, uint32_t index, const Normal3f& ref, const Laserscan& scan,
+    const NearestNeighborImpl& nn) const
+{
+  Buffers buffers;
+  compute(values, scan.point(index), axis(scan, index, ref), nn, buffers);
+}
+
+void SpinImage::evaluate(float* values, uint32_t index, const Normal3f& ref, const Laserscan& scan,
+    const NearestNeighborImpl& nn, Buffers& buffers) const
+{
+  compute(values, scan.point(index), axis(scan, index, ref), nn, buffers);
+}
+
+void SpinImage::evaluate(float* values, const std::vector<uint32_t>& indexes, const Normal3f& ref,
+    const Laserscan& scan, const NearestNeighborImpl& nn) const
+{
+  const uint32_t D = dim();
+  if (voxelSize_ > 0.0f)
+  {
+    Voxels voxels;
+    groupByVoxels(indexes, scan, voxelSize_, voxels.order, voxels.groups);
+    const std::vector<uint32_t>& groups = voxels.groups;
+    const uint32_t numVoxels = groups.size() - 1;
+
+    if (numThreads_ < 2 || numVoxels < 2)
+    {
+      Buffers buffers;
+      for (uint32_t v = 0; v < numVoxels; ++v)
+        evaluateVoxel(values, indexes, &voxels.order[groups[v]], groups[v + 1] - groups[v], ref, scan, nn,
+            buffers);
+      return;
+    }
+
+    uint32_t next = 0;
+    boost::mutex mutex;
+    boost::thread_group threads;
+    for (uint32_t t = 0; t < std::min<uint32_t>(numThreads_, numVoxels); ++t)
+      threads.create_thread(
+          boost::bind(&SpinImage::evaluateVoxels, this, values, &indexes, &voxels, &ref, &scan, &nn, &next, &mutex));
+    threads.join_all();
+    return;
+  }
+
+  if (numThreads_ < 2 || indexes.size() <= BLOCK_SIZE)
+  {
+    Buffers buffers;
+    for (uint32_t start = 0; start < indexes.size(); start += BLOCK_SIZE)
+      evaluateBlock(values + start * D, &indexes[start], std::min<uint32_t>(BLOCK_SIZE, indexes.size() - start), ref,
+          scan, nn, buffers);
+    return;
+  }
+
+  const uint32_t numBlocks = (indexes.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  uint32_t next = 0;
+  boost::mutex mutex;
+  boost::thread_group threads;
+  for (uint32_t t = 0; t < std::min<uint32_t>(numThreads_, numBlocks); ++t)
+    threads.create_thread(
+        boost::bind(&SpinImage::evaluateBlocks, this, values, &indexes, &ref, &scan, &nn, &next, &mutex));
+  threads.join_all();
+}
+
+void SpinImage::setNumThreads(uint32_t numThreads)
+{
+  numThreads_ = numThreads;
+}
+
+void SpinImage::setSharedNeighborhoods(float voxelSize)
+{
+  voxelSize_ = voxelSize;
+}
+
+void SpinImage::setUseNormals(bool useNormals)
+{
+  useNormals_ = useNormals;
+}
+
+bool SpinImage::usesNormals() const
+{
+  return useNormals_;
+}
+
+DescriptorFormat SpinImage::format() const
+{
+  return format_;
+}
+
+void SpinImage::evaluateBlocks(float* values, const std::vector<uint32_t>* indexes, const Normal3f* ref,
+    const Laserscan* scan, const NearestNeighborImpl* nn, uint32_t* next, boost::mutex* mutex) const
+{
+  const uint32_t D = dim();
+  Buffers buffers;
+
+  while (true)
+  {
+    uint32_t start;
+    {
+      boost::mutex::scoped_lock lock(*mutex);
+      if (*next >= indexes->size()) return;
+      start = *next;
+      *next += BLOCK_SIZE;
+    }
+
+    // every point is written to its own row, therefore no further synchronization is needed.
+    const uint32_t n = std::min<uint32_t>(BLOCK_SIZE, indexes->size() - start);
+    evaluateBlock(values + start * D, &(*indexes)[start], n, *ref, *scan, *nn, buffers);
+  }
+}
+
+void SpinImage::evaluateBlock(float* values, const uint32_t* indexes, uint32_t n, const Normal3f& ref,
+    const Laserscan& scan, const NearestNeighborImpl& nn, Buffers& buffers) const
+{
+  const uint32_t D = dim();
+
+  buffers.queries.resize(n);
+  for (uint32_t i = 0; i < n; ++i)
+    buffers.queries[i] = scan.point(indexes[i]);
+
+  MaximumNorm norm;
+  nn.radiusNeighbors(buffers.queries, radius_, buffers.starts, buffers.neighbors, norm);
+
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    const Point3f& p = buffers.queries[i];
+    const uint32_t begin = buffers.starts[i], N = buffers.starts[i + 1] - begin;
+    buffers.x.resize(N);
+    buffers.y.resize(N);
+    buffers.z.resize(N);
+    for (uint32_t j = 0; j < N; ++j)
+    {
+      const Point3f& q = scan.point(buffers.neighbors[begin + j]);
+      buffers.x[j] = q.x() - p.x();
+      buffers.y[j] = q.y() - p.y();
+      buffers.z[j] = q.z() - p.z();
+    }
+
+    histogram(values + i * D, axis(scan, indexes[i], ref), buffers);
+  }
+}
+
+void SpinImage::evaluateVoxel(float* values, const std::vector<uint32_t>& indexes, const uint32_t* order,
+    uint32_t n, const Normal3f& ref, const Laserscan& scan, const NearestNeighborImpl& nn, Buffers& buffers) const
+{
+  const uint32_t D = dim();
+
+  Point3f minimum = scan.point(indexes[order[0]]), maximum = minimum;
+  for (uint32_t k = 1; k < n; ++k)
+  {
+    const Point3f& p = scan.point(indexes[order[k]]);
+    minimum = Point3f(std::min(minimum.x(), p.x()), std::min(minimum.y(), p.y()), std::min(minimum.z(), p.z()));
+    maximum = Point3f(std::max(maximum.x(), p.x()), std::max(maximum.y(), p.y()), std::max(maximum.z(), p.z()));
+  }
+  const Point3f center(0.5f * (minimum.x() + maximum.x()), 0.5f * (minimum.y() + maximum.y()),
+      0.5f * (minimum.z() + maximum.z()));
+  const float extent = 0.5f * std::max(maximum.x() - minimum.x(),
+      std::max(maximum.y() - minimum.y(), maximum.z() - minimum.z()));
+
+  // with an exact search, every neighbor of a point is inside the enlarged radius around the center, where the
+  // radius is slightly increased, such that rounding errors never drop neighbors. An approximate search, e.g., an
+  // octree with approximation, decides differently at the border of the enlarged ball than at the border of the
+  // ball around every point, therefore the spin images might differ from the spin images of single points.
   MaximumNorm norm;
-  nn.radiusNeighbors(p,radius_,neighbors,norm);
-  float cellSize = radius_*1/num_bins_;
-  for(int idx=0;idx<neighbors.size();++idx)
+  nn.radiusNeighbors(center, 1.0001f * (radius_ + extent), buffers.neighbors, norm);
+
+  const uint32_t M = buffers.neighbors.size();
+  buffers.sx.resize(M);
+  buffers.sy.resize(M);
+  buffers.sz.resize(M);
+  for (uint32_t j = 0; j < M; ++j)
+  {
+    const Point3f& q = scan.point(buffers.neighbors[j]);
+    buffers.sx[j] = q.x();
+    buffers.sy[j] = q.y();
+    buffers.sz[j] = q.z();
+  }
+
+  // the neighbors of a point are selected as in the radius search of the octree.
+  MaximumDistance dist;
+  for (uint32_t k = 0; k < n; ++k)
   {
-	  const Point3f& q = scan.point(neighbors[idx]);
-	  Vector3f LinePointDistVect = q-p;
-	  Eigen::Vector3f r,LP_Dist;
-	  LP_Dist << LinePointDistVect.x(),LinePointDistVect.y(),LinePointDistVect.z();
-	  r << ref.x(),ref.y(),ref.z();
-	  Eigen::Vector3f A = r.cross(LP_Dist);
-	  float alpha = A.norm();
-	  float beta = r.transpose()*LP_Dist;
-
-	  int i= (int)floor(alpha/cellSize);
-	  int j = (int)floor((beta + radius_)/(2*cellSize));
-	  if(i >= num_bins_  || j >= num_bins_)
-		  continue;
-	  ++ values[j*num_bins_ + i];
-	  if(bilinear_interp_)
-	   {
-	 	  int a = alpha-i*cellSize;
-	 	  int b = ((beta+radius_)/2)-i*cellSize;
-
-	 	values[j*num_bins_ + i] += (1-a)*(1-b);
-	 	values[j*num_bins_ + i + 1] += a*(1-b);
-	 	values[(j+1)*num_bins_ + i] += (1-a)*b;
-	 	values[(j+1)*num_bins_ + i + 1] += a*b;
-	   }
+    const Point3f& p = scan.point(indexes[order[k]]);
+    buffers.x.clear();
+    buffers.y.clear();
+    buffers.z.clear();
+    for (uint32_t j = 0; j < M; ++j)
+    {
+      const float dx = buffers.sx[j] - p.x(), dy = buffers.sy[j] - p.y(), dz = buffers.sz[j] - p.z();
+      if (dist.compare(dx, dy, dz) > radius_) continue;
+
+      buffers.x.push_back(dx);
+      buffers.y.push_back(dy);
+      buffers.z.push_back(dz);
+    }
+
+    histogram(values + order[k] * D, axis(scan, indexes[order[k]], ref), buffers);
   }
+}
+
+void SpinImage::evaluateVoxels(float* values, const std::vector<uint32_t>* indexes, const Voxels* voxels,
+    const Normal3f* ref, const Laserscan* scan, const NearestNeighborImpl* nn, uint32_t* next,
+    boost::mutex* mutex) const
+{
+  const std::vector<uint32_t>& order = voxels->order;
+  const std::vector<uint32_t>& groups = voxels->groups;
+  Buffers buffers;
+
+  while (true)
+  {
+    uint32_t v;
+    {
+      boost::mutex::scoped_lock lock(*mutex);
+      if (*next + 1 >= groups.size()) return;
+      v = (*next)++;
+    }
+
+    // every point is written to its own row, therefore no further synchronization is needed.
+    evaluateVoxel(values, *indexes, &order[groups[v]], groups[v + 1] - groups[v], *ref, *scan, *nn, buffers);
+  }
+}
+
+void SpinImage::compute(float* values, const Point3f& p, const Normal3f& ref, const NearestNeighborImpl& nn,
+    Buffers& buffers) const
+{
+  MaximumNorm norm;
+  // the search returns the offsets q - p, such that the neighbors must not be looked up again.
+  nn.radiusNeighbors(p, radius_, buffers.neighbors, buffers.offsets, norm);
+
+  const uint32_t N = buffers.offsets.size();
+  buffers.x.resize(N);
+  buffers.y.resize(N);
+  buffers.z.resize(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    buffers.x[i] = buffers.offsets[i].x();
+    buffers.y[i] = buffers.offsets[i].y();
+    buffers.z[i] = buffers.offsets[i].z();
+  }
+
+  histogram(values, ref, buffers);
+}
+
+const Normal3f& SpinImage::axis(const Laserscan& scan, uint32_t index, const Normal3f& ref) const
+{
+  if (useNormals_ && !scan.normals().empty()) return scan.normal(index);
+
+  return ref;
+}
+
+void SpinImage::histogram(float* values, const Normal3f& ref, Buffers& buffers) const
+{
+  /** initialize values with zeros **/
+  memset(values, 0, dim() * sizeof(float));
+
+  const uint32_t N = buffers.x.size();
+  if (N > 0)
+    spinImageBinning(&buffers.x[0], &buffers.y[0], &buffers.z[0], N, ref.x(), ref.y(), ref.z(), radius_, num_bins_,
+        bilinear_interp_, values);
 
   normalizer_->normalize(values, num_bins_ * num_bins_);
 }
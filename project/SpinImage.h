@@ -3,6 +3,14 @@
 
 #include <rv/PointDescriptor.h>
 #include <rv/Normalizer.h>
+#include <vector>
+
+#include "DescriptorFormat.h"
+
+namespace boost
+{
+class mutex;
+}
 
 namespace rv
 {
@@ -16,8 +24,21 @@ namespace rv
  *    radius:float      =  max norm radius of points
  *    bilinear:boolean  =  do bilinear interpolation? [default:true]
  *    normalizer:string =  normalizer to use for spin image computation.
+ *    num-threads:integer = number of threads used for evaluating multiple points. [default: 1]
+ *    format:string     =  storage format of cached or sampled spin images: float32, float16, or uint8. [default: float32]
+ *    shared-neighborhoods:float = edge length of voxels, whose points share a single radius search. [default: 0]
+ *    normals:boolean   =  use the normals of the scan as reference axis of points given by index. [default: false]
  *
- *  By passing an up-vector to the evaluate method, we get an SI in the global reference frame.
+ *  By passing an up-vector to the evaluate method, we get an SI in the global reference frame. If normals are
+ *  used, the evaluation of points given by their index takes the normal of every point from Laserscan::normals(),
+ *  which must be estimated once per scan, e.g., by NormalEstimation.
+ *  The histogram of the neighbors is accumulated by the vectorized kernel of SpinImageKernel.h.
+ *
+ *  If shared neighborhoods are enabled, the evaluation of multiple points groups the points by voxels. For every
+ *  voxel, the neighbors of all its points are retrieved by a single radius search around the center of their
+ *  bounding box with the radius enlarged by half of the extent of the box. The neighbors of each point are then
+ *  selected from this superset, such that dense segments need considerably less traversals of the search tree.
+ *  The spin images are the same as without sharing only if the radius search is exact.
  *
  *  \author you
  */
@@ -31,14 +52,111 @@ class SpinImage: public PointDescriptor
 
     SpinImage* clone() const;
 
+    /** \brief buffers of the radius search and the offsets as structure of arrays for the binning kernel.
+     *
+     *  Callers evaluating many single points can keep the buffers, such that their capacity is reused.
+     */
+    struct Buffers
+    {
+        std::vector<uint32_t> neighbors;
+        std::vector<Vector3f> offsets;
+        std::vector<float> x, y, z;
+        // coordinates of the neighbors of a voxel, if neighborhoods are shared.
+        std::vector<float> sx, sy, sz;
+        // points of a block and the start of their neighbors, if the points are searched at once.
+        std::vector<Point3f> queries;
+        std::vector<uint32_t> starts;
+    };
+
+    void evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan& scan,
+        const NearestNeighborImpl& nn) const;
+
+    /** \brief evaluate the spin image of the point p with the given buffers for the radius search. **/
     void evaluate(float* values, const Point3f& p, const Normal3f& ref, const Laserscan& scan,
+        const NearestNeighborImpl& nn, Buffers& buffers) const;
+
+    /** \brief evaluate the spin image of the point with given index, which uses its normal if normals are used. **/
+    void evaluate(float* values, uint32_t index, const Normal3f& ref, const Laserscan& scan,
         const NearestNeighborImpl& nn) const;
+
+    /** \brief evaluate the spin image of the point with given index with the given buffers for the radius search. **/
+    void evaluate(float* values, uint32_t index, const Normal3f& ref, const Laserscan& scan,
+        const NearestNeighborImpl& nn, Buffers& buffers) const;
+
+    /** \brief evaluate the spin images of all given points in parallel.
+     *
+     *  The points are distributed in blocks of BLOCK_SIZE points, or in voxels if neighborhoods are shared, to the
+     *  threads, where every thread uses its own buffers for the radius search. The neighbors of a block are
+     *  retrieved by a single batched radius search, which shares the traversal of the search tree. Thus, the nearest neighbor search
+     *  must support concurrent queries. The buffers are local to every call, such that the descriptor itself can
+     *  be evaluated by multiple threads at once.
+     */
+    void evaluate(float* values, const std::vector<uint32_t>& indexes, const Normal3f& ref, const Laserscan& scan,
+        const NearestNeighborImpl& nn) const;
+
     uint32_t dim() const;
 
+    /** \brief number of threads used for evaluating multiple points. [default: 1] **/
+    void setNumThreads(uint32_t numThreads);
+
+    /** \brief edge length of voxels, whose points share a single radius search; 0 disables sharing. **/
+    void setSharedNeighborhoods(float voxelSize);
+
+    /** \brief use the normals of the scan instead of the given reference axis for points given by index. **/
+    void setUseNormals(bool useNormals);
+    bool usesNormals() const;
+
+    /** \brief format used for storing spin images, e.g., by DescriptorCache. **/
+    DescriptorFormat format() const;
+
   protected:
+    /** \brief spin image of a single point, where the given buffers are used for the radius search. **/
+    void compute(float* values, const Point3f& p, const Normal3f& ref, const NearestNeighborImpl& nn,
+        Buffers& buffers) const;
+
+    /** \brief reference axis of the point with the given index. **/
+    const Normal3f& axis(const Laserscan& scan, uint32_t index, const Normal3f& ref) const;
+
+    /** \brief histogram of the neighbor offsets stored in buffers.x, buffers.y, and buffers.z. **/
+    void histogram(float* values, const Normal3f& ref, Buffers& buffers) const;
+
+    /** \brief evaluate n points with a single batched radius search of the nearest neighbor search. **/
+    void evaluateBlock(float* values, const uint32_t* indexes, uint32_t n, const Normal3f& ref,
+        const Laserscan& scan, const NearestNeighborImpl& nn, Buffers& buffers) const;
+
+    /** \brief evaluate blocks of points until all points are taken by threads. **/
+    void evaluateBlocks(float* values, const std::vector<uint32_t>* indexes, const Normal3f* ref,
+        const Laserscan* scan, const NearestNeighborImpl* nn, uint32_t* next, boost::mutex* mutex) const;
+
+    /** \brief positions of the evaluated points sorted by voxels, where voxel v contains the positions
+     *  order[groups[v]], ..., order[groups[v+1]-1].
+     */
+    struct Voxels
+    {
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> groups;
+    };
+
+    /** \brief evaluate the points of a voxel with a single radius search. **/
+    void evaluateVoxel(float* values, const std::vector<uint32_t>& indexes, const uint32_t* order, uint32_t n,
+        const Normal3f& ref, const Laserscan& scan, const NearestNeighborImpl& nn, Buffers& buffers) const;
+
+    /** \brief evaluate voxels until all voxels are taken by threads. **/
+    void evaluateVoxels(float* values, const std::vector<uint32_t>* indexes, const Voxels* voxels,
+        const Normal3f* ref, const Laserscan* scan, const NearestNeighborImpl* nn, uint32_t* next,
+        boost::mutex* mutex) const;
+
+    // number of points, which are evaluated by a thread at once.
+    static const uint32_t BLOCK_SIZE = 64;
+
+
     uint32_t num_bins_;
     float radius_;
     bool bilinear_interp_;
+    uint32_t numThreads_;
+    float voxelSize_;
+    bool useNormals_;
+    DescriptorFormat format_;
 
     rv::MaximumNorm norm_;
     rv::Normalizer* normalizer_;
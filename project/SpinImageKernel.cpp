@@ -0,0 +1,221 @@
+#include "SpinImageKernel.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/** \brief add the neighbor in cell (i, j) with fractional position (a, b) inside the cell. **/
+inline void accumulate(float* histogram, int32_t numBins, int32_t i, int32_t j, float a, float b, bool bilinear)
+{
+  if (!bilinear)
+  {
+    histogram[j * numBins + i] += 1.0f;
+    return;
+  }
+
+  histogram[j * numBins + i] += (1.0f - a) * (1.0f - b);
+  if (i + 1 < numBins) histogram[j * numBins + i + 1] += a * (1.0f - b);
+  if (j + 1 < numBins)
+  {
+    histogram[(j + 1) * numBins + i] += (1.0f - a) * b;
+    if (i + 1 < numBins) histogram[(j + 1) * numBins + i + 1] += a * b;
+  }
+}
+
+/** \brief cells and weights of the valid lanes given by the bits of mask. **/
+inline void accumulate(float* histogram, int32_t numBins, uint32_t mask, const int32_t* i, const int32_t* j,
+    const float* a, const float* b, bool bilinear)
+{
+  while (mask != 0)
+  {
+    const uint32_t lane = __builtin_ctz(mask);
+    accumulate(histogram, numBins, i[lane], j[lane], a[lane], b[lane], bilinear);
+    mask &= mask - 1;
+  }
+}
+
+#if defined(__AVX512F__)
+
+uint32_t binning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  const __m512 vrx = _mm512_set1_ps(rx), vry = _mm512_set1_ps(ry), vrz = _mm512_set1_ps(rz);
+  const __m512 vrr = _mm512_set1_ps(rx * rx + ry * ry + rz * rz);
+  const __m512 valphaScale = _mm512_set1_ps(numBins / radius), vbetaScale = _mm512_set1_ps(0.5f * numBins / radius);
+  const __m512 vradius = _mm512_set1_ps(radius), vbins = _mm512_set1_ps(numBins), zero = _mm512_setzero_ps();
+
+  int32_t ci[16], cj[16];
+  float a[16], b[16];
+
+  uint32_t k = 0;
+  for (; k + 16 <= n; k += 16)
+  {
+    const __m512 dx = _mm512_loadu_ps(x + k), dy = _mm512_loadu_ps(y + k), dz = _mm512_loadu_ps(z + k);
+
+    const __m512 beta = _mm512_fmadd_ps(vrz, dz, _mm512_fmadd_ps(vry, dy, _mm512_mul_ps(vrx, dx)));
+    const __m512 dd = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+    const __m512 alpha = _mm512_sqrt_ps(_mm512_max_ps(zero, _mm512_fmsub_ps(dd, vrr, _mm512_mul_ps(beta, beta))));
+
+    const __m512 u = _mm512_mul_ps(alpha, valphaScale);
+    const __m512 v = _mm512_mul_ps(_mm512_add_ps(beta, vradius), vbetaScale);
+    const __mmask16 mask = _mm512_cmp_ps_mask(u, vbins, _CMP_LT_OQ) & _mm512_cmp_ps_mask(v, zero, _CMP_GE_OQ)
+        & _mm512_cmp_ps_mask(v, vbins, _CMP_LT_OQ);
+    if (mask == 0) continue;
+
+    const __m512i i = _mm512_cvttps_epi32(u), j = _mm512_cvttps_epi32(v);
+    _mm512_storeu_si512(ci, i);
+    _mm512_storeu_si512(cj, j);
+    _mm512_storeu_ps(a, _mm512_sub_ps(u, _mm512_cvtepi32_ps(i)));
+    _mm512_storeu_ps(b, _mm512_sub_ps(v, _mm512_cvtepi32_ps(j)));
+
+    accumulate(histogram, numBins, mask, ci, cj, a, b, bilinear);
+  }
+
+  return k;
+}
+
+const char* instructionSet = "AVX-512";
+
+#elif defined(__AVX2__)
+
+uint32_t binning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  const __m256 vrx = _mm256_set1_ps(rx), vry = _mm256_set1_ps(ry), vrz = _mm256_set1_ps(rz);
+  const __m256 vrr = _mm256_set1_ps(rx * rx + ry * ry + rz * rz);
+  const __m256 valphaScale = _mm256_set1_ps(numBins / radius), vbetaScale = _mm256_set1_ps(0.5f * numBins / radius);
+  const __m256 vradius = _mm256_set1_ps(radius), vbins = _mm256_set1_ps(numBins), zero = _mm256_setzero_ps();
+
+  int32_t ci[8], cj[8];
+  float a[8], b[8];
+
+  uint32_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    const __m256 dx = _mm256_loadu_ps(x + k), dy = _mm256_loadu_ps(y + k), dz = _mm256_loadu_ps(z + k);
+
+    const __m256 beta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vrx, dx), _mm256_mul_ps(vry, dy)),
+        _mm256_mul_ps(vrz, dz));
+    const __m256 dd = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(dz, dz));
+    const __m256 alpha = _mm256_sqrt_ps(_mm256_max_ps(zero, _mm256_sub_ps(_mm256_mul_ps(dd, vrr),
+        _mm256_mul_ps(beta, beta))));
+
+    const __m256 u = _mm256_mul_ps(alpha, valphaScale);
+    const __m256 v = _mm256_mul_ps(_mm256_add_ps(beta, vradius), vbetaScale);
+    const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(u, vbins, _CMP_LT_OQ),
+        _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, vbins, _CMP_LT_OQ)));
+    const uint32_t mask = _mm256_movemask_ps(valid);
+    if (mask == 0) continue;
+
+    const __m256i i = _mm256_cvttps_epi32(u), j = _mm256_cvttps_epi32(v);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ci), i);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(cj), j);
+    _mm256_storeu_ps(a, _mm256_sub_ps(u, _mm256_cvtepi32_ps(i)));
+    _mm256_storeu_ps(b, _mm256_sub_ps(v, _mm256_cvtepi32_ps(j)));
+
+    accumulate(histogram, numBins, mask, ci, cj, a, b, bilinear);
+  }
+
+  return k;
+}
+
+const char* instructionSet = "AVX2";
+
+#elif defined(__SSE2__)
+
+uint32_t binning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  const __m128 vrx = _mm_set1_ps(rx), vry = _mm_set1_ps(ry), vrz = _mm_set1_ps(rz);
+  const __m128 vrr = _mm_set1_ps(rx * rx + ry * ry + rz * rz);
+  const __m128 valphaScale = _mm_set1_ps(numBins / radius), vbetaScale = _mm_set1_ps(0.5f * numBins / radius);
+  const __m128 vradius = _mm_set1_ps(radius), vbins = _mm_set1_ps(numBins), zero = _mm_setzero_ps();
+
+  int32_t ci[4], cj[4];
+  float a[4], b[4];
+
+  uint32_t k = 0;
+  for (; k + 4 <= n; k += 4)
+  {
+    const __m128 dx = _mm_loadu_ps(x + k), dy = _mm_loadu_ps(y + k), dz = _mm_loadu_ps(z + k);
+
+    const __m128 beta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vrx, dx), _mm_mul_ps(vry, dy)), _mm_mul_ps(vrz, dz));
+    const __m128 dd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    const __m128 alpha = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_mul_ps(dd, vrr), _mm_mul_ps(beta, beta))));
+
+    const __m128 u = _mm_mul_ps(alpha, valphaScale);
+    const __m128 v = _mm_mul_ps(_mm_add_ps(beta, vradius), vbetaScale);
+    const __m128 valid = _mm_and_ps(_mm_cmplt_ps(u, vbins), _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, vbins)));
+    const uint32_t mask = _mm_movemask_ps(valid);
+    if (mask == 0) continue;
+
+    const __m128i i = _mm_cvttps_epi32(u), j = _mm_cvttps_epi32(v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ci), i);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(cj), j);
+    _mm_storeu_ps(a, _mm_sub_ps(u, _mm_cvtepi32_ps(i)));
+    _mm_storeu_ps(b, _mm_sub_ps(v, _mm_cvtepi32_ps(j)));
+
+    accumulate(histogram, numBins, mask, ci, cj, a, b, bilinear);
+  }
+
+  return k;
+}
+
+const char* instructionSet = "SSE2";
+
+#else
+
+uint32_t binning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  return 0;
+}
+
+const char* instructionSet = "scalar";
+
+#endif
+
+}
+
+void spinImageBinning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  // the vectorized kernel processes full vectors and the remaining neighbors are added by the reference.
+  const uint32_t k = binning(x, y, z, n, rx, ry, rz, radius, numBins, bilinear, histogram);
+  spinImageBinningScalar(x + k, y + k, z + k, n - k, rx, ry, rz, radius, numBins, bilinear, histogram);
+}
+
+void spinImageBinningScalar(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry,
+    float rz, float radius, uint32_t numBins, bool bilinear, float* histogram)
+{
+  const float rr = rx * rx + ry * ry + rz * rz;
+  const float alphaScale = numBins / radius, betaScale = 0.5f * numBins / radius;
+  const float bins = numBins;
+
+  for (uint32_t k = 0; k < n; ++k)
+  {
+    const float beta = rx * x[k] + ry * y[k] + rz * z[k];
+    const float dd = x[k] * x[k] + y[k] * y[k] + z[k] * z[k];
+    const float alpha = std::sqrt(std::max(0.0f, dd * rr - beta * beta));
+
+    const float u = alpha * alphaScale;
+    const float v = (beta + radius) * betaScale;
+    // written as negation, such that NaNs are skipped as in the vectorized kernels.
+    if (!(u < bins) || !(v >= 0.0f) || !(v < bins)) continue;
+
+    const int32_t i = static_cast<int32_t>(u), j = static_cast<int32_t>(v);
+    accumulate(histogram, numBins, i, j, u - i, v - j, bilinear);
+  }
+}
+
+const char* spinImageInstructionSet()
+{
+  return instructionSet;
+}
@@ -0,0 +1,43 @@
+#ifndef SPINIMAGEKERNEL_H_
+#define SPINIMAGEKERNEL_H_
+
+#include <stdint.h>
+
+/**
+ * Kernels for accumulating the spin image histogram of a contiguous block of neighbors.
+ *
+ * The offsets d = q - p of the neighbors q to the query point p are given as structure of arrays (x[], y[], z[]).
+ * For the reference axis r, every neighbor has the coordinates
+ *
+ *    beta = <r, d>  and  alpha = sqrt(|r|^2 |d|^2 - beta^2) = |r x d|,
+ *
+ * which avoids the cross product. The histogram has numBins x numBins cells with alpha in [0, radius) along the
+ * columns and beta in [-radius, radius) along the rows, i.e., the cell (i, j) is stored at histogram[j * numBins + i].
+ *
+ * Depending on the instruction set the code is compiled for, the cells and interpolation weights of 16 (AVX-512),
+ * 8 (AVX2), or 4 (SSE2) neighbors are computed at once. The accumulation into the histogram is done afterwards by
+ * a single loop over the valid lanes, thus neighbors in the same cell never conflict.
+ */
+
+/** \brief accumulate the spin image histogram of n neighbors.
+ *
+ *  \param x,y,z      offsets of the neighbors to the query point
+ *  \param n          number of neighbors
+ *  \param rx,ry,rz   reference axis
+ *  \param radius     radius of the spin image
+ *  \param numBins    number of bins per dimension
+ *  \param bilinear   distribute every neighbor with bilinear weights to the four adjacent cells, where weights
+ *                    of cells outside the histogram are dropped; otherwise only the cell is incremented.
+ *  \param histogram  numBins * numBins values, which are not reset.
+ */
+void spinImageBinning(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry, float rz,
+    float radius, uint32_t numBins, bool bilinear, float* histogram);
+
+/** \brief scalar reference implementation of spinImageBinning. **/
+void spinImageBinningScalar(const float* x, const float* y, const float* z, uint32_t n, float rx, float ry,
+    float rz, float radius, uint32_t numBins, bool bilinear, float* histogram);
+
+/** \brief name of the instruction set used by spinImageBinning. **/
+const char* spinImageInstructionSet();
+
+#endif /* SPINIMAGEKERNEL_H_ */
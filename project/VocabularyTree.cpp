@@ -0,0 +1,296 @@
+#include "VocabularyTree.h"
+
+#include <cfloat>
+#include <fstream>
+#include <algorithm>
+#include <eigen3/Eigen/Dense>
+#include <boost/lexical_cast.hpp>
+#include <rv/IOError.h>
+#include <rv/string_utils.h>
+
+#include "KMeans.h"
+#include "utils.h"
+
+using namespace rv;
+
+namespace
+{
+
+inline float distanceSqr(const float* a, const float* b, uint32_t D)
+{
+  return (Eigen::Map<const Eigen::VectorXf>(a, D) - Eigen::Map<const Eigen::VectorXf>(b, D)).squaredNorm();
+}
+
+}
+
+VocabularyTree::Node::Node(uint32_t first, uint32_t num, uint32_t w) :
+    firstChild(first), numChildren(num), word(w)
+{
+
+}
+
+VocabularyTree::VocabularyTree() :
+    dim_(0), depth_(0)
+{
+
+}
+
+VocabularyTree::VocabularyTree(const std::vector<std::vector<float> >& words) :
+    dim_(words.empty() ? 0 : words[0].size()), depth_(0)
+{
+  const uint32_t W = words.size();
+  if (W == 0) return;
+
+  nodes_.push_back(Node(1, W));
+  centers_.assign(dim_, 0.0f);
+  for (uint32_t i = 0; i < W; ++i)
+  {
+    nodes_.push_back(Node(0, 0, i));
+    centers_.insert(centers_.end(), words[i].begin(), words[i].end());
+  }
+
+  initialize(0, 0);
+}
+
+VocabularyTree::VocabularyTree(uint32_t dim, const std::vector<Node>& nodes, const std::vector<float>& centers) :
+    dim_(dim), depth_(0), nodes_(nodes), centers_(centers)
+{
+  if (!nodes_.empty()) initialize(0, 0);
+}
+
+void VocabularyTree::train(const DescriptorMatrix& data, uint32_t branching, uint32_t depth)
+{
+  dim_ = data.dim();
+  depth_ = 0;
+  nodes_.clear();
+  centers_.clear();
+  words_.clear();
+  if (data.size() == 0) return;
+
+  // the root is only used to descend to its children, but gets the mean as center for trees with a single word.
+  std::vector<float> mean(dim_, 0.0f);
+  for (uint32_t i = 0; i < data.size(); ++i)
+    data.add(i, &mean[0]);
+  for (uint32_t j = 0; j < dim_; ++j)
+    mean[j] /= data.size();
+
+  nodes_.push_back(Node());
+  centers_ = mean;
+  split(0, data, 0, std::max<uint32_t>(branching, 2), std::max<uint32_t>(depth, 1));
+
+  initialize(0, 0);
+}
+
+void VocabularyTree::split(uint32_t node, const DescriptorMatrix& data, uint32_t level, uint32_t branching,
+    uint32_t depth)
+{
+  const uint32_t C = std::min<uint32_t>(branching, data.size());
+  if (level == depth || C < 2)
+  {
+    addLeaf(node);
+    return;
+  }
+
+  KMeans kmeans;
+  std::vector<std::vector<float> > centers = kmeans.cluster(data, C);
+
+  // descriptors are assigned to the nearest center, as in the lookup.
+  std::vector<DescriptorMatrix> parts(C, DescriptorMatrix(data.format(), dim_));
+  for (uint32_t i = 0; i < data.size(); ++i)
+  {
+    uint32_t nearest = 0;
+    float minDistance = FLT_MAX;
+    for (uint32_t c = 0; c < C; ++c)
+    {
+      const float d = data.distanceSqr(i, &centers[c][0]);
+      if (d < minDistance)
+      {
+        minDistance = d;
+        nearest = c;
+      }
+    }
+    parts[nearest].push_back(data, i);
+  }
+
+  // empty clusters do not become children, since no descriptor is assigned to them.
+  const uint32_t firstChild = nodes_.size();
+  std::vector<uint32_t> nonEmpty;
+  for (uint32_t c = 0; c < C; ++c)
+  {
+    if (parts[c].size() == 0) continue;
+    nonEmpty.push_back(c);
+    nodes_.push_back(Node());
+    centers_.insert(centers_.end(), centers[c].begin(), centers[c].end());
+  }
+  nodes_[node].firstChild = firstChild;
+  nodes_[node].numChildren = nonEmpty.size();
+
+  if (nonEmpty.size() < 2)
+  {
+    // no split, thus the node is a leaf.
+    nodes_.resize(firstChild);
+    centers_.resize(uint64_t(firstChild) * dim_);
+    nodes_[node].numChildren = 0;
+    addLeaf(node);
+    return;
+  }
+
+  for (uint32_t i = 0; i < nonEmpty.size(); ++i)
+    split(firstChild + i, parts[nonEmpty[i]], level + 1, branching, depth);
+}
+
+void VocabularyTree::addLeaf(uint32_t node)
+{
+  nodes_[node].firstChild = 0;
+  nodes_[node].numChildren = 0;
+  nodes_[node].word = words_.size();
+  words_.push_back(std::vector<float>());
+}
+
+void VocabularyTree::initialize(uint32_t node, uint32_t level)
+{
+  const Node& n = nodes_[node];
+  depth_ = std::max(depth_, level);
+
+  if (n.numChildren == 0)
+  {
+    if (words_.size() <= n.word) words_.resize(n.word + 1);
+    const float* center = &centers_[uint64_t(node) * dim_];
+    words_[n.word].assign(center, center + dim_);
+    return;
+  }
+
+  for (uint32_t i = 0; i < n.numChildren; ++i)
+    initialize(n.firstChild + i, level + 1);
+}
+
+uint32_t VocabularyTree::lookup(const float* descriptor) const
+{
+  uint32_t node = 0;
+  while (nodes_[node].numChildren > 0)
+  {
+    const Node& n = nodes_[node];
+    uint32_t nearest = n.firstChild;
+    float minDistance = FLT_MAX;
+    for (uint32_t c = n.firstChild; c < n.firstChild + n.numChildren; ++c)
+    {
+      const float d = distanceSqr(&centers_[uint64_t(c) * dim_], descriptor, dim_);
+      if (d < minDistance)
+      {
+        minDistance = d;
+        nearest = c;
+      }
+    }
+    node = nearest;
+  }
+
+  return nodes_[node].word;
+}
+
+const std::vector<std::vector<float> >& VocabularyTree::words() const
+{
+  return words_;
+}
+
+const std::vector<VocabularyTree::Node>& VocabularyTree::nodes() const
+{
+  return nodes_;
+}
+
+const std::vector<float>& VocabularyTree::centers() const
+{
+  return centers_;
+}
+
+uint32_t VocabularyTree::dim() const
+{
+  return dim_;
+}
+
+uint32_t VocabularyTree::depth() const
+{
+  return depth_;
+}
+
+void readVocabulary(const std::string& filename, VocabularyTree& tree)
+{
+  std::ifstream in(filename.c_str());
+
+  if (!in.is_open()) throw IOError("Unable to open vocabulary file.");
+
+  std::string line;
+  std::getline(in, line);
+  std::vector<std::string> tokens = split(line, ":");
+  if (tokens.size() != 4) throw IOError("Invalid vocabulary file.");
+  if (tokens[1] == "1.0")
+  {
+    in.close();
+    std::vector<std::vector<float> > vocabulary;
+    readVocabulary(filename, vocabulary);
+    tree = VocabularyTree(vocabulary);
+    return;
+  }
+  if (tokens[1] != "2.0") throw IOError("Unknown version of vocabulary file.");
+
+  const uint32_t M = boost::lexical_cast<uint32_t>(tokens[2]);
+  const uint32_t D = boost::lexical_cast<uint32_t>(tokens[3]);
+
+  std::vector<VocabularyTree::Node> nodes(M);
+  std::vector<float> centers(uint64_t(M) * D);
+  for (uint32_t i = 0; i < M; ++i)
+  {
+    VocabularyTree::Node& node = nodes[i];
+    in.read((char*) &node.firstChild, sizeof(uint32_t));
+    in.read((char*) &node.numChildren, sizeof(uint32_t));
+    in.read((char*) &node.word, sizeof(uint32_t));
+    in.read((char*) &centers[uint64_t(i) * D], D * sizeof(float));
+    if (!in.good()) throw IOError("Error while reading vocabulary tree from file.");
+    if (node.numChildren > 0 && (node.firstChild <= i || node.firstChild + node.numChildren > M))
+      throw IOError("Invalid vocabulary tree.");
+  }
+
+  // the L leaves must use every word 0, ..., L-1 exactly once.
+  uint32_t numLeaves = 0;
+  for (uint32_t i = 0; i < M; ++i)
+    if (nodes[i].numChildren == 0) ++numLeaves;
+
+  std::vector<bool> used(numLeaves, false);
+  for (uint32_t i = 0; i < M; ++i)
+  {
+    if (nodes[i].numChildren > 0) continue;
+    if (nodes[i].word >= numLeaves || used[nodes[i].word]) throw IOError("Invalid words of vocabulary tree.");
+    used[nodes[i].word] = true;
+  }
+
+  tree = VocabularyTree(D, nodes, centers);
+
+  in.close();
+}
+
+void writeVocabulary(const std::string& filename, const VocabularyTree& tree)
+{
+  if (tree.depth() <= 1)
+  {
+    writeVocabulary(filename, tree.words());
+    return;
+  }
+
+  std::ofstream out(filename.c_str());
+
+  if (!out.is_open()) throw IOError("Unable to open vocabulary file.");
+
+  const std::vector<VocabularyTree::Node>& nodes = tree.nodes();
+  const uint32_t M = nodes.size();
+  const uint32_t D = tree.dim();
+
+  out << "VOC:2.0:" << M << ":" << D << std::endl;
+  for (uint32_t i = 0; i < M; ++i)
+  {
+    out.write((const char*) &nodes[i].firstChild, sizeof(uint32_t));
+    out.write((const char*) &nodes[i].numChildren, sizeof(uint32_t));
+    out.write((const char*) &nodes[i].word, sizeof(uint32_t));
+    out.write((const char*) &tree.centers()[uint64_t(i) * D], D * sizeof(float));
+  }
+
+  out.close();
+}
@@ -0,0 +1,81 @@
+#ifndef VOCABULARYTREE_H_
+#define VOCABULARYTREE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+#include "DescriptorFormat.h"
+
+/** \brief hierarchical vocabulary, where the words are the leaves of a tree of cluster centers.
+ *
+ *  The tree is trained by hierarchical k-means: the descriptors of a node are clustered by KMeans into
+ *  (at most) b children, and the descriptors assigned to a child are clustered again until the depth L is
+ *  reached. Thus, the tree has at most b^L words, and the word of a descriptor is found with only b * L distance
+ *  computations by descending to the nearest child at every level. The word found this way is not necessarily the
+ *  nearest of all words, but the nearest in the partition of the descriptor space given by the tree.
+ *
+ *  The nodes are stored such that the children of a node are consecutive, where the root is the first node. A
+ *  flat vocabulary is a tree of depth 1, whose words are the children of the root.
+ *
+ *  A vocabulary tree is stored as version 2.0 of the vocabulary files, i.e., "VOC:2.0:<num nodes>:<dim>" followed
+ *  by the first child, the number of children, and the word of every node as uint32 and its center as floats.
+ *
+ *  \author you
+ */
+class VocabularyTree
+{
+  public:
+    /** \brief node of the tree with the range of its children, where leaves have no children and a word. **/
+    struct Node
+    {
+        Node(uint32_t firstChild = 0, uint32_t numChildren = 0, uint32_t word = 0);
+
+        uint32_t firstChild;
+        uint32_t numChildren;
+        uint32_t word;
+    };
+
+    VocabularyTree();
+    /** \brief flat vocabulary with the given words. **/
+    explicit VocabularyTree(const std::vector<std::vector<float> >& words);
+    /** \brief tree with given nodes and their centers, where the center of the i-th node starts at i * dim. **/
+    VocabularyTree(uint32_t dim, const std::vector<Node>& nodes, const std::vector<float>& centers);
+
+    /** \brief train tree with given branching factor and depth from the given descriptors. **/
+    void train(const DescriptorMatrix& data, uint32_t branching, uint32_t depth);
+
+    /** \brief index of the word of given descriptor with dim() values. **/
+    uint32_t lookup(const float* descriptor) const;
+
+    /** \brief centers of the leaves, where the i-th word is the center of the leaf with word i. **/
+    const std::vector<std::vector<float> >& words() const;
+
+    const std::vector<Node>& nodes() const;
+    const std::vector<float>& centers() const;
+
+    uint32_t dim() const;
+    /** \brief maximal number of levels below the root, i.e., 1 for a flat vocabulary and 0 for an empty tree. **/
+    uint32_t depth() const;
+
+  protected:
+    /** \brief split the given node by clustering its descriptors, or make it a leaf at the maximal depth. **/
+    void split(uint32_t node, const DescriptorMatrix& data, uint32_t level, uint32_t branching, uint32_t depth);
+    void addLeaf(uint32_t node);
+
+    /** \brief collect words of the leaves and determine depth of the subtree of the given node. **/
+    void initialize(uint32_t node, uint32_t level);
+
+    uint32_t dim_;
+    uint32_t depth_;
+    std::vector<Node> nodes_;
+    std::vector<float> centers_;
+    std::vector<std::vector<float> > words_;
+};
+
+/** \brief read flat vocabulary (VOC:1.0) or vocabulary tree (VOC:2.0) from given filename. **/
+void readVocabulary(const std::string& filename, VocabularyTree& tree);
+/** \brief write vocabulary tree to given filename, where a flat vocabulary is written as VOC:1.0. **/
+void writeVocabulary(const std::string& filename, const VocabularyTree& tree);
+
+#endif /* VOCABULARYTREE_H_ */
@@ -0,0 +1,595 @@
+#include "VoxelHashGrid.h"
+#include "RadiusScan.h"
+#include <rv/Error.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace rv;
+
+const uint32_t VoxelHashGrid::EMPTY;
+
+VoxelHashGrid::VoxelHashGrid(float cellSize) :
+    cellSize_(cellSize), invCellSize_(1.0f / cellSize), tableMask_(0), segment_(ALL_SEGMENTS)
+{
+  if (!(cellSize > 0.0f)) throw Error("Cell size of the voxel grid must be positive.");
+
+  for (uint32_t d = 0; d < 3; ++d)
+  {
+    min_[d] = 0;
+    max_[d] = -1;
+  }
+}
+
+void VoxelHashGrid::clear()
+{
+  // keep the capacity of the buffers for the next initialization.
+  table_.clear();
+  cells_.clear();
+  indexes_.clear();
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  segmentIds_.clear();
+  segment_ = ALL_SEGMENTS;
+  for (uint32_t d = 0; d < 3; ++d)
+  {
+    min_[d] = 0;
+    max_[d] = -1;
+  }
+}
+
+void VoxelHashGrid::initialize(const std::vector<Point3f>& points, const std::vector<uint32_t>& indexes)
+{
+  clear();
+
+  if (indexes.size() == 0) return;
+
+  const uint32_t N = indexes.size();
+  indexes_.assign(indexes.begin(), indexes.end());
+  x_.resize(N);
+  y_.resize(N);
+  z_.resize(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const Point3f& p = points[indexes[i]];
+    x_[i] = p.x();
+    y_[i] = p.y();
+    z_[i] = p.z();
+  }
+
+  build();
+}
+
+void VoxelHashGrid::initialize(const std::vector<Point3f>& points, const std::vector<IndexedSegment>& segments)
+{
+  clear();
+
+  uint32_t N = 0;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+    N += segments[s].size();
+
+  if (N == 0) return;
+
+  indexes_.resize(N);
+  x_.resize(N);
+  y_.resize(N);
+  z_.resize(N);
+  segmentIds_.resize(N);
+  for (uint32_t s = 0, i = 0; s < segments.size(); ++s)
+  {
+    const std::vector<uint32_t>& indexes = segments[s].indexes;
+    for (uint32_t j = 0; j < indexes.size(); ++j, ++i)
+    {
+      indexes_[i] = indexes[j];
+      const Point3f& p = points[indexes[j]];
+      x_[i] = p.x();
+      y_[i] = p.y();
+      z_[i] = p.z();
+      segmentIds_[i] = s;
+    }
+  }
+
+  build();
+}
+
+void VoxelHashGrid::setSegment(uint32_t segment)
+{
+  segment_ = segment;
+}
+
+void VoxelHashGrid::build()
+{
+  const uint32_t N = indexes_.size();
+
+  // at least twice as many slots as points, i.e., the load factor is at most 0.5.
+  uint32_t size = 16;
+  while (size < 2 * N)
+    size <<= 1;
+  table_.assign(size, EMPTY);
+  tableMask_ = size - 1;
+
+  // (1) determine the cell of every point.
+  pointCells_.resize(N);
+  for (uint32_t i = 0; i < N; ++i)
+    pointCells_[i] = insert(cellCoordinate(x_[i]), cellCoordinate(y_[i]), cellCoordinate(z_[i]));
+
+  // (2) counting sort of the points by their cell.
+  for (uint32_t i = 0; i < N; ++i)
+    cells_[pointCells_[i]].end += 1;
+
+  uint32_t offset = 0;
+  for (uint32_t c = 0; c < cells_.size(); ++c)
+  {
+    cells_[c].start = offset;
+    offset += cells_[c].end;
+    cells_[c].end = cells_[c].start;
+  }
+
+  tmpIndexes_.resize(N);
+  tmpX_.resize(N);
+  tmpY_.resize(N);
+  tmpZ_.resize(N);
+  tmpSegmentIds_.resize(segmentIds_.size());
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const uint32_t pos = cells_[pointCells_[i]].end++;
+    tmpIndexes_[pos] = indexes_[i];
+    tmpX_[pos] = x_[i];
+    tmpY_[pos] = y_[i];
+    tmpZ_[pos] = z_[i];
+    if (!segmentIds_.empty()) tmpSegmentIds_[pos] = segmentIds_[i];
+  }
+
+  indexes_.swap(tmpIndexes_);
+  x_.swap(tmpX_);
+  y_.swap(tmpY_);
+  z_.swap(tmpZ_);
+  segmentIds_.swap(tmpSegmentIds_);
+
+  // (3) segments and range of the cells.
+  for (uint32_t c = 0; c < cells_.size(); ++c)
+  {
+    Cell& cell = cells_[c];
+    if (!segmentIds_.empty())
+    {
+      cell.segment = segmentIds_[cell.start];
+      for (uint32_t i = cell.start + 1; i < cell.end; ++i)
+        if (segmentIds_[i] != cell.segment) cell.segment = ALL_SEGMENTS;
+    }
+
+    if (c == 0)
+    {
+      min_[0] = max_[0] = cell.i;
+      min_[1] = max_[1] = cell.j;
+      min_[2] = max_[2] = cell.k;
+    }
+    min_[0] = std::min(min_[0], cell.i);
+    min_[1] = std::min(min_[1], cell.j);
+    min_[2] = std::min(min_[2], cell.k);
+    max_[0] = std::max(max_[0], cell.i);
+    max_[1] = std::max(max_[1], cell.j);
+    max_[2] = std::max(max_[2], cell.k);
+  }
+}
+
+int32_t VoxelHashGrid::cellCoordinate(float v) const
+{
+  return static_cast<int32_t>(std::floor(v * invCellSize_));
+}
+
+uint32_t VoxelHashGrid::hash(int32_t i, int32_t j, int32_t k)
+{
+  // hash function of Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects".
+  return (static_cast<uint32_t>(i) * 73856093u) ^ (static_cast<uint32_t>(j) * 19349663u)
+      ^ (static_cast<uint32_t>(k) * 83492791u);
+}
+
+uint32_t VoxelHashGrid::find(int32_t i, int32_t j, int32_t k) const
+{
+  if (table_.empty()) return EMPTY;
+
+  for (uint32_t slot = hash(i, j, k) & tableMask_;; slot = (slot + 1) & tableMask_)
+  {
+    const uint32_t c = table_[slot];
+    if (c == EMPTY) return EMPTY;
+    if (cells_[c].i == i && cells_[c].j == j && cells_[c].k == k) return c;
+  }
+
+  return EMPTY;
+}
+
+uint32_t VoxelHashGrid::insert(int32_t i, int32_t j, int32_t k)
+{
+  uint32_t slot = hash(i, j, k) & tableMask_;
+  for (;; slot = (slot + 1) & tableMask_)
+  {
+    const uint32_t c = table_[slot];
+    if (c == EMPTY) break;
+    if (cells_[c].i == i && cells_[c].j == j && cells_[c].k == k) return c;
+  }
+
+  Cell cell;
+  cell.i = i;
+  cell.j = j;
+  cell.k = k;
+  cell.start = cell.end = 0;
+  cell.segment = ALL_SEGMENTS;
+
+  table_[slot] = cells_.size();
+  cells_.push_back(cell);
+
+  return table_[slot];
+}
+
+bool VoxelHashGrid::skip(const Cell& cell) const
+{
+  // with a restriction to a segment, cells of other segments can be skipped.
+  return (segment_ != ALL_SEGMENTS && cell.segment != ALL_SEGMENTS && cell.segment != segment_
+      && !segmentIds_.empty());
+}
+
+template<typename Distance>
+void VoxelHashGrid::scanCell(const Cell& cell, const Point3f& query, float threshold, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  if (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && cell.segment != segment_)
+  {
+    for (uint32_t i = cell.start; i < cell.end; ++i)
+    {
+      if (segmentIds_[i] != segment_) continue;
+      if (dist.compare(x_[i] - query.x(), y_[i] - query.y(), z_[i] - query.z()) <= threshold)
+        neighbors.push_back(indexes_[i]);
+    }
+  }
+  else
+  {
+    const uint32_t s = cell.start;
+    const uint32_t offset = neighbors.size();
+    neighbors.resize(offset + cell.end - cell.start);
+    uint32_t count = radiusScan(dist, &x_[s], &y_[s], &z_[s], &indexes_[s], cell.end - cell.start, query.x(),
+        query.y(), query.z(), threshold, &neighbors[offset]);
+    neighbors.resize(offset + count);
+  }
+}
+
+void VoxelHashGrid::cellRange(const Point3f& query, float radius, int32_t lo[3], int32_t hi[3]) const
+{
+  lo[0] = std::max(cellCoordinate(query.x() - radius), min_[0]);
+  lo[1] = std::max(cellCoordinate(query.y() - radius), min_[1]);
+  lo[2] = std::max(cellCoordinate(query.z() - radius), min_[2]);
+  hi[0] = std::min(cellCoordinate(query.x() + radius), max_[0]);
+  hi[1] = std::min(cellCoordinate(query.y() + radius), max_[1]);
+  hi[2] = std::min(cellCoordinate(query.z() + radius), max_[2]);
+}
+
+template<typename Distance>
+float VoxelHashGrid::minDistance(const Point3f& query, int32_t i, int32_t j, int32_t k, const Distance& dist) const
+{
+  // distance to the closest point of the cell [i, i+1) x [j, j+1) x [k, k+1) along each axis.
+  float x = std::max(0.0f, std::max(i * cellSize_ - query.x(), query.x() - (i + 1) * cellSize_));
+  float y = std::max(0.0f, std::max(j * cellSize_ - query.y(), query.y() - (j + 1) * cellSize_));
+  float z = std::max(0.0f, std::max(k * cellSize_ - query.z(), query.z() - (k + 1) * cellSize_));
+
+  return dist.compare(x, y, z);
+}
+
+template<typename Distance>
+float VoxelHashGrid::maxDistance(const Point3f& query, int32_t i, int32_t j, int32_t k, const Distance& dist) const
+{
+  float x = std::max(std::abs(i * cellSize_ - query.x()), std::abs((i + 1) * cellSize_ - query.x()));
+  float y = std::max(std::abs(j * cellSize_ - query.y()), std::abs((j + 1) * cellSize_ - query.y()));
+  float z = std::max(std::abs(k * cellSize_ - query.z()), std::abs((k + 1) * cellSize_ - query.z()));
+
+  return dist.compare(x, y, z);
+}
+
+struct VoxelHashGrid::RadiusSearch
+{
+    RadiusSearch(const VoxelHashGrid& g, const Point3f& q, float r, std::vector<uint32_t>& n) :
+        grid(g), query(q), radius(r), neighbors(n)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      grid.radiusSearch(query, radius, neighbors, dist);
+    }
+
+    const VoxelHashGrid& grid;
+    const Point3f& query;
+    float radius;
+    std::vector<uint32_t>& neighbors;
+};
+
+struct VoxelHashGrid::OffsetSearch
+{
+    OffsetSearch(const VoxelHashGrid& g, const Point3f& q, float r, std::vector<uint32_t>& n,
+        std::vector<Vector3f>& off) :
+        grid(g), query(q), radius(r), neighbors(n), offsets(off)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      grid.offsetNeighbors(query, radius, neighbors, offsets, dist);
+    }
+
+    const VoxelHashGrid& grid;
+    const Point3f& query;
+    float radius;
+    std::vector<uint32_t>& neighbors;
+    std::vector<Vector3f>& offsets;
+};
+
+struct VoxelHashGrid::CountSearch
+{
+    CountSearch(const VoxelHashGrid& g, const Point3f& q, float r) :
+        grid(g), query(q), radius(r), count(0)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      count = grid.countInRadius(query, radius, dist);
+    }
+
+    const VoxelHashGrid& grid;
+    const Point3f& query;
+    float radius;
+    uint32_t count;
+};
+
+struct VoxelHashGrid::KnnSearch
+{
+    KnnSearch(const VoxelHashGrid& g, const Point3f& q, uint32_t num, std::vector<uint32_t>& n) :
+        grid(g), query(q), k(num), neighbors(n)
+    {
+    }
+
+    template<typename Distance>
+    void operator()(const Distance& dist)
+    {
+      grid.knnSearch(query, k, neighbors, dist);
+    }
+
+    const VoxelHashGrid& grid;
+    const Point3f& query;
+    uint32_t k;
+    std::vector<uint32_t>& neighbors;
+};
+
+void VoxelHashGrid::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    const Norm& norm) const
+{
+  neighbors.clear();
+  if (cells_.empty()) return;
+
+  // dispatch once to the search specialized for the norm.
+  RadiusSearch search(*this, query, radius, neighbors);
+  dispatchNorm(norm, search);
+}
+
+template<typename Distance>
+void VoxelHashGrid::radiusSearch(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  const float threshold = dist.threshold(radius);
+  int32_t lo[3], hi[3];
+  cellRange(query, radius, lo, hi);
+
+  for (int32_t i = lo[0]; i <= hi[0]; ++i)
+  {
+    for (int32_t j = lo[1]; j <= hi[1]; ++j)
+    {
+      for (int32_t k = lo[2]; k <= hi[2]; ++k)
+      {
+        const uint32_t c = find(i, j, k);
+        if (c == EMPTY || skip(cells_[c])) continue;
+        if (minDistance(query, i, j, k, dist) > threshold) continue;
+
+        scanCell(cells_[c], query, threshold, neighbors, dist);
+      }
+    }
+  }
+}
+
+void VoxelHashGrid::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>& offsets, const Norm& norm) const
+{
+  neighbors.clear();
+  offsets.clear();
+  if (cells_.empty()) return;
+
+  OffsetSearch search(*this, query, radius, neighbors, offsets);
+  dispatchNorm(norm, search);
+}
+
+template<typename Distance>
+void VoxelHashGrid::offsetNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+    std::vector<Vector3f>& offsets, const Distance& dist) const
+{
+  const float threshold = dist.threshold(radius);
+  int32_t lo[3], hi[3];
+  cellRange(query, radius, lo, hi);
+
+  for (int32_t i = lo[0]; i <= hi[0]; ++i)
+  {
+    for (int32_t j = lo[1]; j <= hi[1]; ++j)
+    {
+      for (int32_t k = lo[2]; k <= hi[2]; ++k)
+      {
+        const uint32_t c = find(i, j, k);
+        if (c == EMPTY || skip(cells_[c])) continue;
+        if (minDistance(query, i, j, k, dist) > threshold) continue;
+
+        const Cell& cell = cells_[c];
+        const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && cell.segment != segment_);
+        for (uint32_t n = cell.start; n < cell.end; ++n)
+        {
+          if (restricted && segmentIds_[n] != segment_) continue;
+
+          const float x = x_[n] - query.x(), y = y_[n] - query.y(), z = z_[n] - query.z();
+          if (dist.compare(x, y, z) <= threshold)
+          {
+            neighbors.push_back(indexes_[n]);
+            offsets.push_back(Vector3f(x, y, z));
+          }
+        }
+      }
+    }
+  }
+}
+
+uint32_t VoxelHashGrid::countNeighbors(const Point3f& query, float radius, const Norm& norm) const
+{
+  if (cells_.empty()) return 0;
+
+  CountSearch search(*this, query, radius);
+  dispatchNorm(norm, search);
+
+  return search.count;
+}
+
+template<typename Distance>
+uint32_t VoxelHashGrid::countInRadius(const Point3f& query, float radius, const Distance& dist) const
+{
+  uint32_t count = 0;
+  const float threshold = dist.threshold(radius);
+  int32_t lo[3], hi[3];
+  cellRange(query, radius, lo, hi);
+
+  for (int32_t i = lo[0]; i <= hi[0]; ++i)
+  {
+    for (int32_t j = lo[1]; j <= hi[1]; ++j)
+    {
+      for (int32_t k = lo[2]; k <= hi[2]; ++k)
+      {
+        const uint32_t c = find(i, j, k);
+        if (c == EMPTY || skip(cells_[c])) continue;
+        if (minDistance(query, i, j, k, dist) > threshold) continue;
+
+        const Cell& cell = cells_[c];
+        const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && cell.segment != segment_);
+        if (!restricted && maxDistance(query, i, j, k, dist) <= threshold)
+        {
+          // cell is inside the search ball.
+          count += cell.end - cell.start;
+          continue;
+        }
+
+        for (uint32_t n = cell.start; n < cell.end; ++n)
+        {
+          if (restricted && segmentIds_[n] != segment_) continue;
+          if (dist.compare(x_[n] - query.x(), y_[n] - query.y(), z_[n] - query.z()) <= threshold) ++count;
+        }
+      }
+    }
+  }
+
+  return count;
+}
+
+void VoxelHashGrid::knnNeighbors(const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+    const Norm& norm) const
+{
+  neighbors.clear();
+  if (cells_.empty() || k == 0) return;
+
+  KnnSearch search(*this, query, k, neighbors);
+  dispatchNorm(norm, search);
+}
+
+template<typename Distance>
+void VoxelHashGrid::knnSearch(const Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+    const Distance& dist) const
+{
+  // the heap is ordered by dist.compare, which is monotonic in the distance.
+  typedef std::pair<float, uint32_t> Entry;
+  // max-heap of the k closest points found so far, i.e., the current k-th neighbor is at the front.
+  std::vector<Entry> closest;
+  closest.reserve(k);
+
+  const int32_t q[3] =
+  { cellCoordinate(query.x()), cellCoordinate(query.y()), cellCoordinate(query.z()) };
+  const float p[3] =
+  { query.x(), query.y(), query.z() };
+
+  // start with the first ring, which contains occupied cells.
+  int32_t ring = 0;
+  for (uint32_t d = 0; d < 3; ++d)
+    ring = std::max(ring, std::max(min_[d] - q[d], q[d] - max_[d]));
+
+  for (;; ++ring)
+  {
+    // visit all cells with maximum distance ring to the cell of the query.
+    const int32_t lo[3] =
+    { std::max(q[0] - ring, min_[0]), std::max(q[1] - ring, min_[1]), std::max(q[2] - ring, min_[2]) };
+    const int32_t hi[3] =
+    { std::min(q[0] + ring, max_[0]), std::min(q[1] + ring, max_[1]), std::min(q[2] + ring, max_[2]) };
+
+    for (int32_t i = lo[0]; i <= hi[0]; ++i)
+    {
+      for (int32_t j = lo[1]; j <= hi[1]; ++j)
+      {
+        // inside the ring only the first and last cell along the z-axis must be visited.
+        const bool border = (std::abs(i - q[0]) == ring || std::abs(j - q[1]) == ring);
+        const int32_t step = border ? 1 : std::max(2 * ring, 1);
+
+        for (int32_t l = q[2] - ring; l <= q[2] + ring; l += step)
+        {
+          if (l < lo[2] || l > hi[2]) continue;
+
+          const uint32_t c = find(i, j, l);
+          if (c == EMPTY || skip(cells_[c])) continue;
+
+          const Cell& cell = cells_[c];
+          const bool restricted = (segment_ != ALL_SEGMENTS && !segmentIds_.empty() && cell.segment != segment_);
+          for (uint32_t n = cell.start; n < cell.end; ++n)
+          {
+            if (restricted && segmentIds_[n] != segment_) continue;
+
+            const Entry candidate(dist.compare(x_[n] - query.x(), y_[n] - query.y(), z_[n] - query.z()),
+                indexes_[n]);
+            if (closest.size() < k)
+            {
+              closest.push_back(candidate);
+              std::push_heap(closest.begin(), closest.end());
+            }
+            else if (candidate < closest.front())
+            {
+              std::pop_heap(closest.begin(), closest.end());
+              closest.back() = candidate;
+              std::push_heap(closest.begin(), closest.end());
+            }
+          }
+        }
+      }
+    }
+
+    // all cells visited?
+    bool visited = true;
+    for (uint32_t d = 0; d < 3; ++d)
+      visited = visited && (q[d] - ring <= min_[d]) && (q[d] + ring >= max_[d]);
+    if (visited) break;
+
+    if (closest.size() == k)
+    {
+      // cells outside the visited cube have at least the distance of the query to the faces of the cube.
+      float b[3];
+      for (uint32_t d = 0; d < 3; ++d)
+        b[d] = std::min(p[d] - (q[d] - ring) * cellSize_, (q[d] + ring + 1) * cellSize_ - p[d]);
+
+      const float bound = std::min(std::min(dist.compare(b[0], 0.0f, 0.0f), dist.compare(0.0f, b[1], 0.0f)),
+          dist.compare(0.0f, 0.0f, b[2]));
+      if (closest.front().first <= bound) break;
+    }
+  }
+
+  std::sort_heap(closest.begin(), closest.end());
+  neighbors.resize(closest.size());
+  for (uint32_t i = 0; i < closest.size(); ++i)
+    neighbors[i] = closest[i].second;
+}
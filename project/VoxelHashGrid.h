@@ -0,0 +1,145 @@
+#ifndef VOXELHASHGRID_H_
+#define VOXELHASHGRID_H_
+
+#include <vector>
+#include <rv/geometry.h>
+#include <rv/norms.h>
+#include <rv/IndexedSegment.h>
+#include "SegmentNeighborSearch.h"
+
+/** \brief uniform voxel grid for searching neighbors with a fixed radius.
+ *
+ *  The points are assigned to cubic cells of side length cellSize, which are found by an open-addressing
+ *  hash table of the integer cell coordinates. The points are sorted by their cell with a counting sort,
+ *  such that every cell corresponds to a range [start, end) of the point indexes and coordinates
+ *  (stored as x, y, and z arrays). Thus, the grid is built in O(N).
+ *
+ *  A radius search with radius <= cellSize inspects at most 27 cells, therefore the cell size should be
+ *  the radius used by the descriptors.
+ *
+ *  \author you
+ */
+class VoxelHashGrid: public SegmentNeighborSearch
+{
+  public:
+    /** \brief grid with the given side length of the cells, throws rv::Error if cellSize <= 0. **/
+    VoxelHashGrid(float cellSize);
+
+    void clear();
+
+    void initialize(const std::vector<rv::Point3f>& points, const std::vector<uint32_t>& indexes);
+    void initialize(const std::vector<rv::Point3f>& points, const std::vector<rv::IndexedSegment>& segments);
+
+    void setSegment(uint32_t segment);
+
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        const rv::Norm& dist) const;
+
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>& offsets, const rv::Norm& dist) const;
+
+    /** \brief number of radius neighbors, where cells inside the search ball are counted as a whole. **/
+    uint32_t countNeighbors(const rv::Point3f& query, float radius, const rv::Norm& dist) const;
+
+    /** \brief k nearest neighbors sorted by increasing distance.
+     *
+     *  Cells are visited in rings of increasing distance to the cell of the query until the k-th neighbor is
+     *  closer than all cells, which were not visited.
+     */
+    void knnNeighbors(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+        const rv::Norm& dist) const;
+
+    // "unhide" the base implementations.
+    using SegmentNeighborSearch::initialize;
+    using SegmentNeighborSearch::radiusNeighbors;
+  protected:
+    class Cell
+    {
+      public:
+        // integer coordinates of the cell.
+        int32_t i, j, k;
+        // range [start, end) in indexes_ and the coordinates x_, y_, z_
+        uint32_t start, end;
+        // segment of all points inside the cell, or ALL_SEGMENTS if the points belong to different segments.
+        uint32_t segment;
+    };
+
+    /** \brief sort the points already copied to indexes_, x_, y_, z_ and segmentIds_ into the cells. **/
+    void build();
+
+    /** \brief integer cell coordinate of a coordinate. **/
+    int32_t cellCoordinate(float v) const;
+
+    /** \brief index of cell (i, j, k) in cells_, or EMPTY if the cell contains no points. **/
+    uint32_t find(int32_t i, int32_t j, int32_t k) const;
+
+    /** \brief index of cell (i, j, k) in cells_, where the cell is appended if it is not in the table. **/
+    uint32_t insert(int32_t i, int32_t j, int32_t k);
+
+    static uint32_t hash(int32_t i, int32_t j, int32_t k);
+
+    /** \brief cell contains only points of segments other than the current segment? **/
+    bool skip(const Cell& cell) const;
+
+    /** \brief add points of the cell with dist.compare less or equal than threshold to the neighbors. **/
+    template<typename Distance>
+    void scanCell(const Cell& cell, const rv::Point3f& query, float threshold, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+
+    /** \brief range [lo, hi] of occupied cells overlapping the bounding box of the search ball. **/
+    void cellRange(const rv::Point3f& query, float radius, int32_t lo[3], int32_t hi[3]) const;
+
+    /** \brief dist.compare of the query to the closest point of the cell, which is zero for queries inside. **/
+    template<typename Distance>
+    float minDistance(const rv::Point3f& query, int32_t i, int32_t j, int32_t k, const Distance& dist) const;
+
+    /** \brief dist.compare of the query to the farthest corner of the cell. **/
+    template<typename Distance>
+    float maxDistance(const rv::Point3f& query, int32_t i, int32_t j, int32_t k, const Distance& dist) const;
+
+    /** \brief searches specialized for the norm, where the Distance is a norm policy of rv/norms.h. **/
+    template<typename Distance>
+    void radiusSearch(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+    template<typename Distance>
+    void offsetNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& neighbors,
+        std::vector<rv::Vector3f>& offsets, const Distance& dist) const;
+    template<typename Distance>
+    uint32_t countInRadius(const rv::Point3f& query, float radius, const Distance& dist) const;
+    template<typename Distance>
+    void knnSearch(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& neighbors,
+        const Distance& dist) const;
+
+    /** \brief functors calling the specialized searches with the policy given by rv::dispatchNorm. **/
+    struct RadiusSearch;
+    struct OffsetSearch;
+    struct CountSearch;
+    struct KnnSearch;
+
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    float cellSize_;
+    float invCellSize_;
+
+    // open-addressing hash table with linear probing, which stores indexes of cells_.
+    std::vector<uint32_t> table_;
+    uint32_t tableMask_;
+    std::vector<Cell> cells_;
+    // range of cell coordinates containing points.
+    int32_t min_[3], max_[3];
+
+    // point indexes sorted by cell and the corresponding coordinates stored as structure of arrays.
+    std::vector<uint32_t> indexes_;
+    std::vector<float> x_, y_, z_;
+    // segment of each point (empty, if initialized without segments) and the current restriction.
+    std::vector<uint32_t> segmentIds_;
+    uint32_t segment_;
+
+    // buffers for sorting the points by their cell.
+    std::vector<uint32_t> pointCells_;
+    std::vector<uint32_t> tmpIndexes_;
+    std::vector<float> tmpX_, tmpY_, tmpZ_;
+    std::vector<uint32_t> tmpSegmentIds_;
+};
+
+#endif /* VOXELHASHGRID_H_ */
@@ -1,14 +1,44 @@
 #include "utils.h"
 
+#include <cmath>
 #include <fstream>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/random.hpp>
 #include <rv/IOError.h>
 #include <rv/string_utils.h>
 
 using namespace boost::filesystem;
 using namespace rv;
 
+namespace
+{
+
+/** \brief voxel of a point given by its position in the grouped points. **/
+struct VoxelPoint
+{
+    int32_t x, y, z;
+    uint32_t pos;
+
+    bool operator<(const VoxelPoint& other) const
+    {
+      if (x != other.x) return x < other.x;
+      if (y != other.y) return y < other.y;
+      if (z != other.z) return z < other.z;
+      return pos < other.pos;
+    }
+
+    bool sameVoxel(const VoxelPoint& other) const
+    {
+      return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+}
+
 DirectoryUtil::DirectoryUtil(const std::string& directoryName) :
     currentIndex_(-1)
 {
@@ -85,6 +115,27 @@ std::string DirectoryUtil::getAnnotationFilename(const std::string& dirname) con
   return file.string();
 }
 
+std::string DirectoryUtil::getOctreeFilename(const std::string& dirname, uint32_t bucketSize) const
+{
+  if (currentIndex_ < 0 || currentIndex_ >= scannames_.size()) throw Error("Invalid directory entry.");
+
+  path file(dirname);
+  file /= scannames_[currentIndex_] + "-" + boost::lexical_cast<std::string>(bucketSize) + ".octree";
+  return file.string();
+}
+
+std::string DirectoryUtil::getDescriptorFilename(const std::string& dirname, uint64_t key) const
+{
+  if (currentIndex_ < 0 || currentIndex_ >= scannames_.size()) throw Error("Invalid directory entry.");
+
+  std::stringstream name;
+  name << scannames_[currentIndex_] << "-" << std::hex << std::setw(16) << std::setfill('0') << key << ".desc";
+
+  path file(dirname);
+  file /= name.str();
+  return file.string();
+}
+
 std::vector<std::string> getDirectoryListing(const std::string& dirname)
 {
   std::vector<std::string> filenames;
@@ -424,3 +475,85 @@ float overlap(const IndexedSegment& first, const IndexedSegment& second)
   return float(Intersection) / float(Union);
 }
 
+void groupByVoxels(const std::vector<uint32_t>& indexes, const Laserscan& scan, float voxelSize,
+    std::vector<uint32_t>& order, std::vector<uint32_t>& groups)
+{
+  std::vector<VoxelPoint> voxels(indexes.size());
+  for (uint32_t i = 0; i < indexes.size(); ++i)
+  {
+    const Point3f& p = scan.point(indexes[i]);
+    voxels[i].x = static_cast<int32_t>(std::floor(p.x() / voxelSize));
+    voxels[i].y = static_cast<int32_t>(std::floor(p.y() / voxelSize));
+    voxels[i].z = static_cast<int32_t>(std::floor(p.z() / voxelSize));
+    voxels[i].pos = i;
+  }
+  std::sort(voxels.begin(), voxels.end());
+
+  order.resize(voxels.size());
+  groups.clear();
+  for (uint32_t i = 0; i < voxels.size(); ++i)
+  {
+    if (i == 0 || !voxels[i].sameVoxel(voxels[i - 1])) groups.push_back(i);
+    order[i] = voxels[i].pos;
+  }
+  groups.push_back(voxels.size());
+}
+
+uint64_t hashBytes(uint64_t hash, const void* data, uint32_t size)
+{
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  for (uint32_t b = 0; b < size; ++b)
+    hash = (hash ^ bytes[b]) * 1099511628211ULL;
+
+  return hash;
+}
+
+uint64_t fingerprint(const std::vector<Point3f>& points, const std::vector<IndexedSegment>& segments)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+  {
+    const std::vector<uint32_t>& indexes = segments[s].indexes;
+    const uint32_t size = indexes.size();
+    hash = hashBytes(hash, &size, sizeof(uint32_t));
+    for (uint32_t i = 0; i < size; ++i)
+    {
+      const float coords[3] =
+      { points[indexes[i]].x(), points[indexes[i]].y(), points[indexes[i]].z() };
+      hash = hashBytes(hash, &indexes[i], sizeof(uint32_t));
+      hash = hashBytes(hash, coords, sizeof(coords));
+    }
+  }
+
+  return hash;
+}
+
+uint64_t fingerprint(const ParameterList& params, const std::vector<std::string>& ignored)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (ParameterList::const_iterator it = params.begin(); it != params.end(); ++it)
+  {
+    if (std::find(ignored.begin(), ignored.end(), it->name()) != ignored.end()) continue;
+
+    const std::string str = it->toString();
+    hash = hashBytes(hash, str.c_str(), str.size());
+  }
+
+  return hash;
+}
+
+void randomPoints(std::vector<Point3f>& pts, uint32_t N, uint32_t seed, float offset)
+{
+  boost::mt11213b mtwister(seed);
+  boost::uniform_01<> gen;
+  pts.clear();
+  pts.reserve(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    float x = 10.0f * gen(mtwister) - 5.0f + offset;
+    float y = 10.0f * gen(mtwister) - 5.0f;
+    float z = 10.0f * gen(mtwister) - 5.0f;
+
+    pts.push_back(Point3f(x, y, z));
+  }
+}
@@ -55,6 +55,12 @@ class DirectoryUtil
     /** \brief build next annotation filename with given directory. **/
     std::string getAnnotationFilename(const std::string& dirname) const;
 
+    /** \brief build next octree filename with given directory, which is also keyed by the bucket size. **/
+    std::string getOctreeFilename(const std::string& dirname, uint32_t bucketSize) const;
+
+    /** \brief build next descriptor cache filename with given directory, which is also keyed by the descriptor. **/
+    std::string getDescriptorFilename(const std::string& dirname, uint64_t key) const;
+
     // void getLaserscanFilenames(const std::vector<std::string>& filenames) const;
     // void getSegmentFilenames(const std::vector<std::string>& filenames) const;
     // void getAnnotationFilenames(const std::vector<std::string>& filenames) const;
@@ -113,4 +119,27 @@ void printProgress(uint32_t scan, uint32_t totalScans);
  */
 float overlap(const rv::IndexedSegment& first, const rv::IndexedSegment& second);
 
+/** \brief group the points given by indexes by cubic voxels with side length voxelSize.
+ *
+ *  The positions in indexes are sorted by voxel into order, where voxel v contains the positions
+ *  order[groups[v]], ..., order[groups[v+1]-1]. Inside a voxel, the positions are increasing.
+ */
+void groupByVoxels(const std::vector<uint32_t>& indexes, const rv::Laserscan& scan, float voxelSize,
+    std::vector<uint32_t>& order, std::vector<uint32_t>& groups);
+
+/** \brief update FNV-1a hash with the given bytes. **/
+uint64_t hashBytes(uint64_t hash, const void* data, uint32_t size);
+
+/** \brief fingerprint of the indexed points and their segments. **/
+uint64_t fingerprint(const std::vector<rv::Point3f>& points, const std::vector<rv::IndexedSegment>& segments);
+
+/** \brief fingerprint of the parameters including nested parameters.
+ *
+ *  Parameters on the top level with one of the ignored names are skipped.
+ */
+uint64_t fingerprint(const rv::ParameterList& params, const std::vector<std::string>& ignored);
+
+/** \brief generate N random points in [-5,5] x [-5,5] x [-5,5] shifted by offset along the x-axis. **/
+void randomPoints(std::vector<rv::Point3f>& pts, uint32_t N, uint32_t seed = 0, float offset = 0.0f);
+
 #endif
@@ -3,6 +3,7 @@
 #include <rv/PrimitiveParameters.h>
 #include <rv/string_utils.h>
 #include <rv/PointDescriptor.h>
+#include <rv/Random.h>
 
 #include "test_utils.h"
 #include "../project/utils.h"
@@ -35,6 +36,34 @@ class SimpleDescriptor: public PointDescriptor
     }
 };
 
+/** \brief descriptor of given dimension, which is only used for evaluations with given point descriptors. **/
+class DummyDescriptor: public PointDescriptor
+{
+  public:
+    DummyDescriptor(uint32_t dim) :
+        dim_(dim)
+    {
+    }
+
+    DummyDescriptor* clone() const
+    {
+      return new DummyDescriptor(*this);
+    }
+
+    void evaluate(float* values, const Point3f&, const Normal3f&, const Laserscan&, const NearestNeighborImpl&) const
+    {
+      std::fill(values, values + dim_, 0.0f);
+    }
+
+    uint32_t dim() const
+    {
+      return dim_;
+    }
+
+  protected:
+    uint32_t dim_;
+};
+
 TEST(BagOfWordsTest, Compute)
 {
   // some initialization work:
@@ -76,4 +105,137 @@ TEST(BagOfWordsTest, Compute)
   ASSERT_TRUE(almostEqualVectors(gold_bow, &bow[0], 20));
 }
 
+TEST(BagOfWordsTest, CachedKeypoints)
+{
+  Laserscan scan;
+  Random rand(1234);
+  IndexedSegment segment;
+  for (uint32_t i = 0; i < 500; ++i)
+  {
+    scan.points().push_back(Point3f(4.0f * rand.getFloat(), 4.0f * rand.getFloat(), rand.getFloat()));
+    if (i % 5 != 0) segment.indexes.push_back(i);
+  }
+
+  NaiveNeighborSearch nn;
+  nn.initialize(scan.points());
+  SimpleDescriptor descriptor;
+
+  // descriptors of all points of the segment as stored by DescriptorCache.
+  DescriptorMatrix cached(FORMAT_FLOAT32, 1);
+  float value;
+  Normal3f upvector(0.0f, 0.0f, 1.0f);
+  for (uint32_t i = 0; i < segment.size(); ++i)
+  {
+    descriptor.evaluate(&value, scan.point(segment[i]), upvector, scan, nn);
+    cached.push_back(&value);
+  }
+
+  std::vector<std::vector<float> > vocabulary;
+  for (uint32_t i = 0; i < 100; ++i)
+    vocabulary.push_back(std::vector<float>(1, i));
+
+  // the cached descriptors must give the same histogram as the evaluation of the selected keypoints.
+  const std::string strategies[] = { "random", "voxel-grid", "farthest-point" };
+  for (uint32_t s = 0; s < 3; ++s)
+  {
+    ParameterList params;
+    params.insert(StringParameter("normalizer", "none"));
+    params.insert(StringParameter("keypoints", strategies[s]));
+    params.insert(IntegerParameter("max-descriptors", 40));
+    params.insert(FloatParameter("keypoint-voxel-size", 0.5f));
+    BagOfWordsDescriptor bow(params, descriptor, vocabulary);
+
+    std::vector<float> expected(bow.dim()), values(bow.dim());
+    bow.evaluate(&expected[0], segment, scan, nn);
+    bow.evaluate(&values[0], cached.row(0), FORMAT_FLOAT32, segment, scan);
+
+    float total = 0.0f;
+    for (uint32_t i = 0; i < expected.size(); ++i)
+      total += expected[i];
+    ASSERT_EQ(40.0f, total) << strategies[s];
+    ASSERT_TRUE(almostEqualVectors(&expected[0], &values[0], bow.dim())) << strategies[s];
+  }
+}
+
+TEST(BagOfWordsTest, NearestWords)
+{
+  const uint32_t D = 10, W = 300, N = 1000;
+  Random rand(1234);
+
+  std::vector<std::vector<float> > vocabulary(W, std::vector<float>(D));
+  for (uint32_t j = 0; j < W; ++j)
+    for (uint32_t k = 0; k < D; ++k)
+      vocabulary[j][k] = rand.getGaussianFloat();
+
+  std::vector<float> descriptors(N * D);
+  for (uint32_t i = 0; i < N * D; ++i)
+    descriptors[i] = rand.getGaussianFloat();
+
+  ParameterList params;
+  params.insert(StringParameter("normalizer", "none"));
+  DummyDescriptor descriptor(D);
+  BagOfWordsDescriptor bow(params, descriptor, vocabulary);
+
+  // the blocked assignment must give the same words as the linear search of the nearest words.
+  const DescriptorFormat formats[] = { FORMAT_FLOAT32, FORMAT_FLOAT16, FORMAT_UINT8 };
+  for (uint32_t f = 0; f < 3; ++f)
+  {
+    DescriptorMatrix matrix(formats[f], D);
+    for (uint32_t i = 0; i < N; ++i)
+      matrix.push_back(&descriptors[i * D]);
+
+    std::vector<float> expected(W, 0.0f);
+    for (uint32_t i = 0; i < N; ++i)
+    {
+      uint32_t nearest = 0;
+      for (uint32_t j = 1; j < W; ++j)
+        if (matrix.distanceSqr(i, &vocabulary[j][0]) < matrix.distanceSqr(i, &vocabulary[nearest][0])) nearest = j;
+      expected[nearest] += 1.0f;
+    }
+
+    std::vector<float> values(W);
+    bow.evaluate(&values[0], matrix.row(0), formats[f], N);
+    ASSERT_TRUE(almostEqualVectors(&expected[0], &values[0], W)) << "format " << f;
+  }
+}
+
+TEST(BagOfWordsTest, VocabularyTree)
+{
+  const uint32_t D = 8, N = 2000;
+  Random rand(4711);
+
+  DescriptorMatrix matrix(FORMAT_FLOAT32, D);
+  std::vector<float> x(D);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    for (uint32_t k = 0; k < D; ++k)
+      x[k] = rand.getGaussianFloat();
+    matrix.push_back(&x[0]);
+  }
+
+  VocabularyTree tree;
+  tree.train(matrix, 4, 3);
+  const uint32_t W = tree.words().size();
+  ASSERT_LT(16, W);
+
+  ParameterList params;
+  params.insert(StringParameter("normalizer", "none"));
+  DummyDescriptor descriptor(D);
+  BagOfWordsDescriptor bow(params, descriptor, tree);
+  ASSERT_EQ(W, bow.dim());
+
+  // the histogram bins are the leaves found by the lookup in the tree.
+  std::vector<float> expected(W, 0.0f);
+  for (uint32_t i = 0; i < N; ++i)
+    expected[tree.lookup(&matrix[i][0])] += 1.0f;
+
+  std::vector<float> values(W);
+  bow.evaluate(&values[0], matrix.row(0), FORMAT_FLOAT32, N);
+  ASSERT_TRUE(almostEqualVectors(&expected[0], &values[0], W));
+
+  BagOfWordsDescriptor copy(bow);
+  copy.evaluate(&values[0], matrix.row(0), FORMAT_FLOAT32, N);
+  ASSERT_TRUE(almostEqualVectors(&expected[0], &values[0], W));
+}
+
 }
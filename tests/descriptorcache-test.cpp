@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <rv/Random.h>
+#include <rv/PrimitiveParameters.h>
+#include <rv/CompositeParameter.h>
+
+#include "../project/DescriptorCache.h"
+#include "../project/Octree.h"
+#include "../project/SpinImage.h"
+#include "test_utils.h"
+
+using namespace rv;
+
+namespace
+{
+
+TEST(DescriptorCacheTest, SaveLoad)
+{
+  Laserscan scan;
+  Random rand(4711);
+  for (uint32_t i = 0; i < 3000; ++i)
+    scan.points().push_back(Point3f(4.0f * rand.getFloat() - 2.0f, 4.0f * rand.getFloat() - 2.0f, rand.getFloat()));
+
+  std::vector<IndexedSegment> segments(3);
+  for (uint32_t i = 0; i < scan.points().size(); ++i)
+    segments[i % 3].indexes.push_back(i);
+
+  ParameterList params;
+  params.insert(IntegerParameter("num-bins", 5));
+  params.insert(FloatParameter("radius", 0.5));
+  params.insert(StringParameter("normalizer", "none"));
+  params.insert(IntegerParameter("num-threads", 1));
+  SpinImage si(params);
+
+  // the number of threads and shared neighborhoods with an exact search do not change the key, but all other
+  // parameters.
+  ParameterList search, threads(params), bins(params);
+  threads.insert(IntegerParameter("num-threads", 4));
+  bins.insert(IntegerParameter("num-bins", 4));
+  const uint64_t key = DescriptorCache::key(params, search);
+  ASSERT_EQ(key, DescriptorCache::key(threads, search));
+  ASSERT_NE(key, DescriptorCache::key(bins, search));
+  ParameterList shared(params);
+  shared.insert(FloatParameter("shared-neighborhoods", 0.2));
+  ASSERT_EQ(key, DescriptorCache::key(shared, search));
+  search.insert(FloatParameter("approximation", 0.1));
+  ASSERT_NE(key, DescriptorCache::key(params, search));
+  // with an approximate search, the shared neighborhoods change the descriptors.
+  ASSERT_NE(DescriptorCache::key(params, search), DescriptorCache::key(shared, search));
+
+  Octree nn;
+  nn.initialize(scan.points(), segments);
+
+  DescriptorCache cache;
+  cache.compute(si, key, scan, segments, nn);
+  ASSERT_EQ(si.dim(), cache.dim());
+
+  std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  ASSERT_TRUE(cache.save(filename));
+
+  DescriptorCache loaded;
+  ASSERT_TRUE(loaded.load(filename, key, scan, segments));
+  ASSERT_EQ(si.dim(), loaded.dim());
+
+  ASSERT_EQ(FORMAT_FLOAT32, loaded.format());
+
+  // reduced-precision descriptors are stored with less bytes.
+  DescriptorCache quantized;
+  quantized.compute(si, key, scan, segments, nn, FORMAT_UINT8);
+  ASSERT_EQ(FORMAT_UINT8, quantized.format());
+  ASSERT_EQ(descriptorBytes(FORMAT_UINT8, si.dim()), quantized.rowBytes());
+
+  // descriptors must be the same as descriptors computed with the search restricted to the segment.
+  Normal3f upvector(0.0f, 0.0f, 1.0f);
+  std::vector<float> expected(si.dim()), decoded(si.dim());
+  for (uint32_t s = 0; s < segments.size(); ++s)
+  {
+    nn.setSegment(s);
+    for (uint32_t k = 0; k < segments[s].size(); k += 17)
+    {
+      si.evaluate(&expected[0], scan.point(segments[s][k]), upvector, scan, nn);
+      decodeDescriptor(cache.format(), cache.descriptors(s) + k * cache.rowBytes(), si.dim(), &decoded[0]);
+      ASSERT_TRUE(almostEqualVectors(&expected[0], &decoded[0], si.dim()));
+      decodeDescriptor(loaded.format(), loaded.descriptors(s) + k * loaded.rowBytes(), si.dim(), &decoded[0]);
+      ASSERT_TRUE(almostEqualVectors(&expected[0], &decoded[0], si.dim()));
+
+      // histogram counts are quantized with at most half a step of the range of the histogram.
+      decodeDescriptor(quantized.format(), quantized.descriptors(s) + k * quantized.rowBytes(), si.dim(),
+          &decoded[0]);
+      const float range = *std::max_element(expected.begin(), expected.end())
+          - *std::min_element(expected.begin(), expected.end());
+      for (uint32_t i = 0; i < si.dim(); ++i)
+        ASSERT_NEAR(expected[i], decoded[i], 0.5f * range / 255.0f + 1e-4f);
+    }
+  }
+
+  // different key, points, or segments.
+  ASSERT_FALSE(loaded.load(filename, key + 1, scan, segments));
+  scan.points()[10] = Point3f(1.0f, 2.0f, 3.0f);
+  ASSERT_FALSE(loaded.load(filename, key, scan, segments));
+  segments.pop_back();
+  ASSERT_FALSE(loaded.load(filename, key, scan, segments));
+  ASSERT_FALSE(loaded.load(filename + ".missing", key, scan, segments));
+
+  boost::filesystem::remove(filename);
+}
+
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <rv/Random.h>
+#include <rv/Error.h>
+
+#include "../project/DescriptorFormat.h"
+
+using namespace rv;
+
+namespace
+{
+
+std::vector<float> generateDescriptor(Random& rand, uint32_t D)
+{
+  std::vector<float> values(D);
+  for (uint32_t i = 0; i < D; ++i)
+    values[i] = rand.getFloat();
+
+  return values;
+}
+
+TEST(DescriptorFormatTest, HalfConversion)
+{
+  // exactly representable values.
+  const float exact[] = { 0.0f, 1.0f, -2.5f, 0.099975586f, 65504.0f, 6.1035156e-05f, 5.9604645e-08f };
+  for (uint32_t i = 0; i < 7; ++i)
+    ASSERT_EQ(exact[i], halfToFloat(floatToHalf(exact[i])));
+
+  ASSERT_EQ(0x3C00, floatToHalf(1.0f));
+  ASSERT_EQ(0x7C00, floatToHalf(1e6f));
+  ASSERT_EQ(0x0000, floatToHalf(1e-9f));
+  const float infinity = std::numeric_limits<float>::infinity();
+  ASSERT_EQ(infinity, halfToFloat(floatToHalf(infinity)));
+  ASSERT_EQ(-infinity, halfToFloat(floatToHalf(-infinity)));
+  const float nan = halfToFloat(floatToHalf(std::numeric_limits<float>::quiet_NaN()));
+  ASSERT_NE(nan, nan);
+
+  // ties are rounded to even: 1 + 2^-11 lies between 1 and 1 + 2^-10.
+  ASSERT_EQ(0x3C00, floatToHalf(1.0f + std::pow(2.0f, -11)));
+  ASSERT_EQ(0x3C02, floatToHalf(1.0f + 3.0f * std::pow(2.0f, -11)));
+
+  Random rand(1234);
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    const float value = 100.0f * rand.getFloat() - 50.0f;
+    ASSERT_LE(std::abs(halfToFloat(floatToHalf(value)) - value), std::abs(value) * std::pow(2.0f, -11));
+  }
+}
+
+TEST(DescriptorFormatTest, Encoding)
+{
+  const uint32_t D = 25;
+  Random rand(4711);
+
+  ASSERT_EQ(FORMAT_FLOAT16, parseDescriptorFormat("float16"));
+  ASSERT_THROW(parseDescriptorFormat("float64"), rv::Error);
+
+  ASSERT_EQ(4 * D, descriptorBytes(FORMAT_FLOAT32, D));
+  ASSERT_EQ(2 * D, descriptorBytes(FORMAT_FLOAT16, D));
+  ASSERT_EQ(8 + D, descriptorBytes(FORMAT_UINT8, D));
+
+  const DescriptorFormat formats[] = { FORMAT_FLOAT32, FORMAT_FLOAT16, FORMAT_UINT8 };
+  // maximal error of a value in [0,1]: none, half of the last mantissa bit, half of the quantization step.
+  const float tolerance[] = { 0.0f, std::pow(2.0f, -11), 0.5f / 255.0f + 1e-6f };
+
+  for (uint32_t f = 0; f < 3; ++f)
+  {
+    DescriptorMatrix matrix(formats[f], D);
+    std::vector<std::vector<float> > data;
+    for (uint32_t i = 0; i < 20; ++i)
+    {
+      data.push_back(generateDescriptor(rand, D));
+      matrix.push_back(&data.back()[0]);
+    }
+    ASSERT_EQ(data.size(), matrix.size());
+    ASSERT_EQ(descriptorBytes(formats[f], D), matrix.rowBytes());
+
+    std::vector<float> word = generateDescriptor(rand, D);
+    for (uint32_t i = 0; i < data.size(); ++i)
+    {
+      std::vector<float> decoded = matrix[i];
+      for (uint32_t j = 0; j < D; ++j)
+        ASSERT_LE(std::abs(decoded[j] - data[i][j]), tolerance[f]);
+
+      // distances are computed directly on the encoded rows, but must agree with the decoded values.
+      float expected = 0.0f;
+      for (uint32_t j = 0; j < D; ++j)
+        expected += (decoded[j] - word[j]) * (decoded[j] - word[j]);
+      ASSERT_NEAR(expected, matrix.distanceSqr(i, &word[0]), 1e-4);
+
+      std::vector<float> sum(D, 1.0f);
+      matrix.add(i, &sum[0]);
+      for (uint32_t j = 0; j < D; ++j)
+        ASSERT_NEAR(1.0f + decoded[j], sum[j], 1e-6);
+    }
+  }
+
+  // constant descriptors have no range, but must be decoded exactly.
+  std::vector<float> constant(D, 0.25f), decoded(D);
+  std::vector<uint8_t> row(descriptorBytes(FORMAT_UINT8, D));
+  encodeDescriptor(FORMAT_UINT8, &constant[0], D, &row[0]);
+  decodeDescriptor(FORMAT_UINT8, &row[0], D, &decoded[0]);
+  for (uint32_t j = 0; j < D; ++j)
+    ASSERT_EQ(0.25f, decoded[j]);
+}
+
+}
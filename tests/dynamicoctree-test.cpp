@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <rv/geometry.h>
+#include <rv/norms.h>
+#include <rv/Error.h>
+
+#include "../project/DynamicOctree.h"
+#include "../project/utils.h"
+#include "test_utils.h"
+
+using namespace rv;
+
+namespace
+{
+
+// The fixture for testing the dynamic octree and getting access to "private parts".
+class DynamicOctreeTest: public ::testing::Test
+{
+  protected:
+    typedef DynamicOctree::Octant Octant;
+
+    /** \brief check sizes, bounding boxes, and bucket sizes of all octants. **/
+    void checkConsistency(const DynamicOctree& oct, uint32_t octant)
+    {
+      const Octant& o = oct.octants_[octant];
+      if (o.isLeaf)
+      {
+        ASSERT_EQ(o.size, o.points.size());
+        for (uint32_t i = 0; i < o.points.size(); ++i)
+        {
+          ASSERT_LE(std::abs(o.points[i].x - o.x), o.extent);
+          ASSERT_LE(std::abs(o.points[i].y - o.y), o.extent);
+          ASSERT_LE(std::abs(o.points[i].z - o.z), o.extent);
+        }
+        return;
+      }
+
+      ASSERT_EQ(0, o.points.size());
+      // octants with too few points are merged.
+      ASSERT_GE(2 * o.size, oct.bucketSize_);
+
+      uint32_t size = 0;
+      for (uint32_t c = 0; c < 8; ++c)
+      {
+        if (o.children[c] == DynamicOctree::EMPTY) continue;
+        const Octant& child = oct.octants_[o.children[c]];
+        ASSERT_GT(child.size, 0);
+        ASSERT_FLOAT_EQ(0.5f * o.extent, child.extent);
+        size += child.size;
+        checkConsistency(oct, o.children[c]);
+      }
+      ASSERT_EQ(o.size, size);
+    }
+
+    void checkConsistency(const DynamicOctree& oct)
+    {
+      if (oct.root_ == DynamicOctree::EMPTY) return;
+      checkConsistency(oct, oct.root_);
+    }
+};
+
+/** \brief brute force search among the points, which are currently inserted. **/
+void bruteforce(const std::vector<Point3f>& points, const std::vector<bool>& inserted, const Point3f& query,
+    float radius, const Norm& norm, std::vector<uint32_t>& neighbors)
+{
+  neighbors.clear();
+  for (uint32_t i = 0; i < points.size(); ++i)
+    if (inserted[i] && norm.compute(query, points[i]) <= radius) neighbors.push_back(i);
+}
+
+TEST_F(DynamicOctreeTest, InsertRemove)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 4000, 2015, 0.0f);
+
+  DynamicOctree octree(16, 0.5f);
+  std::vector<bool> inserted(points.size(), false);
+  for (uint32_t i = 0; i < points.size(); ++i)
+  {
+    octree.insert(points[i], i);
+    inserted[i] = true;
+  }
+  ASSERT_EQ(points.size(), octree.size());
+  checkConsistency(octree);
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  const Norm* norms[2] =
+  { &euclidean, &maximum };
+  const Norm& norm = euclidean;
+
+  std::vector<uint32_t> expected, result;
+  for (uint32_t n = 0; n < 2; ++n)
+  {
+    for (uint32_t i = 0; i < points.size(); i += 40)
+    {
+      octree.radiusNeighbors(points[i], 0.7f, result, *norms[n]);
+      bruteforce(points, inserted, points[i], 0.7f, *norms[n], expected);
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+    }
+  }
+
+  // removal of every other point and points, which are not in the octree.
+  for (uint32_t i = 0; i < points.size(); i += 2)
+  {
+    ASSERT_TRUE(octree.remove(points[i], i));
+    inserted[i] = false;
+  }
+  ASSERT_FALSE(octree.remove(points[0], 0));
+  ASSERT_FALSE(octree.remove(Point3f(100.0f, 0.0f, 0.0f), 1));
+  ASSERT_EQ(points.size() / 2, octree.size());
+  checkConsistency(octree);
+
+  for (uint32_t i = 0; i < points.size(); i += 40)
+  {
+    octree.radiusNeighbors(points[i], 0.7f, result, euclidean);
+    bruteforce(points, inserted, points[i], 0.7f, euclidean, expected);
+    std::sort(result.begin(), result.end());
+    ASSERT_EQ(expected, result);
+
+    octree.knnNeighbors(points[i], 10, result, euclidean);
+    ASSERT_EQ(10, result.size());
+    for (uint32_t k = 0; k < result.size(); ++k)
+    {
+      ASSERT_TRUE(inserted[result[k]]);
+      if (k > 0)
+      {
+        ASSERT_LE(norm.compute(points[i], points[result[k - 1]]), norm.compute(points[i], points[result[k]]));
+      }
+    }
+  }
+
+  // removing everything merges all octants into the root.
+  for (uint32_t i = 1; i < points.size(); i += 2)
+    ASSERT_TRUE(octree.remove(points[i], i));
+  ASSERT_EQ(0, octree.size());
+  checkConsistency(octree);
+  octree.radiusNeighbors(points[0], 100.0f, result, euclidean);
+  ASSERT_EQ(0, result.size());
+}
+
+TEST_F(DynamicOctreeTest, SlidingWindow)
+{
+  // every "scan" is shifted along the x-axis, such that the root must be enlarged.
+  const uint32_t numScans = 8, windowSize = 3, scanSize = 1000;
+  std::vector<Point3f> points;
+  for (uint32_t s = 0; s < numScans; ++s)
+  {
+    std::vector<Point3f> scan;
+    randomPoints(scan, scanSize, 100 + s, 4.0f * s);
+    points.insert(points.end(), scan.begin(), scan.end());
+  }
+
+  DynamicOctree octree(8);
+  std::vector<bool> inserted(points.size(), false);
+  EuclideanNorm norm;
+  std::vector<uint32_t> expected, result;
+  std::vector<Vector3f> offsets;
+
+  for (uint32_t s = 0; s < numScans; ++s)
+  {
+    for (uint32_t i = s * scanSize; i < (s + 1) * scanSize; ++i)
+    {
+      octree.insert(points[i], i);
+      inserted[i] = true;
+    }
+
+    if (s >= windowSize)
+    {
+      for (uint32_t i = (s - windowSize) * scanSize; i < (s - windowSize + 1) * scanSize; ++i)
+      {
+        ASSERT_TRUE(octree.remove(points[i], i));
+        inserted[i] = false;
+      }
+    }
+
+    checkConsistency(octree);
+
+    for (uint32_t i = s * scanSize; i < (s + 1) * scanSize; i += 50)
+    {
+      octree.radiusNeighbors(points[i], 1.0f, result, offsets, norm);
+      ASSERT_EQ(result.size(), offsets.size());
+      for (uint32_t j = 0; j < result.size(); ++j)
+        ASSERT_NEAR(points[result[j]].x() - points[i].x(), offsets[j].x(), 0.0001);
+
+      bruteforce(points, inserted, points[i], 1.0f, norm, expected);
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+    }
+  }
+}
+
+TEST_F(DynamicOctreeTest, MaximalExtent)
+{
+  DynamicOctree octree(8, 1.0f);
+  octree.insert(Point3f(0.0f, 0.0f, 0.0f), 0);
+
+  // the root is enlarged at most until its depth bounds the stack of the search.
+  octree.insert(Point3f(1e6f, 0.0f, 0.0f), 1);
+  ASSERT_THROW(octree.insert(Point3f(1e30f, 0.0f, 0.0f), 2), Error);
+
+  std::vector<uint32_t> result;
+  octree.radiusNeighbors(Point3f(1e6f, 0.0f, 0.0f), 1.0f, result, MaximumNorm());
+  ASSERT_EQ(std::vector<uint32_t>(1, 1), result);
+}
+
+}
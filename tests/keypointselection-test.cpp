@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <cmath>
+#include <rv/Random.h>
+#include <rv/PrimitiveParameters.h>
+#include <rv/Laserscan.h>
+
+#include "../project/KeypointSelection.h"
+
+using namespace rv;
+
+namespace
+{
+
+/** \brief two clusters of points at x = 0 and x = 10, where the first cluster contains most of the points. **/
+void generateSegment(Laserscan& scan, IndexedSegment& segment)
+{
+  Random rand(1234);
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    const float offset = (i % 10 == 0) ? 10.0f : 0.0f;
+    scan.points().push_back(Point3f(offset + rand.getFloat(), rand.getFloat(), rand.getFloat()));
+    segment.indexes.push_back(i);
+  }
+}
+
+ParameterList parameters(const std::string& strategy, uint32_t maxDescriptors)
+{
+  ParameterList params;
+  params.insert(StringParameter("keypoints", strategy));
+  params.insert(IntegerParameter("max-descriptors", maxDescriptors));
+  params.insert(FloatParameter("keypoint-voxel-size", 0.5f));
+
+  return params;
+}
+
+void checkPositions(const std::vector<uint32_t>& positions, uint32_t N)
+{
+  std::set<uint32_t> unique(positions.begin(), positions.end());
+  ASSERT_EQ(positions.size(), unique.size());
+  for (uint32_t i = 0; i < positions.size(); ++i)
+  {
+    ASSERT_LT(positions[i], N);
+    if (i > 0)
+    {
+      ASSERT_LT(positions[i - 1], positions[i]);
+    }
+  }
+}
+
+TEST(KeypointSelectionTest, Strategies)
+{
+  Laserscan scan;
+  IndexedSegment segment;
+  generateSegment(scan, segment);
+  const uint32_t N = segment.size();
+
+  std::vector<uint32_t> positions, again;
+
+  KeypointSelection all(parameters("all", 50));
+  ASSERT_TRUE(all.selectsAll());
+  all.select(segment, scan, positions);
+  ASSERT_EQ(N, positions.size());
+
+  // random sampling respects the budget and gives the same points for the same segment.
+  KeypointSelection random(parameters("random", 50));
+  ASSERT_FALSE(random.selectsAll());
+  random.select(segment, scan, positions);
+  ASSERT_EQ(50, positions.size());
+  ASSERT_NO_FATAL_FAILURE(checkPositions(positions, N));
+  random.select(segment, scan, again);
+  ASSERT_TRUE(positions == again);
+
+  // every occupied voxel (2 * 2 * 2 voxels per cluster) is represented by one point.
+  KeypointSelection voxels(parameters("voxel-grid", 0));
+  ASSERT_FALSE(voxels.selectsAll());
+  voxels.select(segment, scan, positions);
+  ASSERT_EQ(16, positions.size());
+  ASSERT_NO_FATAL_FAILURE(checkPositions(positions, N));
+
+  KeypointSelection cappedVoxels(parameters("voxel-grid", 5));
+  cappedVoxels.select(segment, scan, positions);
+  ASSERT_EQ(5, positions.size());
+  ASSERT_NO_FATAL_FAILURE(checkPositions(positions, N));
+
+  // the second cluster is far away, thus it must be selected, although it contains only few points.
+  KeypointSelection farthest(parameters("farthest-point", 20));
+  farthest.select(segment, scan, positions);
+  ASSERT_EQ(20, positions.size());
+  ASSERT_NO_FATAL_FAILURE(checkPositions(positions, N));
+  bool secondCluster = false;
+  for (uint32_t i = 0; i < positions.size(); ++i)
+    secondCluster |= (scan.point(segment[positions[i]]).x() > 5.0f);
+  ASSERT_TRUE(secondCluster);
+
+  // small segments are not subsampled.
+  IndexedSegment small;
+  for (uint32_t i = 0; i < 10; ++i)
+    small.indexes.push_back(i);
+  farthest.select(small, scan, positions);
+  ASSERT_EQ(10, positions.size());
+
+  // a segment with only 3 distinct positions gives no duplicate positions.
+  Laserscan duplicates;
+  IndexedSegment repeated;
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    duplicates.points().push_back(Point3f(i % 3, 0.0f, 0.0f));
+    repeated.indexes.push_back(i);
+  }
+  farthest.select(repeated, duplicates, positions);
+  ASSERT_EQ(3, positions.size());
+  ASSERT_NO_FATAL_FAILURE(checkPositions(positions, repeated.size()));
+}
+
+}
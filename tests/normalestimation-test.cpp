@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <rv/Random.h>
+#include <rv/PrimitiveParameters.h>
+#include <rv/Laserscan.h>
+
+#include "../project/NormalEstimation.h"
+#include "../project/Octree.h"
+
+using namespace rv;
+
+namespace
+{
+
+TEST(NormalEstimationTest, CovarianceSums)
+{
+  Random rand(1234);
+  const uint32_t N = 37;
+  std::vector<float> x(N), y(N), z(N);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    x[i] = rand.getFloat() - 0.5f;
+    y[i] = rand.getFloat() - 0.5f;
+    z[i] = rand.getFloat() - 0.5f;
+  }
+
+  // every length, such that full vectors and remaining offsets are tested.
+  for (uint32_t n = 0; n <= N; ++n)
+  {
+    float expected[9], sums[9];
+    covarianceSumsScalar(&x[0], &y[0], &z[0], n, expected);
+    covarianceSums(&x[0], &y[0], &z[0], n, sums);
+    for (uint32_t i = 0; i < 9; ++i)
+      ASSERT_NEAR(expected[i], sums[i], 1e-5) << "sum " << i << " of " << n << " offsets.";
+  }
+}
+
+TEST(NormalEstimationTest, SmallestEigenvector)
+{
+  // diagonal matrices.
+  const float diagonal[6] = { 3.0f, 0.0f, 0.0f, 1.0f, 0.0f, 2.0f };
+  Normal3f n = smallestEigenvector(diagonal);
+  ASSERT_NEAR(1.0f, std::abs(n.y()), 1e-5);
+
+  // covariance of points in the plane spanned by (1, 1, 0) and (0, 0, 1) with eigenvalues 4, 1, and 0.1.
+  const float s = 0.5f * std::sqrt(2.0f);
+  const float u[3] = { s, s, 0.0f }, v[3] = { 0.0f, 0.0f, 1.0f }, w[3] = { s, -s, 0.0f };
+  float covariance[6];
+  const uint32_t idx[6][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 1, 1 }, { 1, 2 }, { 2, 2 } };
+  for (uint32_t i = 0; i < 6; ++i)
+  {
+    const uint32_t r = idx[i][0], c = idx[i][1];
+    covariance[i] = 4.0f * u[r] * u[c] + 1.0f * v[r] * v[c] + 0.1f * w[r] * w[c];
+  }
+  n = smallestEigenvector(covariance);
+  ASSERT_NEAR(1.0f, std::abs(n.x() * w[0] + n.y() * w[1] + n.z() * w[2]), 1e-4);
+
+  // points on a line have a double smallest eigenvalue, thus the normal must be orthogonal to the line.
+  for (uint32_t i = 0; i < 6; ++i)
+    covariance[i] = u[idx[i][0]] * u[idx[i][1]];
+  n = smallestEigenvector(covariance);
+  ASSERT_NEAR(0.0f, n.x() * u[0] + n.y() * u[1] + n.z() * u[2], 1e-4);
+  ASSERT_NEAR(1.0f, std::sqrt(n.LengthSquared()), 1e-5);
+}
+
+TEST(NormalEstimationTest, Estimate)
+{
+  // points on the plane z = 0.5 * x + 2 above the sensor at the origin.
+  Laserscan scan;
+  Random rand(4711);
+  for (uint32_t i = 0; i < 2000; ++i)
+  {
+    const float x = 4.0f * rand.getFloat() - 2.0f, y = 4.0f * rand.getFloat() - 2.0f;
+    scan.points().push_back(Point3f(x, y, 0.5f * x + 2.0f));
+  }
+
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < scan.points().size(); i += 2)
+  {
+    segments[0].indexes.push_back(i);
+    segments[1].indexes.push_back(i + 1);
+  }
+
+  Octree nn;
+  nn.initialize(scan.points());
+
+  const float length = std::sqrt(1.25f);
+  const Normal3f expected(0.5f / length, 0.0f, -1.0f / length);
+
+  for (uint32_t numThreads = 1; numThreads <= 4; numThreads += 3)
+  {
+    ParameterList params;
+    params.insert(FloatParameter("normal-radius", 0.3f));
+    params.insert(IntegerParameter("num-threads", numThreads));
+    NormalEstimation estimation(params);
+
+    estimation.estimate(scan, segments, nn);
+    ASSERT_TRUE(scan.hasNormals());
+
+    // normals must be oriented towards the sensor.
+    for (uint32_t i = 0; i < scan.points().size(); ++i)
+    {
+      const Normal3f& n = scan.normal(i);
+      ASSERT_NEAR(expected.x(), n.x(), 1e-3) << "point " << i << " with " << numThreads << " threads.";
+      ASSERT_NEAR(expected.y(), n.y(), 1e-3) << "point " << i << " with " << numThreads << " threads.";
+      ASSERT_NEAR(expected.z(), n.z(), 1e-3) << "point " << i << " with " << numThreads << " threads.";
+    }
+  }
+}
+
+}
@@ -1,12 +1,19 @@
 #include <string>
 #include <map>
 #include <queue>
+#include <cmath>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <boost/random.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <rv/Error.h>
 #include <rv/geometry.h>
 #include <rv/norms.h>
 
 #include "../project/Octree.h"
+#include "../project/utils.h"
 #include "test_utils.h"
 
 using namespace rv;
@@ -23,31 +30,36 @@ class OctreeTest: public ::testing::Test
     // helper methods to access the protected parts of octree for consistency checks.
     const Octree::Octant* getRoot(const Octree& oct)
     {
-      return oct.root_;
+      if (oct.octants_.empty()) return 0;
+      return &oct.octants_[0];
     }
 
-    const std::vector<uint32_t>& getSuccessors(const Octree& oct)
+    // children are stored adjacent in the octant array.
+    const Octree::Octant* getChild(const Octree& oct, const Octant* octant, uint32_t i)
     {
-      return oct.successors_;
+      return &oct.octants_[octant->child + i];
     }
-};
 
-void randomPoints(std::vector<Point3f>& pts, uint32_t N, uint32_t seed = 0)
-{
-  boost::mt11213b mtwister(seed);
-  boost::uniform_01<> gen;
-  pts.clear();
-  pts.reserve(N);
-  // generate N random points in [-5.0,5.0] x [-5.0,5.0] x [-5.0,5.0]...
-  for (uint32_t i = 0; i < N; ++i)
-  {
-    float x = 10.0f * gen(mtwister) - 5.0f;
-    float y = 10.0f * gen(mtwister) - 5.0f;
-    float z = 10.0f * gen(mtwister) - 5.0f;
+    const std::vector<uint32_t>& getIndexes(const Octree& oct)
+    {
+      return oct.indexes_;
+    }
 
-    pts.push_back(Point3f(x, y, z));
-  }
-}
+    Point3f getPoint(const Octree& oct, uint32_t i)
+    {
+      return Point3f(oct.x_[i], oct.y_[i], oct.z_[i]);
+    }
+
+    const std::vector<Octant>& getOctants(const Octree& oct)
+    {
+      return oct.octants_;
+    }
+
+    const std::vector<uint32_t>& getSegmentIds(const Octree& oct)
+    {
+      return oct.segmentIds_;
+    }
+};
 
 TEST_F(OctreeTest, Initialize)
 {
@@ -60,7 +72,7 @@ TEST_F(OctreeTest, Initialize)
   Octree oct(bucketSize);
 
   const Octant* root = getRoot(oct);
-  const std::vector<uint32_t>& successors = getSuccessors(oct);
+  const std::vector<uint32_t>& indexes = getIndexes(oct);
 
   ASSERT_EQ(0, root);
 
@@ -74,17 +86,22 @@ TEST_F(OctreeTest, Initialize)
 
   // check first some pre-requisits.
   ASSERT_EQ(true, (root != 0))<< "root should be initialized.";
-  ASSERT_EQ(N, successors.size())<< "successors should be of size " << N;
+  ASSERT_EQ(N, indexes.size())<< "indexes should be of size " << N;
+  ASSERT_EQ(0, root->start);
+  ASSERT_EQ(N, root->end);
 
+  // indexes should be a permutation and the points should be copied accordingly.
   std::vector<uint32_t> elementCount(N, 0);
-  uint32_t idx = root->start;
   for (uint32_t i = 0; i < N; ++i)
   {
+    uint32_t idx = indexes[i];
     ASSERT_LT(idx, N);
-    ASSERT_LE(successors[idx], N);
     elementCount[idx] += 1;
-    ASSERT_EQ(1, elementCount[idx])<< "point "<< i << " found twice in successors.";
-    idx = successors[idx];
+    ASSERT_EQ(1, elementCount[idx])<< "point "<< idx << " found twice in indexes.";
+    Point3f p = getPoint(oct, i);
+    ASSERT_EQ(points[idx].x(), p.x());
+    ASSERT_EQ(points[idx].y(), p.y());
+    ASSERT_EQ(points[idx].z(), p.z());
   }
 
   // check that each index was found.
@@ -96,7 +113,6 @@ TEST_F(OctreeTest, Initialize)
   // test if each Octant contains only points inside the octant and child octants have only real subsets of parents!
   std::queue<const Octant*> queue;
   queue.push(root);
-  std::vector<int32_t> assignment(N, -1);
 
   while (!queue.empty())
   {
@@ -104,60 +120,58 @@ TEST_F(OctreeTest, Initialize)
     queue.pop();
 
     // check points.
-    ASSERT_LT(octant->start, N);
+    ASSERT_LT(octant->start, octant->end);
+    ASSERT_LE(octant->end, N);
+    ASSERT_EQ(octant->end - octant->start, octant->size);
 
     // test if each point assigned to a octant really is inside the octant.
-
-    uint32_t idx = octant->start;
-    uint32_t lastIdx = octant->start;
-    for (uint32_t i = 0; i < octant->size; ++i)
+    for (uint32_t i = octant->start; i < octant->end; ++i)
     {
-      float x = points[idx].x() - octant->x;
-      float y = points[idx].y() - octant->y;
-      float z = points[idx].z() - octant->z;
+      const Point3f& p = points[indexes[i]];
+      float x = p.x() - octant->x;
+      float y = p.y() - octant->y;
+      float z = p.z() - octant->z;
 
       ASSERT_LE(std::abs(x), octant->extent);
       ASSERT_LE(std::abs(y), octant->extent);
       ASSERT_LE(std::abs(z), octant->extent);
-      assignment[idx] = -1; // reset of child assignments.
-      lastIdx = idx;
-      idx = successors[idx];
     }
-    ASSERT_EQ(octant->end, lastIdx);
 
     bool shouldBeLeaf = true;
-    Octant* firstchild = 0;
-    Octant* lastchild = 0;
+    const Octant* firstchild = 0;
+    const Octant* lastchild = 0;
     uint32_t pointSum = 0;
 
-    for (uint32_t c = 0; c < 8; ++c)
+    ASSERT_LE(octant->numChildren, 8);
+    for (uint32_t c = 0; c < octant->numChildren; ++c)
     {
-      Octant* child = octant->child[c];
-      if (child == 0) continue;
+      const Octant* child = getChild(oct, octant, c);
+      ASSERT_GT(child->size, 0);
       shouldBeLeaf = false;
 
       // child nodes should have start end intervals, which are true subsets of the parent.
       if (firstchild == 0) firstchild = child;
-      // the child nodes should have intervals, where succ(e_{c-1}) == s_{c}, and \sum_c size(c) = parent size!
-      if (lastchild != 0) ASSERT_EQ(child->start, successors[lastchild->end]);
+      // the child nodes should have consecutive intervals, i.e., e_{c-1} == s_{c}, and \sum_c size(c) = parent size!
+      if (lastchild != 0)
+      {
+        ASSERT_EQ(child->start, lastchild->end);
+      }
 
       pointSum += child->size;
       lastchild = child;
-      uint32_t idx = child->start;
-      for (uint32_t i = 0; i < child->size; ++i)
-      {
-        // check if points are uniquely assigned to single child octant.
-        ASSERT_EQ(-1, assignment[idx]);
-        assignment[idx] = c;
-        idx = successors[idx];
-      }
 
       queue.push(child);
     }
 
     // consistent start/end of octant and its first and last children.
-    if (firstchild != 0) ASSERT_EQ(octant->start, firstchild->start);
-    if (lastchild != 0) ASSERT_EQ(octant->end, lastchild->end);
+    if (firstchild != 0)
+    {
+      ASSERT_EQ(octant->start, firstchild->start);
+    }
+    if (lastchild != 0)
+    {
+      ASSERT_EQ(octant->end, lastchild->end);
+    }
 
     // check leafs flag.
     ASSERT_EQ(shouldBeLeaf, octant->isLeaf);
@@ -167,12 +181,6 @@ TEST_F(OctreeTest, Initialize)
     if (!octant->isLeaf)
     {
       ASSERT_EQ(octant->size, pointSum);
-      uint32_t idx = octant->start;
-      for (uint32_t i = 0; i < octant->size; ++i)
-      {
-        ASSERT_GT(assignment[idx], -1);
-        idx = successors[idx];
-      }
     }
   }
 }
@@ -192,12 +200,13 @@ TEST_F(OctreeTest, InitializeSubset)
   std::random_shuffle(indexes.begin(), indexes.end());
   indexes.resize(100);
 
-  Octree oct(32);
-  oct.initialize(points, indexes);
+  Octree octree(32);
+  octree.initialize(points, indexes);
 
-  const Octant* root = getRoot(oct);
+  const Octant* root = getRoot(octree);
   ASSERT_FALSE(root == 0);
-  const std::vector<uint32_t>& successors = getSuccessors(oct);
+  const std::vector<uint32_t>& octIndexes = getIndexes(octree);
+  ASSERT_EQ(indexes.size(), octIndexes.size());
 
   std::vector<uint32_t> elementCount(N, 0);
   std::vector<bool> inIndexes(N, false);
@@ -212,28 +221,23 @@ TEST_F(OctreeTest, InitializeSubset)
     const Octant* oct = queue.front();
     queue.pop();
 
-    uint32_t idx = oct->start;
-    for (;; idx = successors[idx])
+    for (uint32_t i = oct->start; i < oct->end; ++i)
     {
-      ASSERT_TRUE(inIndexes[idx])<< "point with index " << idx << " should be not inside octree.";
-      if(idx == oct->end) break;
+      ASSERT_TRUE(inIndexes[octIndexes[i]])<< "point with index " << octIndexes[i] << " should be not inside octree.";
     }
 
     if (oct->isLeaf)
     {
-      idx = oct->start;
-      for (;; idx = successors[idx])
+      for (uint32_t i = oct->start; i < oct->end; ++i)
       {
+        uint32_t idx = octIndexes[i];
         ASSERT_EQ(0, elementCount[idx])<< "point with index " << idx << " twice in leafs.";
         elementCount[idx] += 1;
-        if(idx == oct->end) break;
       }
     }
 
-    for (uint32_t i = 0; i < 8; ++i)
-    {
-      if (oct->child[i] != 0) queue.push(oct->child[i]);
-    }
+    for (uint32_t i = 0; i < oct->numChildren; ++i)
+      queue.push(getChild(octree, oct, i));
   }
 
   for (uint32_t i = 0; i < indexes.size(); ++i)
@@ -323,4 +327,633 @@ TEST_F(OctreeTest, RadiusNeighbors)
   }
 }
 
+TEST_F(OctreeTest, Reinitialize)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 1000, 4711);
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < points.size(); i += 3)
+    indexes.push_back(i);
+
+  // reusing an octree must give the same result as a freshly initialized octree.
+  Octree reused(16);
+  reused.initialize(points);
+  reused.initialize(points, indexes);
+
+  Octree fresh(16);
+  fresh.initialize(points, indexes);
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    std::vector<uint32_t> neighborsReused;
+    std::vector<uint32_t> neighborsFresh;
+
+    reused.radiusNeighbors(points[i * 97], 1.5f, neighborsReused, EuclideanNorm());
+    fresh.radiusNeighbors(points[i * 97], 1.5f, neighborsFresh, EuclideanNorm());
+
+    ASSERT_EQ(neighborsFresh, neighborsReused);
+  }
+}
+
+TEST_F(OctreeTest, ClearKeepsCapacity)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 2000, 1234);
+
+  Octree octree(16);
+  octree.initialize(points);
+  const uint32_t numOctants = getOctants(octree).size();
+  const Octant* octants = &getOctants(octree)[0];
+
+  // clearing and rebuilding must reuse the octants without any reallocation.
+  octree.clear();
+  ASSERT_EQ(0, getOctants(octree).size());
+  ASSERT_GE(getOctants(octree).capacity(), numOctants);
+
+  octree.initialize(points);
+  ASSERT_EQ(numOctants, getOctants(octree).size());
+  ASSERT_EQ(octants, &getOctants(octree)[0]);
+}
+
+TEST_F(OctreeTest, RadiusNeighborsSegment)
+{
+  uint32_t N = 2000;
+  uint32_t S = 5;
+
+  std::vector<Point3f> points;
+  randomPoints(points, N, 815);
+
+  // random assignment of points to segments; points with s == S are not part of any segment.
+  boost::mt11213b mtwister(815);
+  boost::uniform_int<> uni_segment(0, S);
+  std::vector<IndexedSegment> segments(S);
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    uint32_t s = uni_segment(mtwister);
+    if (s < S) segments[s].indexes.push_back(i);
+  }
+
+  Octree octree(16);
+  octree.initialize(points, segments);
+
+  float radii[3] =
+  { 0.5, 1.0, 3.0 };
+
+  for (uint32_t s = 0; s < S; ++s)
+  {
+    Octree segmentOctree(16);
+    segmentOctree.initialize(points, segments[s].indexes);
+
+    octree.setSegment(s);
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+      for (uint32_t i = 0; i < 10; ++i)
+      {
+        std::vector<uint32_t> neighbors;
+        std::vector<uint32_t> neighborsSegment;
+        const Point3f& query = points[(s * 10 + i) * 37];
+
+        octree.radiusNeighbors(query, radii[r], neighbors, EuclideanNorm());
+        segmentOctree.radiusNeighbors(query, radii[r], neighborsSegment, EuclideanNorm());
+        std::sort(neighbors.begin(), neighbors.end());
+        std::sort(neighborsSegment.begin(), neighborsSegment.end());
+        ASSERT_EQ(neighborsSegment, neighbors);
+
+        octree.radiusNeighbors(query, radii[r], neighbors, MaximumNorm());
+        segmentOctree.radiusNeighbors(query, radii[r], neighborsSegment, MaximumNorm());
+        std::sort(neighbors.begin(), neighbors.end());
+        std::sort(neighborsSegment.begin(), neighborsSegment.end());
+        ASSERT_EQ(neighborsSegment, neighbors);
+      }
+    }
+  }
+
+  // without restriction, all points of all segments are found.
+  octree.setSegment(Octree::ALL_SEGMENTS);
+  std::vector<uint32_t> neighbors;
+  octree.radiusNeighbors(Point3f(0, 0, 0), 10.0f, neighbors, MaximumNorm());
+  uint32_t numPoints = 0;
+  for (uint32_t s = 0; s < S; ++s)
+    numPoints += segments[s].size();
+  ASSERT_EQ(numPoints, neighbors.size());
+}
+
+// norm without a specialized search in the octree.
+class ScaledEuclideanNorm: public Norm
+{
+  public:
+    float compute(float x, float y, float z) const
+    {
+      return 2.0f * std::sqrt(x * x + y * y + z * z);
+    }
+};
+
+TEST_F(OctreeTest, RadiusNeighborsOtherNorm)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 1000, 42);
+
+  NaiveNeighborSearch bruteforce;
+  bruteforce.initialize(points);
+  Octree octree;
+  octree.initialize(points);
+
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    std::vector<uint32_t> neighborsBruteforce;
+    std::vector<uint32_t> neighborsOctree;
+
+    bruteforce.radiusNeighbors(points[i * 13], 2.0f, neighborsBruteforce, ScaledEuclideanNorm());
+    octree.radiusNeighbors(points[i * 13], 2.0f, neighborsOctree, ScaledEuclideanNorm());
+    ASSERT_EQ(true, similarVectors(neighborsBruteforce, neighborsOctree));
+  }
+}
+
+float referenceEuclidean(float x, float y, float z)
+{
+  return std::sqrt(std::pow(x, 2) + std::pow(y, 2) + std::pow(z, 2));
+}
+
+float referenceManhatten(float x, float y, float z)
+{
+  return std::fabs(x) + std::fabs(y) + std::fabs(z);
+}
+
+float referenceMaximum(float x, float y, float z)
+{
+  return std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+}
+
+/** \brief compare policy and norm adapter with a reference norm, which is computed independently of rv/norms.h. **/
+template<typename Distance>
+void checkNormPolicy(const Norm& norm, float (*reference)(float, float, float))
+{
+  std::vector<Point3f> vectors;
+  randomPoints(vectors, 1000, 4711);
+  const float radii[] = { 0.5f, 2.0f, 5.0f };
+
+  Distance dist;
+  for (uint32_t i = 0; i < vectors.size(); ++i)
+  {
+    const float x = vectors[i].x(), y = vectors[i].y(), z = vectors[i].z();
+    const float expected = reference(x, y, z);
+
+    ASSERT_NEAR(expected, dist.compute(x, y, z), 1e-5 * expected);
+    ASSERT_NEAR(expected, norm.compute(x, y, z), 1e-5 * expected);
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+      if (std::fabs(expected - radii[r]) < 1e-4) continue;
+      ASSERT_EQ(expected < radii[r], dist.compare(x, y, z) < dist.threshold(radii[r])) << "radius " << radii[r];
+    }
+  }
+}
+
+TEST_F(OctreeTest, NormPolicies)
+{
+  // the naive search uses the norm adapters, thus the policies of the octree are checked separately.
+  ASSERT_NO_FATAL_FAILURE(checkNormPolicy<EuclideanDistance>(EuclideanNorm(), referenceEuclidean));
+  ASSERT_NO_FATAL_FAILURE(checkNormPolicy<ManhattenDistance>(ManhattenNorm(), referenceManhatten));
+  ASSERT_NO_FATAL_FAILURE(checkNormPolicy<MaximumDistance>(MaximumNorm(), referenceMaximum));
+}
+
+TEST_F(OctreeTest, DuplicatePoints)
+{
+  // more duplicates than the bucket size cannot be separated by subdivision.
+  std::vector<Point3f> points(100, Point3f(1.0f, 2.0f, 3.0f));
+  points.push_back(Point3f(-1.0f, -2.0f, -3.0f));
+
+  Octree octree(16);
+  octree.initialize(points);
+
+  std::vector<uint32_t> neighbors;
+  octree.radiusNeighbors(Point3f(1.0f, 2.0f, 3.0f), 0.5f, neighbors, EuclideanNorm());
+  ASSERT_EQ(100, neighbors.size());
+}
+
+TEST_F(OctreeTest, RadiusNeighborsBatch)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 3000, 2015);
+
+  std::vector<Point3f> queries;
+  randomPoints(queries, 200, 2016);
+  // points of the octree and outside the bounding box.
+  queries.insert(queries.end(), points.begin(), points.begin() + 100);
+  queries.push_back(Point3f(20.0f, 20.0f, 20.0f));
+
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[i % 2].indexes.push_back(i);
+
+  Octree octree(16);
+  Octree segmentOctree(16);
+  NaiveNeighborSearch bruteforce;
+
+  octree.initialize(points);
+  segmentOctree.initialize(points, segments);
+  segmentOctree.setSegment(1);
+  bruteforce.initialize(points);
+
+  const NearestNeighborImpl* searches[3] =
+  { &octree, &segmentOctree, &bruteforce };
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  float radii[3] =
+  { 0.3, 1.0, 4.0 };
+
+  for (uint32_t s = 0; s < 3; ++s)
+  {
+    for (uint32_t n = 0; n < 3; ++n)
+    {
+      for (uint32_t r = 0; r < 3; ++r)
+      {
+        std::vector<uint32_t> offsets, neighbors, expected;
+        searches[s]->radiusNeighbors(queries, radii[r], offsets, neighbors, *norms[n]);
+        ASSERT_EQ(queries.size() + 1, offsets.size());
+        ASSERT_EQ(neighbors.size(), offsets.back());
+
+        for (uint32_t i = 0; i < queries.size(); ++i)
+        {
+          searches[s]->radiusNeighbors(queries[i], radii[r], expected, *norms[n]);
+          std::vector<uint32_t> result(neighbors.begin() + offsets[i], neighbors.begin() + offsets[i + 1]);
+          std::sort(expected.begin(), expected.end());
+          std::sort(result.begin(), result.end());
+          ASSERT_EQ(expected, result)<< "query " << i << " with search " << s << " and norm " << n;
+        }
+      }
+    }
+  }
+}
+
+
+TEST_F(OctreeTest, ParallelBuild)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 30000, 2017);
+
+  std::vector<IndexedSegment> segments(3);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[(points[i].x() > 0.0f) ? 0 : (i % 2) + 1].indexes.push_back(i);
+
+  Octree serial(16);
+  Octree parallel(16);
+  parallel.setNumThreads(4);
+
+  for (uint32_t t = 0; t < 2; ++t)
+  {
+    if (t == 0)
+    {
+      serial.initialize(points);
+      parallel.initialize(points);
+    }
+    else
+    {
+      serial.initialize(points, segments);
+      parallel.initialize(points, segments);
+    }
+
+    // same partitioning of the points.
+    ASSERT_EQ(getOctants(serial).size(), getOctants(parallel).size());
+    ASSERT_EQ(getIndexes(serial), getIndexes(parallel));
+    ASSERT_EQ(getSegmentIds(serial), getSegmentIds(parallel));
+    for (uint32_t i = 0; i < points.size(); ++i)
+      ASSERT_TRUE(getPoint(serial, i) == getPoint(parallel, i));
+
+    EuclideanNorm norm;
+    std::vector<uint32_t> expected, result;
+    for (uint32_t s = 0; s < (t == 0 ? 1 : 3); ++s)
+    {
+      if (t == 1)
+      {
+        serial.setSegment(s);
+        parallel.setSegment(s);
+      }
+
+      for (uint32_t i = 0; i < 100; ++i)
+      {
+        serial.radiusNeighbors(points[i], 0.5f, expected, norm);
+        parallel.radiusNeighbors(points[i], 0.5f, result, norm);
+        ASSERT_EQ(expected, result);
+      }
+    }
+  }
+
+  // octants are stored in a different order, but the same octants are restricted to a single segment.
+  uint32_t numSegmentOctants[2] = { 0, 0 };
+  for (uint32_t i = 0; i < getOctants(serial).size(); ++i)
+  {
+    if (getOctants(serial)[i].segment != Octree::ALL_SEGMENTS) ++numSegmentOctants[0];
+    if (getOctants(parallel)[i].segment != Octree::ALL_SEGMENTS) ++numSegmentOctants[1];
+  }
+  ASSERT_EQ(numSegmentOctants[0], numSegmentOctants[1]);
+}
+
+
+TEST_F(OctreeTest, KnnNeighbors)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 2000, 2018);
+
+  std::vector<Point3f> queries;
+  randomPoints(queries, 50, 2019);
+  queries.push_back(points[0]);
+  queries.push_back(Point3f(20.0f, 20.0f, 20.0f));
+
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[i % 2].indexes.push_back(i);
+
+  Octree octree(16);
+  NaiveNeighborSearch bruteforce;
+  octree.initialize(points);
+  bruteforce.initialize(points);
+
+  Octree segmentOctree(16);
+  NaiveNeighborSearch segmentBruteforce;
+  segmentOctree.initialize(points, segments);
+  segmentOctree.setSegment(1);
+  segmentBruteforce.initialize(points, segments[1].indexes);
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  uint32_t ks[4] =
+  { 1, 7, 50, 3000 };
+
+  std::vector<uint32_t> expected, result;
+  for (uint32_t s = 0; s < 2; ++s)
+  {
+    const NearestNeighborImpl& search = (s == 0) ? (const NearestNeighborImpl&) octree : segmentOctree;
+    const NearestNeighborImpl& reference = (s == 0) ? bruteforce : segmentBruteforce;
+    const uint32_t N = (s == 0) ? points.size() : segments[1].indexes.size();
+
+    for (uint32_t n = 0; n < 3; ++n)
+    {
+      for (uint32_t j = 0; j < 4; ++j)
+      {
+        for (uint32_t i = 0; i < queries.size(); ++i)
+        {
+          search.knnNeighbors(queries[i], ks[j], result, *norms[n]);
+          reference.knnNeighbors(queries[i], ks[j], expected, *norms[n]);
+          ASSERT_EQ(std::min(ks[j], N), result.size());
+          ASSERT_EQ(expected.size(), result.size());
+
+          // neighbors with equal distances might be ordered differently, therefore only distances are compared.
+          for (uint32_t k = 0; k < result.size(); ++k)
+          {
+            if (s == 1)
+            {
+              ASSERT_EQ(1, result[k] % 2);
+            }
+            ASSERT_NEAR(norms[n]->compute(queries[i], points[expected[k]]),
+                norms[n]->compute(queries[i], points[result[k]]), 0.0001);
+          }
+        }
+      }
+    }
+  }
+
+  ASSERT_EQ(0, octree.nearestNeighbor(points[0], euclidean));
+  ASSERT_EQ(bruteforce.nearestNeighbor(queries[3], euclidean), octree.nearestNeighbor(queries[3], euclidean));
+
+  Octree emptyOctree;
+  emptyOctree.initialize(std::vector<Point3f>());
+  ASSERT_EQ(-1, emptyOctree.nearestNeighbor(queries[0], euclidean));
+  emptyOctree.knnNeighbors(queries[0], 5, result, euclidean);
+  ASSERT_EQ(0, result.size());
+}
+
+
+TEST_F(OctreeTest, RadiusNeighborsOffsetsAndCount)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 3000, 2020);
+
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[(points[i].x() > 0.0f) ? 0 : (i % 2)].indexes.push_back(i);
+
+  Octree search(16);
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  float radii[3] =
+  { 0.3f, 1.0f, 4.0f };
+
+  std::vector<uint32_t> expected, result;
+  std::vector<Vector3f> offsets;
+  for (uint32_t t = 0; t < 2; ++t)
+  {
+    if (t == 0) search.initialize(points);
+    else search.initialize(points, segments);
+    if (t == 1) search.setSegment(1);
+
+    for (uint32_t n = 0; n < 3; ++n)
+    {
+      for (uint32_t r = 0; r < 3; ++r)
+      {
+        for (uint32_t i = 0; i < points.size(); i += 50)
+        {
+          search.radiusNeighbors(points[i], radii[r], expected, *norms[n]);
+          search.radiusNeighbors(points[i], radii[r], result, offsets, *norms[n]);
+          ASSERT_EQ(expected.size(), search.countNeighbors(points[i], radii[r], *norms[n]));
+          ASSERT_EQ(result.size(), offsets.size());
+          for (uint32_t j = 0; j < result.size(); ++j)
+          {
+            Vector3f diff = points[result[j]] - points[i];
+            ASSERT_NEAR(diff.x(), offsets[j].x(), 0.0001);
+            ASSERT_NEAR(diff.y(), offsets[j].y(), 0.0001);
+            ASSERT_NEAR(diff.z(), offsets[j].z(), 0.0001);
+          }
+
+          std::sort(expected.begin(), expected.end());
+          std::sort(result.begin(), result.end());
+          ASSERT_EQ(expected, result);
+        }
+      }
+    }
+  }
+}
+
+
+TEST_F(OctreeTest, ApproximateRadiusNeighbors)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 1887);
+
+  Octree octree(8);
+  octree.initialize(points);
+  Octree exact(8);
+  exact.initialize(points);
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  const Norm* norms[2] =
+  { &euclidean, &maximum };
+  const float radius = 1.5f, eps = 0.2f;
+
+  std::vector<uint32_t> expected, result;
+  for (uint32_t n = 0; n < 2; ++n)
+  {
+    const Norm& norm = *norms[n];
+
+    // without approximation the results are exact.
+    octree.setApproximation(0.0f);
+    for (uint32_t i = 0; i < points.size(); i += 100)
+    {
+      octree.radiusNeighbors(points[i], radius, result, norm);
+      exact.radiusNeighbors(points[i], radius, expected, norm);
+      ASSERT_EQ(expected, result);
+    }
+    ASSERT_EQ(0, octree.approximatedPoints());
+
+    // only points in [(1-eps)*r, (1+eps)*r] might be classified differently.
+    octree.setApproximation(eps);
+    for (uint32_t i = 0; i < points.size(); i += 100)
+    {
+      octree.radiusNeighbors(points[i], radius, result, norm);
+      ASSERT_EQ(result.size(), octree.countNeighbors(points[i], radius, norm));
+
+      std::vector<bool> found(points.size(), false);
+      for (uint32_t j = 0; j < result.size(); ++j)
+      {
+        ASSERT_LE(norm.compute(points[i], points[result[j]]), (1.0f + eps) * radius + 0.0001f);
+        found[result[j]] = true;
+      }
+
+      exact.radiusNeighbors(points[i], (1.0f - eps) * radius, expected, norm);
+      for (uint32_t j = 0; j < expected.size(); ++j)
+        ASSERT_TRUE(found[expected[j]]);
+    }
+    ASSERT_GT(octree.approximatedPoints(), 0);
+
+    // the batch search gives the results of the approximate single query search.
+    std::vector<Point3f> queries;
+    for (uint32_t i = 0; i < points.size(); i += 100)
+      queries.push_back(points[i]);
+    std::vector<uint32_t> offsets, neighbors;
+    octree.radiusNeighbors(queries, radius, offsets, neighbors, norm);
+    for (uint32_t i = 0; i < queries.size(); ++i)
+    {
+      octree.radiusNeighbors(queries[i], radius, result, norm);
+      ASSERT_EQ(result, std::vector<uint32_t>(neighbors.begin() + offsets[i], neighbors.begin() + offsets[i + 1]));
+    }
+
+    octree.resetApproximatedPoints();
+    ASSERT_EQ(0, octree.approximatedPoints());
+  }
+
+  // with a restriction to a segment only its points are counted, thus the counts of both segments add up to the
+  // count without restriction.
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[(points[i].x() > 2.0f) ? 1 : (i % 2)].indexes.push_back(i);
+
+  Octree segmented(8);
+  segmented.initialize(points, segments);
+  segmented.setApproximation(eps);
+
+  uint64_t counts[3];
+  for (int32_t s = -1; s < 2; ++s)
+  {
+    segmented.setSegment((s < 0) ? Octree::ALL_SEGMENTS : s);
+    segmented.resetApproximatedPoints();
+    for (uint32_t i = 0; i < points.size(); i += 100)
+      segmented.radiusNeighbors(points[i], radius, result, euclidean);
+    counts[s + 1] = segmented.approximatedPoints();
+  }
+  ASSERT_GT(counts[0], 0);
+  ASSERT_EQ(counts[0], counts[1] + counts[2]);
+}
+
+void approximateQueries(const Octree* octree, const std::vector<Point3f>* points, uint32_t first, uint32_t step)
+{
+  std::vector<uint32_t> result;
+  EuclideanNorm euclidean;
+  for (uint32_t i = first; i < points->size(); i += step)
+    octree->radiusNeighbors((*points)[i], 1.5f, result, euclidean);
+}
+
+TEST_F(OctreeTest, ApproximationConcurrentCount)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 1887);
+
+  Octree octree(8);
+  octree.initialize(points);
+  ASSERT_THROW(octree.setApproximation(1.0f), Error);
+  ASSERT_THROW(octree.setApproximation(-0.1f), Error);
+  octree.setApproximation(0.2f);
+
+  approximateQueries(&octree, &points, 0, 10);
+  const uint64_t expected = octree.approximatedPoints();
+  ASSERT_GT(expected, 0);
+
+  // concurrent queries must not lose any of the counts.
+  octree.resetApproximatedPoints();
+  boost::thread_group threads;
+  for (uint32_t t = 0; t < 4; ++t)
+    threads.create_thread(boost::bind(&approximateQueries, &octree, &points, t * 10, 40));
+  threads.join_all();
+
+  ASSERT_EQ(expected, octree.approximatedPoints());
+}
+
+TEST_F(OctreeTest, SaveLoad)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 2021);
+
+  std::vector<IndexedSegment> segments(3);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[i % 3].indexes.push_back(i);
+
+  std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+
+  Octree octree(16);
+  octree.initialize(points, segments);
+  ASSERT_TRUE(octree.save(filename));
+
+  Octree loaded(16);
+  ASSERT_TRUE(loaded.load(filename, points, segments));
+  ASSERT_EQ(getOctants(octree).size(), getOctants(loaded).size());
+  ASSERT_EQ(getIndexes(octree), getIndexes(loaded));
+  ASSERT_EQ(getSegmentIds(octree), getSegmentIds(loaded));
+
+  EuclideanNorm norm;
+  std::vector<uint32_t> expected, result;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+  {
+    octree.setSegment(s);
+    loaded.setSegment(s);
+    for (uint32_t i = 0; i < points.size(); i += 25)
+    {
+      octree.radiusNeighbors(points[i], 0.5f, expected, norm);
+      loaded.radiusNeighbors(points[i], 0.5f, result, norm);
+      ASSERT_EQ(expected, result);
+    }
+  }
+
+  // different bucket size, points, or segments.
+  Octree other(8);
+  ASSERT_FALSE(other.load(filename, points, segments));
+  points[10] = Point3f(1.0f, 2.0f, 3.0f);
+  ASSERT_FALSE(loaded.load(filename, points, segments));
+  segments.pop_back();
+  ASSERT_FALSE(loaded.load(filename, points, segments));
+  ASSERT_FALSE(loaded.load(filename + ".missing", points, segments));
+
+  boost::filesystem::remove(filename);
+}
+
 }
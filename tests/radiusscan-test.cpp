@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <boost/random.hpp>
+
+#include "../project/RadiusScan.h"
+
+namespace
+{
+
+// compare the vectorized kernels with the scalar reference for all distances.
+TEST(RadiusScanTest, Reference)
+{
+  boost::mt11213b mtwister(1234);
+  boost::uniform_01<> gen;
+
+  ScanDistance types[3] =
+  { SCAN_EUCLIDEAN_SQR, SCAN_MAXIMUM, SCAN_MANHATTEN };
+
+  // different sizes to cover full vectors and remaining points.
+  for (uint32_t n = 0; n < 70; n += 3)
+  {
+    std::vector<float> x(n), y(n), z(n);
+    std::vector<uint32_t> indexes(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      x[i] = 2.0f * gen(mtwister) - 1.0f;
+      y[i] = 2.0f * gen(mtwister) - 1.0f;
+      z[i] = 2.0f * gen(mtwister) - 1.0f;
+      indexes[i] = 3 * i + 1;
+    }
+
+    for (uint32_t t = 0; t < 3; ++t)
+    {
+      for (float threshold = 0.1f; threshold < 1.5f; threshold += 0.3f)
+      {
+        std::vector<uint32_t> expected(n + 1), result(n + 1);
+        float qx = 0.1f, qy = -0.2f, qz = 0.05f;
+
+        uint32_t expectedCount = radiusScanScalar(types[t], &x[0], &y[0], &z[0], &indexes[0], n, qx, qy, qz,
+            threshold, &expected[0]);
+        uint32_t count = radiusScan(types[t], &x[0], &y[0], &z[0], &indexes[0], n, qx, qy, qz, threshold,
+            &result[0]);
+
+        ASSERT_EQ(expectedCount, count)<< "n = " << n << ", distance = " << t << " with "
+            << radiusScanInstructionSet() << " instructions.";
+        for (uint32_t i = 0; i < count; ++i)
+          ASSERT_EQ(expected[i], result[i]) << radiusScanInstructionSet() << " instructions.";
+      }
+    }
+  }
+}
+
+}
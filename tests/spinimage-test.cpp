@@ -3,9 +3,11 @@
 #include <rv/PrimitiveParameters.h>
 #include <rv/NearestNeighborImpl.h>
 #include <rv/string_utils.h>
+#include <rv/Laserscan.h>
 
 #include "../project/utils.h"
 #include "../project/SpinImage.h"
+#include "../project/Octree.h"
 #include "test_utils.h"
 
 using namespace rv;
@@ -50,4 +52,142 @@ TEST(SpinImageTest, Computation)
   ASSERT_TRUE(almostEqualVectors(v3, &feature[0], 9))<< "Expected: " << stringify(v2, 9) << ", but got: " << rv::stringify(feature);
 }
 
+// the parallel evaluation of multiple points must give the same spin images as the evaluation of single points.
+TEST(SpinImageTest, EvaluateMultiplePoints)
+{
+  Laserscan scan;
+  Random rand(1234);
+  for (uint32_t i = 0; i < 2000; ++i)
+    scan.points().push_back(Point3f(4.0f * rand.getFloat() - 2.0f, 4.0f * rand.getFloat() - 2.0f, rand.getFloat()));
+
+  ParameterList params;
+  params.insert(IntegerParameter("num-bins", 5));
+  params.insert(BooleanParameter("bilinear", false));
+  params.insert(FloatParameter("radius", 0.5));
+  params.insert(StringParameter("normalizer", "none"));
+
+  SpinImage si(params);
+  const uint32_t D = si.dim();
+
+  NaiveNeighborSearch nn;
+  nn.initialize(scan.points());
+  Normal3f upvector(0.0f, 0.0f, 1.0f);
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < scan.points().size(); i += 3)
+    indexes.push_back(i);
+
+  std::vector<float> expected(indexes.size() * D);
+  for (uint32_t i = 0; i < indexes.size(); ++i)
+    si.evaluate(&expected[i * D], scan.point(indexes[i]), upvector, scan, nn);
+
+  // the octree answers the batched radius search of every block with a shared traversal.
+  Octree octree;
+  octree.initialize(scan.points());
+  const NearestNeighborImpl* searches[2] =
+  { &nn, &octree };
+
+  for (uint32_t n = 0; n < 2; ++n)
+  {
+    for (uint32_t numThreads = 1; numThreads <= 4; numThreads += 3)
+    {
+      si.setNumThreads(numThreads);
+      std::vector<float> values(indexes.size() * D, -1.0f);
+      si.evaluate(&values[0], indexes, upvector, scan, *searches[n]);
+
+      for (uint32_t i = 0; i < indexes.size(); ++i)
+        ASSERT_TRUE(almostEqualVectors(&expected[i * D], &values[i * D], D)) << "point " << indexes[i] << " with "
+            << numThreads << " threads.";
+    }
+  }
+}
+
+TEST(SpinImageTest, SharedNeighborhoods)
+{
+  Laserscan scan;
+  Random rand(4711);
+  for (uint32_t i = 0; i < 3000; ++i)
+    scan.points().push_back(Point3f(4.0f * rand.getFloat() - 2.0f, 4.0f * rand.getFloat() - 2.0f, rand.getFloat()));
+
+  ParameterList params;
+  params.insert(IntegerParameter("num-bins", 5));
+  params.insert(FloatParameter("radius", 0.5));
+  params.insert(StringParameter("normalizer", "max"));
+
+  SpinImage si(params);
+  const uint32_t D = si.dim();
+
+  Octree nn;
+  nn.initialize(scan.points());
+  Normal3f upvector(0.0f, 0.0f, 1.0f);
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < scan.points().size(); i += 2)
+    indexes.push_back(i);
+
+  std::vector<float> expected(indexes.size() * D);
+  si.evaluate(&expected[0], indexes, upvector, scan, nn);
+
+  // neighbors selected from the neighbors of the voxel must give the same spin images.
+  const float voxelSizes[] = { 0.1f, 0.3f, 5.0f };
+  for (uint32_t v = 0; v < 3; ++v)
+  {
+    for (uint32_t numThreads = 1; numThreads <= 4; numThreads += 3)
+    {
+      si.setSharedNeighborhoods(voxelSizes[v]);
+      si.setNumThreads(numThreads);
+      std::vector<float> values(indexes.size() * D, -1.0f);
+      si.evaluate(&values[0], indexes, upvector, scan, nn);
+
+      for (uint32_t i = 0; i < indexes.size(); ++i)
+        ASSERT_TRUE(almostEqualVectors(&expected[i * D], &values[i * D], D)) << "point " << indexes[i]
+            << " with voxel size " << voxelSizes[v] << " and " << numThreads << " threads.";
+    }
+  }
+}
+
+TEST(SpinImageTest, Normals)
+{
+  Laserscan scan;
+  Random rand(1234);
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    scan.points().push_back(Point3f(2.0f * rand.getFloat() - 1.0f, 2.0f * rand.getFloat() - 1.0f, rand.getFloat()));
+    const float angle = 2.0f * M_PI * rand.getFloat();
+    scan.normals().push_back(Normal3f(std::cos(angle), std::sin(angle), 0.0f));
+  }
+
+  ParameterList params;
+  params.insert(IntegerParameter("num-bins", 5));
+  params.insert(FloatParameter("radius", 0.5));
+  params.insert(StringParameter("normalizer", "none"));
+  params.insert(BooleanParameter("normals", true));
+
+  SpinImage si(params);
+  const uint32_t D = si.dim();
+
+  Octree nn;
+  nn.initialize(scan.points());
+  Normal3f upvector(0.0f, 0.0f, 1.0f);
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < scan.points().size(); i += 7)
+    indexes.push_back(i);
+
+  // every point uses its own normal as reference axis instead of the up-vector.
+  std::vector<float> values(indexes.size() * D), expected(D), single(D);
+  SpinImage::Buffers buffers;
+  si.evaluate(&values[0], indexes, upvector, scan, nn);
+  for (uint32_t i = 0; i < indexes.size(); ++i)
+  {
+    si.evaluate(&expected[0], scan.point(indexes[i]), scan.normal(indexes[i]), scan, nn);
+    ASSERT_TRUE(almostEqualVectors(&expected[0], &values[i * D], D)) << "point " << indexes[i];
+    si.evaluate(&single[0], indexes[i], upvector, scan, nn);
+    ASSERT_TRUE(almostEqualVectors(&expected[0], &single[0], D)) << "point " << indexes[i];
+    // buffers reused from the previous points must not change the result.
+    si.evaluate(&single[0], indexes[i], upvector, scan, nn, buffers);
+    ASSERT_TRUE(almostEqualVectors(&expected[0], &single[0], D)) << "point " << indexes[i];
+  }
+}
+
 }
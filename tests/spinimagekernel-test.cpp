@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <boost/random.hpp>
+
+#include "../project/SpinImageKernel.h"
+#include "test_utils.h"
+
+namespace
+{
+
+// compare the vectorized kernels with the scalar reference with and without bilinear interpolation.
+TEST(SpinImageKernelTest, Reference)
+{
+  boost::mt11213b mtwister(1234);
+  boost::uniform_01<> gen;
+
+  const float radius = 0.5f;
+  // reference axes of unit and non-unit length.
+  const float axes[3][3] =
+  {
+  { 0.0f, 0.0f, 1.0f },
+  { 0.6f, 0.0f, 0.8f },
+  { 1.0f, 2.0f, -0.5f } };
+
+  // different sizes to cover full vectors and remaining neighbors.
+  for (uint32_t n = 0; n < 70; n += 3)
+  {
+    // offsets partially outside the histogram.
+    std::vector<float> x(n), y(n), z(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      x[i] = 1.2f * gen(mtwister) - 0.6f;
+      y[i] = 1.2f * gen(mtwister) - 0.6f;
+      z[i] = 1.2f * gen(mtwister) - 0.6f;
+    }
+
+    for (uint32_t numBins = 1; numBins < 8; numBins += 3)
+    {
+      for (uint32_t r = 0; r < 3; ++r)
+      {
+        for (uint32_t bilinear = 0; bilinear < 2; ++bilinear)
+        {
+          std::vector<float> expected(numBins * numBins, 0.0f), result(numBins * numBins, 0.0f);
+          const float* axis = axes[r];
+
+          spinImageBinningScalar(&x[0], &y[0], &z[0], n, axis[0], axis[1], axis[2], radius, numBins, bilinear,
+              &expected[0]);
+          spinImageBinning(&x[0], &y[0], &z[0], n, axis[0], axis[1], axis[2], radius, numBins, bilinear,
+              &result[0]);
+
+          ASSERT_TRUE(almostEqualVectors(&expected[0], &result[0], numBins * numBins)) << "n = " << n
+              << ", bins = " << numBins << ", axis = " << r << ", bilinear = " << bilinear << " with "
+              << spinImageInstructionSet() << " instructions: expected "
+              << stringify(&expected[0], numBins * numBins) << ", but got " << stringify(&result[0], numBins * numBins);
+        }
+      }
+    }
+  }
+}
+
+// every neighbor inside the histogram adds a total weight of 1 if no weight is dropped at the border.
+TEST(SpinImageKernelTest, Binning)
+{
+  // offsets along the axis (alpha = 0) and perpendicular to it (beta = 0).
+  float x[4] =
+  { 0.0f, 0.0f, 0.3f, 0.45f };
+  float y[4] =
+  { 0.0f, 0.0f, 0.0f, 0.0f };
+  float z[4] =
+  { 0.1f, -0.3f, 0.0f, 0.0f };
+
+  std::vector<float> histogram(9, 0.0f);
+  spinImageBinningScalar(x, y, z, 4, 0.0f, 0.0f, 1.0f, 0.6f, 3, false, &histogram[0]);
+  float expected[9] =
+  { 1, 0, 0, 1, 1, 1, 0, 0, 0 };
+  ASSERT_TRUE(almostEqualVectors(expected, &histogram[0], 9)) << stringify(&histogram[0], 9);
+
+  // alpha = 0.1 with cells of size 0.2 and beta = 0 with cells of size 0.4, i.e., in the middle of both cells.
+  std::vector<float> interpolated(9, 0.0f);
+  float px = 0.1f, py = 0.0f, pz = 0.0f;
+  spinImageBinningScalar(&px, &py, &pz, 1, 0.0f, 0.0f, 1.0f, 0.6f, 3, true, &interpolated[0]);
+  float expectedInterpolated[9] =
+  { 0, 0, 0, 0.25, 0.25, 0, 0.25, 0.25, 0 };
+  ASSERT_TRUE(almostEqualVectors(expectedInterpolated, &interpolated[0], 9)) << stringify(&interpolated[0], 9);
+}
+
+}
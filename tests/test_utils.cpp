@@ -1,5 +1,6 @@
 #include "test_utils.h"
 #include <sstream>
+#include <algorithm>
 
 using namespace rv;
 
@@ -19,11 +20,43 @@ void NaiveNeighborSearch::radiusNeighbors(const Point3f& query, float radius, st
   {
     if (norm.compute(query, pts[indexes_[i]]) < radius)
     {
-      resultIndices.push_back(i);
+      resultIndices.push_back(indexes_[i]);
     }
   }
 }
 
+void NaiveNeighborSearch::radiusNeighbors(const Point3f& query, float radius, std::vector<uint32_t>& resultIndices,
+    std::vector<Vector3f>& offsets, const Norm& norm) const
+{
+  const std::vector<Point3f>& pts = *data_;
+  resultIndices.clear();
+  offsets.clear();
+
+  for (uint32_t i = 0; i < indexes_.size(); ++i)
+  {
+    if (norm.compute(query, pts[indexes_[i]]) < radius)
+    {
+      resultIndices.push_back(indexes_[i]);
+      offsets.push_back(pts[indexes_[i]] - query);
+    }
+  }
+}
+
+void NaiveNeighborSearch::knnNeighbors(const Point3f& query, uint32_t k, std::vector<uint32_t>& resultIndices,
+    const Norm& norm) const
+{
+  const std::vector<Point3f>& pts = *data_;
+
+  std::vector<std::pair<float, uint32_t> > candidates(indexes_.size());
+  for (uint32_t i = 0; i < indexes_.size(); ++i)
+    candidates[i] = std::make_pair(norm.compute(query, pts[indexes_[i]]), indexes_[i]);
+  std::sort(candidates.begin(), candidates.end());
+
+  resultIndices.resize(std::min<uint32_t>(k, candidates.size()));
+  for (uint32_t i = 0; i < resultIndices.size(); ++i)
+    resultIndices[i] = candidates[i].second;
+}
+
 bool almostEqualVectors(float* vec1, float* vec2, uint32_t n)
 {
   for (uint32_t i = 0; i < n; ++i)
@@ -7,7 +7,7 @@
  * \brief Naive implementation of radius neighbor search.
  *
  * Simply searches for nearest neighbors by linearly search a list of points.
- *
+ * As the Octree, all queries return the point ids given by indexes.
  */
 class NaiveNeighborSearch: public rv::NearestNeighborImpl
 {
@@ -17,12 +17,20 @@ class NaiveNeighborSearch: public rv::NearestNeighborImpl
     void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& resultIndices,
         const rv::Norm& norm) const;
 
+    void radiusNeighbors(const rv::Point3f& query, float radius, std::vector<uint32_t>& resultIndices,
+        std::vector<rv::Vector3f>& offsets, const rv::Norm& norm) const;
+
+    void knnNeighbors(const rv::Point3f& query, uint32_t k, std::vector<uint32_t>& resultIndices,
+        const rv::Norm& norm) const;
+
     using rv::NearestNeighborImpl::initialize; // unhide implementation of base-class.
+    using rv::NearestNeighborImpl::radiusNeighbors;
   protected:
     std::vector<uint32_t> indexes_;
     const std::vector<rv::Point3f>* data_;
 };
 
+
 bool almostEqualVectors(float* vec1, float* vec2, uint32_t n);
 
 std::string stringify(float* v, uint32_t n);
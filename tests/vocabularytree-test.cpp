@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <cfloat>
+#include <set>
+#include <boost/filesystem.hpp>
+#include <rv/Random.h>
+#include <rv/IOError.h>
+
+#include "../project/VocabularyTree.h"
+#include "../project/utils.h"
+
+using namespace rv;
+
+namespace
+{
+
+/** \brief index of the nearest word by linear search. **/
+uint32_t nearestWord(const std::vector<std::vector<float> >& words, const std::vector<float>& x)
+{
+  uint32_t nearest = 0;
+  float minDistance = FLT_MAX;
+  for (uint32_t j = 0; j < words.size(); ++j)
+  {
+    float d = 0.0f;
+    for (uint32_t k = 0; k < x.size(); ++k)
+      d += (words[j][k] - x[k]) * (words[j][k] - x[k]);
+    if (d < minDistance)
+    {
+      minDistance = d;
+      nearest = j;
+    }
+  }
+
+  return nearest;
+}
+
+/** \brief 4 well separated groups, where each group consists of 4 subgroups of 25 descriptors. **/
+void generateDescriptors(DescriptorMatrix& data)
+{
+  const uint32_t D = 4;
+  Random rand(1234);
+  std::vector<float> x(D);
+  for (uint32_t i = 0; i < 400; ++i)
+  {
+    const uint32_t group = (i / 25) / 4, subgroup = (i / 25) % 4;
+    for (uint32_t k = 0; k < D; ++k)
+      x[k] = 0.1f * rand.getGaussianFloat();
+    x[group] += 20.0f;
+    x[subgroup] += 2.0f;
+    data.push_back(&x[0]);
+  }
+}
+
+TEST(VocabularyTreeTest, Train)
+{
+  DescriptorMatrix data(FORMAT_FLOAT32, 4);
+  generateDescriptors(data);
+
+  VocabularyTree tree;
+  tree.train(data, 4, 2);
+  ASSERT_EQ(2, tree.depth());
+  ASSERT_EQ(4, tree.dim());
+  ASSERT_LT(4, tree.words().size());
+  ASSERT_GE(16, tree.words().size());
+
+  // descriptors are assigned to the children as in the lookup, thus every leaf is found by its own descriptors.
+  std::set<uint32_t> distinct;
+  for (uint32_t i = 0; i < data.size(); ++i)
+  {
+    const std::vector<float> x = data[i];
+    const uint32_t word = tree.lookup(&x[0]);
+    ASSERT_LT(word, tree.words().size());
+    distinct.insert(word);
+  }
+  ASSERT_EQ(tree.words().size(), distinct.size());
+
+  // depth of 1 is a flat vocabulary with at most the branching factor words.
+  VocabularyTree flat;
+  flat.train(data, 4, 1);
+  ASSERT_EQ(1, flat.depth());
+  ASSERT_EQ(4, flat.words().size());
+
+  // nodes with fewer descriptors than the branching factor are only split into single descriptors.
+  DescriptorMatrix few(FORMAT_FLOAT32, 4);
+  for (uint32_t i = 0; i < 3; ++i)
+    few.push_back(data, i * 100);
+  VocabularyTree small;
+  small.train(few, 4, 3);
+  ASSERT_EQ(3, small.words().size());
+}
+
+TEST(VocabularyTreeTest, Flat)
+{
+  const uint32_t D = 10, W = 50;
+  Random rand(4711);
+
+  std::vector<std::vector<float> > vocabulary(W, std::vector<float>(D));
+  for (uint32_t j = 0; j < W; ++j)
+    for (uint32_t k = 0; k < D; ++k)
+      vocabulary[j][k] = rand.getGaussianFloat();
+
+  VocabularyTree tree(vocabulary);
+  ASSERT_EQ(1, tree.depth());
+  ASSERT_EQ(W, tree.words().size());
+
+  std::vector<float> x(D);
+  for (uint32_t i = 0; i < 100; ++i)
+  {
+    for (uint32_t k = 0; k < D; ++k)
+      x[k] = rand.getGaussianFloat();
+    ASSERT_EQ(nearestWord(vocabulary, x), tree.lookup(&x[0]));
+  }
+}
+
+TEST(VocabularyTreeTest, ReadWrite)
+{
+  DescriptorMatrix data(FORMAT_FLOAT32, 4);
+  generateDescriptors(data);
+
+  VocabularyTree tree;
+  tree.train(data, 3, 3);
+
+  std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  writeVocabulary(filename, tree);
+
+  VocabularyTree loaded;
+  readVocabulary(filename, loaded);
+  ASSERT_EQ(tree.depth(), loaded.depth());
+  ASSERT_EQ(tree.nodes().size(), loaded.nodes().size());
+  ASSERT_TRUE(tree.centers() == loaded.centers());
+  ASSERT_TRUE(tree.words() == loaded.words());
+  for (uint32_t i = 0; i < data.size(); ++i)
+  {
+    const std::vector<float> x = data[i];
+    ASSERT_EQ(tree.lookup(&x[0]), loaded.lookup(&x[0]));
+  }
+
+  // flat vocabularies are written in the previous version, which is read as tree of depth 1.
+  VocabularyTree flat;
+  flat.train(data, 5, 1);
+  writeVocabulary(filename, flat);
+
+  std::vector<std::vector<float> > vocabulary;
+  readVocabulary(filename, vocabulary);
+  ASSERT_TRUE(flat.words() == vocabulary);
+  readVocabulary(filename, loaded);
+  ASSERT_EQ(1, loaded.depth());
+  ASSERT_TRUE(flat.words() == loaded.words());
+
+  // the words of the leaves must be 0, ..., L-1, each used once.
+  std::vector<VocabularyTree::Node> nodes = tree.nodes();
+  std::vector<uint32_t> leaves;
+  for (uint32_t i = 0; i < nodes.size(); ++i)
+    if (nodes[i].numChildren == 0) leaves.push_back(i);
+  ASSERT_GT(leaves.size(), 1u);
+
+  nodes[leaves[1]].word = nodes[leaves[0]].word;
+  writeVocabulary(filename, VocabularyTree(tree.dim(), nodes, tree.centers()));
+  ASSERT_THROW(readVocabulary(filename, loaded), IOError);
+
+  nodes[leaves[1]].word = leaves.size();
+  writeVocabulary(filename, VocabularyTree(tree.dim(), nodes, tree.centers()));
+  ASSERT_THROW(readVocabulary(filename, loaded), IOError);
+
+  boost::filesystem::remove(filename);
+}
+
+}
@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <rv/geometry.h>
+#include <rv/norms.h>
+#include <rv/ParameterList.h>
+#include <rv/PrimitiveParameters.h>
+#include <rv/Error.h>
+
+#include "../project/VoxelHashGrid.h"
+#include "../project/Octree.h"
+#include "../project/utils.h"
+#include "test_utils.h"
+
+using namespace rv;
+
+namespace
+{
+
+TEST(VoxelHashGridTest, RadiusNeighbors)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 1337);
+
+  std::vector<Point3f> queries;
+  randomPoints(queries, 100, 1338);
+  queries.push_back(Point3f(20.0f, 20.0f, 20.0f));
+
+  VoxelHashGrid grid(0.5f);
+  NaiveNeighborSearch bruteforce;
+  grid.initialize(points);
+  bruteforce.initialize(points);
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  // radii smaller, equal, and larger than the cell size.
+  float radii[3] =
+  { 0.3f, 0.5f, 1.2f };
+
+  std::vector<uint32_t> expected, result;
+  for (uint32_t n = 0; n < 3; ++n)
+  {
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+      for (uint32_t i = 0; i < queries.size(); ++i)
+      {
+        grid.radiusNeighbors(queries[i], radii[r], result, *norms[n]);
+        bruteforce.radiusNeighbors(queries[i], radii[r], expected, *norms[n]);
+        std::sort(expected.begin(), expected.end());
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result)<< "query " << i << " with norm " << n << " and radius " << radii[r];
+      }
+    }
+  }
+
+  // reinitialization with a subset.
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < points.size(); i += 3)
+    indexes.push_back(i);
+  grid.initialize(points, indexes);
+
+  for (uint32_t i = 0; i < queries.size(); ++i)
+  {
+    grid.radiusNeighbors(queries[i], 0.5f, result, euclidean);
+    bruteforce.radiusNeighbors(queries[i], 0.5f, expected, euclidean);
+    std::vector<uint32_t> subset;
+    for (uint32_t j = 0; j < expected.size(); ++j)
+      if (expected[j] % 3 == 0) subset.push_back(expected[j]);
+    std::sort(result.begin(), result.end());
+    ASSERT_EQ(subset, result);
+  }
+}
+
+TEST(VoxelHashGridTest, RadiusNeighborsSegment)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 3000, 1339);
+
+  // one segment of spatially separated points and two interleaved segments.
+  std::vector<IndexedSegment> segments(3);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[(points[i].x() > 1.0f) ? 0 : (i % 2) + 1].indexes.push_back(i);
+
+  VoxelHashGrid grid(0.5f);
+  grid.initialize(points, segments);
+
+  EuclideanNorm norm;
+  std::vector<uint32_t> expected, result;
+  for (uint32_t s = 0; s < segments.size(); ++s)
+  {
+    VoxelHashGrid single(0.5f);
+    single.initialize(points, segments[s].indexes);
+    grid.setSegment(s);
+
+    for (uint32_t i = 0; i < points.size(); i += 10)
+    {
+      grid.radiusNeighbors(points[i], 0.5f, result, norm);
+      single.radiusNeighbors(points[i], 0.5f, expected, norm);
+      std::sort(expected.begin(), expected.end());
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+
+      grid.knnNeighbors(points[i], 10, result, norm);
+      single.knnNeighbors(points[i], 10, expected, norm);
+      ASSERT_EQ(expected, result);
+    }
+  }
+
+  grid.setSegment(SegmentNeighborSearch::ALL_SEGMENTS);
+  grid.radiusNeighbors(points[0], 10.0f, result, MaximumNorm());
+  ASSERT_EQ(points.size(), result.size());
+}
+
+TEST(VoxelHashGridTest, KnnNeighbors)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 2000, 1340);
+
+  std::vector<Point3f> queries;
+  randomPoints(queries, 50, 1341);
+  queries.push_back(Point3f(20.0f, -20.0f, 20.0f));
+
+  VoxelHashGrid grid(0.5f);
+  NaiveNeighborSearch bruteforce;
+  grid.initialize(points);
+  bruteforce.initialize(points);
+
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  uint32_t ks[4] =
+  { 1, 7, 50, 3000 };
+
+  std::vector<uint32_t> expected, result;
+  for (uint32_t n = 0; n < 3; ++n)
+  {
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      for (uint32_t i = 0; i < queries.size(); ++i)
+      {
+        grid.knnNeighbors(queries[i], ks[j], result, *norms[n]);
+        bruteforce.knnNeighbors(queries[i], ks[j], expected, *norms[n]);
+        ASSERT_EQ(expected.size(), result.size());
+
+        for (uint32_t k = 0; k < result.size(); ++k)
+          ASSERT_NEAR(norms[n]->compute(queries[i], points[expected[k]]),
+              norms[n]->compute(queries[i], points[result[k]]), 0.0001);
+      }
+    }
+  }
+}
+
+TEST(VoxelHashGridTest, CreateNeighborSearch)
+{
+  ParameterList params;
+  SegmentNeighborSearch* search = createNeighborSearch(params);
+  ASSERT_TRUE(dynamic_cast<Octree*>(search) != 0);
+  delete search;
+
+  params.insert(StringParameter("neighbor-search", "voxel-grid"));
+  params.insert(FloatParameter("cell-size", 0.5f));
+  search = createNeighborSearch(params);
+  ASSERT_TRUE(dynamic_cast<VoxelHashGrid*>(search) != 0);
+  delete search;
+
+  params.insert(FloatParameter("cell-size", 0.0f));
+  ASSERT_THROW(createNeighborSearch(params), Error);
+  params.insert(FloatParameter("cell-size", -0.5f));
+  ASSERT_THROW(createNeighborSearch(params), Error);
+
+  params.insert(StringParameter("neighbor-search", "kd-tree"));
+  ASSERT_THROW(createNeighborSearch(params), Error);
+
+  params.insert(StringParameter("neighbor-search", "octree"));
+  params.insert(FloatParameter("approximation", 1.0f));
+  ASSERT_THROW(createNeighborSearch(params), Error);
+}
+
+
+TEST(VoxelHashGridTest, RadiusNeighborsOffsetsAndCount)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 3000, 2020);
+
+  std::vector<IndexedSegment> segments(2);
+  for (uint32_t i = 0; i < points.size(); ++i)
+    segments[(points[i].x() > 0.0f) ? 0 : (i % 2)].indexes.push_back(i);
+
+  VoxelHashGrid search(0.5f);
+  EuclideanNorm euclidean;
+  MaximumNorm maximum;
+  ManhattenNorm manhatten;
+  const Norm* norms[3] =
+  { &euclidean, &maximum, &manhatten };
+  float radii[3] =
+  { 0.3f, 1.0f, 4.0f };
+
+  std::vector<uint32_t> expected, result;
+  std::vector<Vector3f> offsets;
+  for (uint32_t t = 0; t < 2; ++t)
+  {
+    if (t == 0) search.initialize(points);
+    else search.initialize(points, segments);
+    if (t == 1) search.setSegment(1);
+
+    for (uint32_t n = 0; n < 3; ++n)
+    {
+      for (uint32_t r = 0; r < 3; ++r)
+      {
+        for (uint32_t i = 0; i < points.size(); i += 50)
+        {
+          search.radiusNeighbors(points[i], radii[r], expected, *norms[n]);
+          search.radiusNeighbors(points[i], radii[r], result, offsets, *norms[n]);
+          ASSERT_EQ(expected.size(), search.countNeighbors(points[i], radii[r], *norms[n]));
+          ASSERT_EQ(result.size(), offsets.size());
+          for (uint32_t j = 0; j < result.size(); ++j)
+          {
+            Vector3f diff = points[result[j]] - points[i];
+            ASSERT_NEAR(diff.x(), offsets[j].x(), 0.0001);
+            ASSERT_NEAR(diff.y(), offsets[j].y(), 0.0001);
+            ASSERT_NEAR(diff.z(), offsets[j].z(), 0.0001);
+          }
+
+          std::sort(expected.begin(), expected.end());
+          std::sort(result.begin(), result.end());
+          ASSERT_EQ(expected, result);
+        }
+      }
+    }
+  }
+}
+
+}
@@ -3,10 +3,13 @@
 #include <rv/Laserscan.h>
 #include <rv/Stopwatch.h>
 #include <rv/Math.h>
+#include <boost/filesystem.hpp>
 
-#include "project/Octree.h"
+#include "project/SegmentNeighborSearch.h"
+#include "project/DescriptorCache.h"
 #include "project/BagOfWordsDescriptor.h"
 #include "project/SpinImage.h"
+#include "project/NormalEstimation.h"
 #include "project/SoftmaxRegression.h"
 #include "project/utils.h"
 
@@ -36,11 +39,29 @@ int main(int argc, char** argv)
   std::string model_directory = params["model-directory"];
 
   // 1. Initialize descriptors, vocabulary, and classifier.
-  Octree oct(params["bucket-size"]);
+  // octree or voxel grid as specified by "neighbor-search".
+  SegmentNeighborSearch* search = createNeighborSearch(params);
+  SegmentNeighborSearch& nn = *search;
+
+  // octrees of previous runs are reused, if a cache directory is given.
+  std::string cache_directory;
+  uint32_t bucket_size = 32;
+  if (params.hasParam("octree-cache")) cache_directory = (std::string) params["octree-cache"];
+  if (params.hasParam("bucket-size")) bucket_size = params["bucket-size"];
+  if (!cache_directory.empty()) boost::filesystem::create_directories(cache_directory);
 
   ParameterList bowParams = params["bag-of-words"];
+  // descriptors of previous runs (train-dictionary or train-classifier) are reused, if a cache directory is given.
+  std::string descriptor_directory;
+  if (params.hasParam("descriptor-cache")) descriptor_directory = (std::string) params["descriptor-cache"];
+  if (!descriptor_directory.empty()) boost::filesystem::create_directories(descriptor_directory);
+  const uint64_t descriptor_key = DescriptorCache::key(bowParams["descriptor"], params);
+  DescriptorCache descriptors;
+
   SpinImage si(bowParams["descriptor"]);
-  std::vector<std::vector<float> > vocabulary;
+  NormalEstimation normals(bowParams["descriptor"]);
+  // flat vocabulary or vocabulary tree, whose leaves are the words.
+  VocabularyTree vocabulary;
   readVocabulary(model_directory + (std::string) bowParams["vocabulary-filename"], vocabulary);
   BagOfWordsDescriptor bow(bowParams, si, vocabulary);
 
@@ -76,13 +97,46 @@ int main(int argc, char** argv)
     readAnnotations(dir.getAnnotationFilename(), original_labels);
 
     std::vector<float> feature(bow.dim());
+    std::string descriptor_filename;
+    if (!descriptor_directory.empty())
+      descriptor_filename = dir.getDescriptorFilename(descriptor_directory, descriptor_key);
+    const bool cached = !descriptor_filename.empty()
+        && descriptors.load(descriptor_filename, descriptor_key, scan, segments);
+
+    std::string cache_filename;
+    if (!cache_directory.empty()) cache_filename = dir.getOctreeFilename(cache_directory, bucket_size);
+    if (!cached && (cache_filename.empty() || !nn.load(cache_filename, scan.points(), segments)))
+    {
+      nn.initialize(scan.points(), segments);
+      if (!cache_filename.empty()) nn.save(cache_filename);
+    }
+
+    // normals are estimated once per scan, if the spin images use them as reference axis.
+    if (!cached && si.usesNormals())
+    {
+      nn.setSegment(SegmentNeighborSearch::ALL_SEGMENTS);
+      normals.estimate(scan, segments, nn);
+    }
+
+    if (!cached && !descriptor_filename.empty())
+    {
+      descriptors.compute(si, descriptor_key, scan, segments, nn, si.format());
+      descriptors.save(descriptor_filename);
+    }
 
     for (uint32_t i = 0; i < segments.size(); ++i)
     {
       const IndexedSegment& segment = segments[i];
 
-      oct.initialize(scan.points(), segment.indexes);
-      bow.evaluate(&feature[0], segment, scan, oct);
+      if (descriptor_filename.empty())
+      {
+        nn.setSegment(i);
+        bow.evaluate(&feature[0], segment, scan, nn);
+      }
+      else
+      {
+        bow.evaluate(&feature[0], descriptors.descriptors(i), descriptors.format(), segment, scan);
+      }
       features.push_back(feature);
 
       assert(label2id.find(original_labels[i]) != label2id.end());
@@ -118,5 +172,7 @@ int main(int argc, char** argv)
 
   std::cout << "Error on trainset: " << (100.0 * float(wrong_predictions) / float(features.size())) << std::endl;
 
+  delete search;
+
   return 0;
 }
@@ -2,14 +2,35 @@
 #include <rv/Random.h>
 #include <rv/Stopwatch.h>
 #include <rv/Math.h>
+#include <boost/filesystem.hpp>
 
-#include "project/Octree.h"
+#include "project/SegmentNeighborSearch.h"
+#include "project/DescriptorCache.h"
 #include "project/KMeans.h"
+#include "project/VocabularyTree.h"
 #include "project/SpinImage.h"
+#include "project/NormalEstimation.h"
 #include "project/utils.h"
 
 using namespace rv;
 
+/** \brief descriptor of the k-th point of the given segment, which is taken from the descriptors if given. **/
+void evaluate(std::vector<float>& feature, const SpinImage& si, const DescriptorCache* descriptors, uint32_t segmentIdx,
+    const IndexedSegment& segment, uint32_t k, const Laserscan& scan, const NearestNeighborImpl& nn,
+    SpinImage::Buffers& buffers)
+{
+  if (descriptors != 0)
+  {
+    const uint8_t* row = descriptors->descriptors(segmentIdx) + k * descriptors->rowBytes();
+    decodeDescriptor(descriptors->format(), row, si.dim(), &feature[0]);
+    return;
+  }
+
+  // evaluated by index, which takes the normal of the point as reference axis if normals are used.
+  Normal3f upvector(0., 0., 1.);
+  si.evaluate(&feature[0], segment[k], upvector, scan, nn, buffers);
+}
+
 int main(int32_t argc, char** argv)
 {
   if (argc < 2)
@@ -29,15 +50,23 @@ int main(int32_t argc, char** argv)
   ParameterList bowParams = params["bag-of-words"];
   uint32_t num_words = bowParams["num words"];
   uint32_t sample_size = bowParams["num samples"];
+  // vocabulary tree with at most branching-factor^depth words instead of "num words", if depth is greater than 1.
+  uint32_t branching = 10, depth = 1;
+  if (bowParams.hasParam("branching-factor")) branching = bowParams["branching-factor"];
+  if (bowParams.hasParam("depth")) depth = bowParams["depth"];
 
   ParameterList descriptorParams = bowParams["descriptor"];
   SpinImage si(descriptorParams);
+  NormalEstimation normals(descriptorParams);
   Normalizer* normalizer = getNormalizerByName(descriptorParams["normalizer"]);
 
-  std::vector<std::vector<float> > sampled_descriptors;
+  // sampled descriptors are stored in the format of the descriptor, which reduces the memory of large samples.
+  DescriptorMatrix sampled_descriptors(si.format(), si.dim());
   sampled_descriptors.reserve(sample_size);
 
   std::vector<float> feature(si.dim());
+  // buffers of the radius search, which are reused by all sampled points.
+  SpinImage::Buffers buffers;
 
   std::cout << "Sampling of descriptors..." << std::flush;
   Stopwatch::tic();
@@ -47,9 +76,26 @@ int main(int32_t argc, char** argv)
   uint32_t samples_per_scan = sample_size / dir.count();
 
   Laserscan scan;
-  Octree oct;
+  // octree or voxel grid as specified by "neighbor-search".
+  SegmentNeighborSearch* search = createNeighborSearch(params);
+  SegmentNeighborSearch& nn = *search;
+
+  // octrees of previous runs are reused, if a cache directory is given.
+  std::string cache_directory;
+  uint32_t bucket_size = 32;
+  if (params.hasParam("octree-cache")) cache_directory = (std::string) params["octree-cache"];
+  if (params.hasParam("bucket-size")) bucket_size = params["bucket-size"];
+  if (!cache_directory.empty()) boost::filesystem::create_directories(cache_directory);
+
+  // descriptors of all points are computed and stored for train-classifier, if a cache directory is given.
+  std::string descriptor_directory;
+  if (params.hasParam("descriptor-cache")) descriptor_directory = (std::string) params["descriptor-cache"];
+  if (!descriptor_directory.empty()) boost::filesystem::create_directories(descriptor_directory);
+  const uint64_t descriptor_key = DescriptorCache::key(descriptorParams, params);
+  DescriptorCache cache;
+  const DescriptorCache* descriptors = descriptor_directory.empty() ? 0 : &cache;
+
   std::vector<IndexedSegment> segments;
-  Normal3f upvector(0., 0., 1.);
 
   Random rand(1122);
   while (dir.hasNextFile())
@@ -57,21 +103,44 @@ int main(int32_t argc, char** argv)
     dir.next();
     readLaserscan(dir.getLaserscanFilename(), scan);
     readSegments(dir.getSegmentFilename(), segments);
+    std::string descriptor_filename;
+    if (descriptors != 0) descriptor_filename = dir.getDescriptorFilename(descriptor_directory, descriptor_key);
+    const bool cached = (descriptors != 0) && cache.load(descriptor_filename, descriptor_key, scan, segments);
+
+    std::string cache_filename;
+    if (!cache_directory.empty()) cache_filename = dir.getOctreeFilename(cache_directory, bucket_size);
+    if (!cached && (cache_filename.empty() || !nn.load(cache_filename, scan.points(), segments)))
+    {
+      nn.initialize(scan.points(), segments);
+      if (!cache_filename.empty()) nn.save(cache_filename);
+    }
+
+    // normals are estimated once per scan, if the spin images use them as reference axis.
+    if (!cached && si.usesNormals())
+    {
+      nn.setSegment(SegmentNeighborSearch::ALL_SEGMENTS);
+      normals.estimate(scan, segments, nn);
+    }
+
+    if (!cached && descriptors != 0)
+    {
+      cache.compute(si, descriptor_key, scan, segments, nn, si.format());
+      cache.save(descriptor_filename);
+    }
 
     uint32_t num_sampled = 0;
     const uint32_t samples_per_segment = samples_per_segment / segments.size();
     for (uint32_t i = 0; i < segments.size(); ++i)
     {
       const IndexedSegment& segment = segments[i];
-      oct.initialize(scan.points(), segment.indexes);
+      nn.setSegment(i);
 
       std::vector<uint32_t> idxes = rand.sample(Math::range(segment.size()), samples_per_segment);
       for (uint32_t s = 0; s < samples_per_segment; ++s)
       {
-        const Point3f& p = scan.point(segment[idxes[s]]);
-        si.evaluate(&feature[0], p, upvector, scan, oct);
+        evaluate(feature, si, descriptors, i, segment, idxes[s], scan, nn, buffers);
         normalizer->normalize(&feature[0], si.dim());
-        sampled_descriptors.push_back(feature);
+        sampled_descriptors.push_back(&feature[0]);
 
         num_sampled += 1;
       }
@@ -80,14 +149,14 @@ int main(int32_t argc, char** argv)
     // fill with randomly sampled descriptors.
     while (num_sampled < samples_per_scan)
     {
-      const IndexedSegment& segment = segments[rand.getInt(segments.size())];
-      oct.initialize(scan.points(), segment.indexes);
+      const uint32_t segmentIdx = rand.getInt(segments.size());
+      const IndexedSegment& segment = segments[segmentIdx];
+      nn.setSegment(segmentIdx);
 
-      const Point3f& p = scan.point(segment[rand.getInt(segment.size())]);
-      si.evaluate(&feature[0], p, upvector, scan, oct);
+      evaluate(feature, si, descriptors, segmentIdx, segment, rand.getInt(segment.size()), scan, nn, buffers);
       normalizer->normalize(&feature[0], si.dim());
 
-      sampled_descriptors.push_back(feature);
+      sampled_descriptors.push_back(&feature[0]);
       num_sampled += 1;
     }
   }
@@ -95,26 +164,37 @@ int main(int32_t argc, char** argv)
 // simply fill with random descriptors from last scan.
   while (sampled_descriptors.size() < sample_size)
   {
-    const IndexedSegment& segment = segments[rand.getInt(segments.size())];
-    oct.initialize(scan.points(), segment.indexes);
+    const uint32_t segmentIdx = rand.getInt(segments.size());
+    const IndexedSegment& segment = segments[segmentIdx];
+    nn.setSegment(segmentIdx);
 
-    const Point3f& p = scan.point(segment[rand.getInt(segment.size())]);
-    si.evaluate(&feature[0], p, upvector, scan, oct);
+    evaluate(feature, si, descriptors, segmentIdx, segment, rand.getInt(segment.size()), scan, nn, buffers);
     normalizer->normalize(&feature[0], si.dim());
 
-    sampled_descriptors.push_back(feature);
+    sampled_descriptors.push_back(&feature[0]);
   }
   std::cout << "finished in " << Stopwatch::toc() << " s." << std::endl;
 
   std::cout << "Learning vocabulary from " << sampled_descriptors.size() << " descriptors..." << std::flush;
   Stopwatch::tic();
-  KMeans kmeans;
-  std::vector<std::vector<float> > vocabulary = kmeans.cluster(sampled_descriptors, num_words);
+  VocabularyTree vocabulary;
+  if (depth > 1)
+  {
+    vocabulary.train(sampled_descriptors, branching, depth);
+  }
+  else
+  {
+    KMeans kmeans;
+    vocabulary = VocabularyTree(kmeans.cluster(sampled_descriptors, num_words));
+  }
   std::cout << "finished in " << Stopwatch::toc() << " s." << std::endl;
+  std::cout << "Vocabulary contains " << vocabulary.words().size() << " words." << std::endl;
 
   std::string voc_filename = model_directory + vocabulary_filename;
   std::cout << "Writing vocabulary to '" << voc_filename << "'!" << std::endl;
   writeVocabulary(voc_filename, vocabulary);
 
+  delete search;
+
   return 0;
 }